@@ -0,0 +1,347 @@
+#ifdef _WIN32
+// VirtualAllocExNuma and the processor-group NUMA calls need Windows 7
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0601
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#endif
+#else
+// For sched_setaffinity and the CPU_* macros
+#define _GNU_SOURCE
+#endif
+
+#include "chip8_arena.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#define ARENA_TOUCH_STRIDE 4096
+#define ARENA_MAX_NODES 64
+
+typedef struct {
+    // The mapping as returned by the OS, and the aligned start of the slab
+    void* map;
+    size_t map_size;
+    uint8_t* base;
+    const char* page_kind;
+    // NUMA node of the slab and of the thread that runs it, -1 if unbound
+    int node;
+
+    int used;
+    // Freed slots, linked through their first bytes
+    Chip8* free_list;
+} ArenaSlab;
+
+struct Chip8Arena {
+    const char* page_kind;
+    int slab_count;
+    int per_slab;
+    size_t slab_bytes;
+    ArenaSlab* slabs;
+
+    // NUMA nodes that have processors. Left empty on single-node machines,
+    // where there is nothing to bind.
+    int node_count;
+    int nodes[ARENA_MAX_NODES];
+#ifdef _WIN32
+    bool large_pages;
+#else
+    cpu_set_t node_cpus[ARENA_MAX_NODES];
+#endif
+};
+
+static size_t round_up(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+}
+
+#ifdef _WIN32
+
+// Large pages need the lock-pages privilege, which even an account that
+// holds it must enable on its token first. Most accounts lack it.
+static bool enable_lock_memory(void) {
+    HANDLE token;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+        return false;
+    }
+
+    TOKEN_PRIVILEGES privileges;
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool ok = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+              AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+              GetLastError() == ERROR_SUCCESS;
+    CloseHandle(token);
+    return ok;
+}
+
+static void find_nodes(Chip8Arena* arena) {
+    ULONG highest;
+    if (!GetNumaHighestNodeNumber(&highest)) {
+        return;
+    }
+    for (ULONG node = 0; node <= highest && arena->node_count < ARENA_MAX_NODES; node++) {
+        GROUP_AFFINITY affinity;
+        if (GetNumaNodeProcessorMaskEx((USHORT)node, &affinity) && affinity.Mask) {
+            arena->nodes[arena->node_count++] = (int)node;
+        }
+    }
+}
+
+static void bind_thread(Chip8Arena* arena, int node) {
+    (void)arena;
+    GROUP_AFFINITY affinity;
+    if (GetNumaNodeProcessorMaskEx((USHORT)node, &affinity)) {
+        SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+    }
+}
+
+// Large pages are committed in full by VirtualAlloc, so first touch cannot
+// place them; ask for the slab's node explicitly instead
+static bool map_slab(Chip8Arena* arena, ArenaSlab* slab) {
+    DWORD node = slab->node >= 0 ? (DWORD)slab->node : NUMA_NO_PREFERRED_NODE;
+    if (arena->large_pages) {
+        slab->map_size = round_up(arena->slab_bytes, GetLargePageMinimum());
+        slab->map = VirtualAllocExNuma(GetCurrentProcess(), NULL, slab->map_size,
+                                       MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+        slab->page_kind = "large";
+    }
+    if (!slab->map) {
+        slab->map_size = arena->slab_bytes;
+        slab->map = VirtualAllocExNuma(GetCurrentProcess(), NULL, slab->map_size,
+                                       MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+        slab->page_kind = "small";
+    }
+    slab->base = slab->map;
+    return slab->map != NULL;
+}
+
+static void unmap_slab(ArenaSlab* slab) {
+    VirtualFree(slab->map, 0, MEM_RELEASE);
+}
+
+#else
+
+// Parses a node's cpulist ("0-3,8-11") from sysfs
+static bool read_node_cpus(int node, cpu_set_t* cpus) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    CPU_ZERO(cpus);
+    int first;
+    while (fscanf(file, "%d", &first) == 1) {
+        int last = first;
+        int separator = fgetc(file);
+        if (separator == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            separator = fgetc(file);
+        }
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+        if (separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return CPU_COUNT(cpus) > 0;
+}
+
+static void find_nodes(Chip8Arena* arena) {
+    // Node numbers can have gaps, so look at every possible one
+    for (int node = 0; node < ARENA_MAX_NODES; node++) {
+        if (read_node_cpus(node, &arena->node_cpus[arena->node_count])) {
+            arena->nodes[arena->node_count++] = node;
+        }
+    }
+}
+
+static void bind_thread(Chip8Arena* arena, int node) {
+    for (int i = 0; i < arena->node_count; i++) {
+        if (arena->nodes[i] == node) {
+            sched_setaffinity(0, sizeof(cpu_set_t), &arena->node_cpus[i]);
+            return;
+        }
+    }
+}
+
+// Placed by first touch from the slab's own, already bound, thread
+static bool map_slab(Chip8Arena* arena, ArenaSlab* slab) {
+    size_t size = arena->slab_bytes;
+#ifdef MAP_HUGETLB
+    // Explicit huge pages only exist if the administrator reserved some
+    slab->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (slab->map != MAP_FAILED) {
+        slab->map_size = size;
+        slab->base = slab->map;
+        slab->page_kind = "hugetlb";
+        return true;
+    }
+#endif
+    // Over-allocate so the slab can start on a huge-page boundary, which
+    // transparent huge pages need
+    slab->map_size = size + ARENA_HUGE_PAGE;
+    slab->map = mmap(NULL, slab->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (slab->map == MAP_FAILED) {
+        slab->map = NULL;
+        return false;
+    }
+    slab->base = (uint8_t*)round_up((uintptr_t)slab->map, ARENA_HUGE_PAGE);
+    slab->page_kind = "small";
+#ifdef MADV_HUGEPAGE
+    if (madvise(slab->base, size, MADV_HUGEPAGE) == 0) {
+        slab->page_kind = "thp";
+    }
+#endif
+    return true;
+}
+
+static void unmap_slab(ArenaSlab* slab) {
+    munmap(slab->map, slab->map_size);
+}
+
+#endif
+
+// Runs on the thread that will own the slab: binds it to the slab's node,
+// maps the slab and faults its pages in, so they are local and resident
+// before the first frame
+static void place_slab(void* context, int index) {
+    Chip8Arena* arena = context;
+    ArenaSlab* slab = &arena->slabs[index];
+
+    if (slab->node >= 0) {
+        bind_thread(arena, slab->node);
+    }
+    if (!map_slab(arena, slab)) {
+        return;
+    }
+
+    volatile uint8_t* base = slab->base;
+    for (size_t offset = 0; offset < arena->slab_bytes; offset += ARENA_TOUCH_STRIDE) {
+        base[offset] = 0;
+    }
+}
+
+Chip8Arena* arena_create(WorkerPool* pool, int per_slab) {
+    Chip8Arena* arena = calloc(1, sizeof(Chip8Arena));
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->slab_count = pool_size(pool);
+    arena->per_slab = per_slab;
+    arena->slab_bytes = round_up((size_t)per_slab * ARENA_SLOT_SIZE, ARENA_HUGE_PAGE);
+    arena->slabs = calloc(arena->slab_count, sizeof(ArenaSlab));
+    if (!arena->slabs) {
+        arena_destroy(arena);
+        return NULL;
+    }
+
+    find_nodes(arena);
+    if (arena->node_count < 2) {
+        arena->node_count = 0;
+    }
+#ifdef _WIN32
+    arena->large_pages = GetLargePageMinimum() && enable_lock_memory();
+#endif
+
+    // Contiguous runs of workers share a node. Slab 0 belongs to the caller,
+    // whose affinity is not ours to change, so it stays unbound and lands
+    // wherever the caller runs.
+    int workers = arena->slab_count - 1;
+    arena->slabs[0].node = -1;
+    for (int i = 1; i < arena->slab_count; i++) {
+        ArenaSlab* slab = &arena->slabs[i];
+        slab->node = arena->node_count ? arena->nodes[(int64_t)(i - 1) * arena->node_count / workers] : -1;
+    }
+    pool_run_threads(pool, place_slab, arena);
+
+    arena->page_kind = arena->slabs[0].page_kind;
+    for (int i = 0; i < arena->slab_count; i++) {
+        if (!arena->slabs[i].map) {
+            printf("Error: Could not reserve an arena for %d instances\n", per_slab * arena->slab_count);
+            arena_destroy(arena);
+            return NULL;
+        }
+        if (strcmp(arena->slabs[i].page_kind, arena->page_kind) != 0) {
+            arena->page_kind = "mixed";
+        }
+    }
+    return arena;
+}
+
+void arena_destroy(Chip8Arena* arena) {
+    if (!arena) {
+        return;
+    }
+
+    for (int i = 0; arena->slabs && i < arena->slab_count; i++) {
+        if (arena->slabs[i].map) {
+            unmap_slab(&arena->slabs[i]);
+        }
+    }
+    free(arena->slabs);
+    free(arena);
+}
+
+Chip8* arena_alloc(Chip8Arena* arena, int slab) {
+    ArenaSlab* owner = &arena->slabs[slab];
+
+    Chip8* cpu = owner->free_list;
+    if (cpu) {
+        memcpy(&owner->free_list, cpu, sizeof(Chip8*));
+        return cpu;
+    }
+    if (owner->used == arena->per_slab) {
+        return NULL;
+    }
+    return (Chip8*)(owner->base + (size_t)owner->used++ * ARENA_SLOT_SIZE);
+}
+
+void arena_free(Chip8Arena* arena, Chip8* cpu) {
+    if (!cpu) {
+        return;
+    }
+
+    // Not a slot of ours; chip8_alloc is the only other source of instances
+    int slab = arena_slab_of(arena, cpu);
+    if (slab < 0) {
+        chip8_free(cpu);
+        return;
+    }
+
+    ArenaSlab* owner = &arena->slabs[slab];
+    memcpy(cpu, &owner->free_list, sizeof(Chip8*));
+    owner->free_list = cpu;
+}
+
+int arena_slab_count(const Chip8Arena* arena) {
+    return arena->slab_count;
+}
+
+int arena_slab_of(const Chip8Arena* arena, const Chip8* cpu) {
+    const uint8_t* slot = (const uint8_t*)cpu;
+    for (int i = 0; i < arena->slab_count; i++) {
+        const uint8_t* base = arena->slabs[i].base;
+        if (slot >= base && slot < base + arena->slab_bytes) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* arena_page_kind(const Chip8Arena* arena) {
+    return arena->page_kind;
+}
@@ -0,0 +1,55 @@
+#ifndef CHIP8_ARENA_H
+#define CHIP8_ARENA_H
+
+#include "chip8_cpu.h"
+#include "chip8_pool.h"
+
+// Instance arena for large fleets
+//
+// One slab of instance slots per pool thread, each its own mapping backed
+// by huge pages where the OS grants them (explicit huge pages or
+// transparent huge pages on Linux, large pages on Windows), so a fleet of
+// 100k instances costs a few hundred TLB entries instead of tens of
+// thousands. Slots are cache-line aligned and slabs start on a huge-page
+// boundary, so no line or page is shared between threads.
+//
+// On machines with more than one NUMA node, arena_create binds each pool
+// worker to the processors of one node, spreading the workers evenly over
+// the nodes. The calling thread keeps its affinity, so slab 0 is placed
+// wherever it happens to run. Each slab is then mapped and faulted
+// in by its own thread: on Linux first touch places it on that node, on
+// Windows VirtualAllocExNuma asks for the node directly, since large pages
+// are committed whole and first touch cannot move them. Run a slab only
+// from its own thread (pool_run_threads) to keep it local. Windows large
+// pages also need the lock-pages privilege, which the arena enables when
+// the account holds it.
+//
+// Freed slots go on their slab's free list and are handed out again as
+// they are; chip8_init or chip8_load_state overwrites them anyway, so the
+// arena never zeroes memory.
+
+#define ARENA_ALIGN 64
+#define ARENA_SLOT_SIZE ((sizeof(Chip8) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_HUGE_PAGE (2 * 1024 * 1024)
+
+typedef struct Chip8Arena Chip8Arena;
+
+// Room for `per_slab` instances on each of the pool's threads
+Chip8Arena* arena_create(WorkerPool* pool, int per_slab);
+void arena_destroy(Chip8Arena* arena);
+
+// Uninitialised slot from `slab`, or NULL if it is full. A slab's slots
+// must only be allocated and freed by one thread at a time.
+Chip8* arena_alloc(Chip8Arena* arena, int slab);
+// Returns `cpu` to its slab; an instance that is not from the arena is
+// passed to chip8_free instead
+void arena_free(Chip8Arena* arena, Chip8* cpu);
+
+int arena_slab_count(const Chip8Arena* arena);
+// Slab that holds `cpu`, -1 if it is not from this arena
+int arena_slab_of(const Chip8Arena* arena, const Chip8* cpu);
+// "hugetlb", "thp", "large" or "small": the pages the OS gave us, or
+// "mixed" if the slabs did not all get the same kind
+const char* arena_page_kind(const Chip8Arena* arena);
+
+#endif
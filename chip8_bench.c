@@ -0,0 +1,407 @@
+#define SDL_MAIN_HANDLED
+#include "chip8_arena.h"
+#include "chip8_cpu.h"
+#include "chip8_filter.h"
+#include "chip8_pool.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Micro-benchmarks for the pieces of the emulator with a time budget
+
+#define BENCH_WARMUP_FRAMES 120
+#define FILTER_DEFAULT_WIDTH 3840
+#define FILTER_DEFAULT_HEIGHT 1920
+#define FILTER_DEFAULT_FRAMES 200
+#define FILTER_BUDGET_MS 1.0
+#define RUNAHEAD_FRAMES 3600
+#define RUNAHEAD_PRESS_FRAME 120
+#define RUNAHEAD_WINDOW 30
+#define FLEET_MIN_INSTANCES 64
+#define FLEET_DEFAULT_INSTANCES 16384
+// Instance-frames per measurement, so small fleets run long enough to time
+#define FLEET_WORK (1 << 20)
+#define FLEET_MIN_FRAMES 10
+#define LAYOUT_CYCLES 200000000
+#define LAYOUT_FLEETS 3
+
+// Headless runs are silent
+void platform_beep(void) {
+}
+
+static double seconds_since(Uint64 start) {
+    return (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+// A ROM's screen after it had time to draw something, or a checkerboard.
+// Returns false if the ROM cannot be loaded.
+static bool load_screen(Chip8* cpu, const char* rom) {
+    chip8_init(cpu);
+    cpu->muted = true;
+    if (rom) {
+        if (!chip8_load_rom(cpu, rom)) {
+            return false;
+        }
+        for (int i = 0; i < BENCH_WARMUP_FRAMES; i++) {
+            chip8_run_frame(cpu);
+        }
+        return true;
+    }
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            cpu->screen[x][y] = ((x >> 2) ^ (y >> 2)) & 1;
+        }
+    }
+    return true;
+}
+
+static int bench_filters(const char* rom, int width, int height, int frames, int threads) {
+    static Chip8 cpu;
+    if (!load_screen(&cpu, rom)) {
+        return 1;
+    }
+
+    // Rows padded like a texture would be
+    int pitch = (width * 4 + 63) & ~63;
+    uint8_t* pixels = malloc((size_t)pitch * height + 64);
+    FilterPipeline* filter = filter_create(threads);
+    if (!pixels || !filter) {
+        printf("Error: out of memory\n");
+        free(pixels);
+        filter_destroy(filter);
+        return 1;
+    }
+
+    printf("Filters at %dx%d, %d extra threads, %d frames each\n", width, height, threads, frames);
+    printf("%-10s %-10s %10s %10s\n", "scaler", "post", "ms/frame", "GB/s");
+    int over_budget = 0;
+    for (int post = 0; post < POST_COUNT; post++) {
+        for (int scaler = 0; scaler < SCALER_COUNT; scaler++) {
+            filter_set_mode(filter, scaler, post);
+            // The first frame builds the output tables
+            filter_render(filter, &cpu, pixels, pitch, width, height);
+
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (int i = 0; i < frames; i++) {
+                cpu.screen[i % SCREEN_WIDTH][i % SCREEN_HEIGHT] ^= 1;
+                filter_render(filter, &cpu, pixels, pitch, width, height);
+            }
+            double ms = seconds_since(start) * 1000.0 / frames;
+            double bandwidth = (double)width * height * 4 / (ms / 1000.0) / 1e9;
+            printf("%-10s %-10s %10.3f %10.2f%s\n", filter_scaler_name(scaler), filter_post_name(post), ms,
+                   bandwidth, ms > FILTER_BUDGET_MS ? "  over budget" : "");
+            over_budget += ms > FILTER_BUDGET_MS;
+        }
+    }
+
+    filter_destroy(filter);
+    free(pixels);
+    return over_budget ? 2 : 0;
+}
+
+// Frames between a key press at RUNAHEAD_PRESS_FRAME and the first displayed
+// frame that differs from a run without it, or -1
+static int runahead_reaction(const Chip8* rom, int key, int ahead) {
+    static Chip8 pressed, idle, shown_pressed, shown_idle;
+    memcpy(&idle, rom, sizeof(Chip8));
+    for (int f = 0; f < RUNAHEAD_PRESS_FRAME; f++) {
+        chip8_run_frame(&idle);
+    }
+    memcpy(&pressed, &idle, sizeof(Chip8));
+    chip8_queue_key(&pressed, (uint8_t)key, true);
+
+    for (int f = 0; f <= RUNAHEAD_WINDOW; f++) {
+        chip8_run_frame(&pressed);
+        chip8_run_frame(&idle);
+        chip8_run_ahead(&pressed, &shown_pressed, ahead);
+        chip8_run_ahead(&idle, &shown_idle, ahead);
+        if (memcmp(shown_pressed.screen, shown_idle.screen, sizeof(shown_idle.screen)) != 0) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+// Cost of run-ahead per displayed frame, and how many frames a key press
+// takes to show up on screen
+static int bench_runahead(const char* rom, int key) {
+    if (!rom) {
+        printf("Error: runahead needs --rom\n");
+        return 1;
+    }
+
+    static Chip8 loaded, cpu, future;
+    chip8_init(&loaded);
+    loaded.muted = true;
+    chip8_seed_rng(&loaded, 1);
+    if (!chip8_load_rom(&loaded, rom)) {
+        return 1;
+    }
+
+    printf("Run-ahead on %s, key %X pressed at frame %d\n", rom, key, RUNAHEAD_PRESS_FRAME);
+    printf("%-6s %12s %10s %10s %10s\n", "ahead", "us/frame", "relative", "floor", "lag");
+    double base = 0;
+    for (int ahead = 0; ahead <= CHIP8_MAX_RUN_AHEAD; ahead++) {
+        memcpy(&cpu, &loaded, sizeof(Chip8));
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int f = 0; f < RUNAHEAD_FRAMES; f++) {
+            chip8_run_frame(&cpu);
+            if (ahead) {
+                chip8_run_ahead(&cpu, &future, ahead);
+            }
+        }
+        double us = seconds_since(start) * 1e6 / RUNAHEAD_FRAMES;
+        if (ahead == 0) {
+            base = us;
+        }
+
+        int reaction = runahead_reaction(&loaded, key, ahead);
+        char frames[16];
+        snprintf(frames, sizeof(frames), reaction < 0 ? "none" : "%d", reaction);
+        printf("%-6d %12.2f %9.2fx %9d.00x %10s\n", ahead, us, us / base, ahead + 1, frames);
+    }
+    // Each displayed frame runs 1 + ahead frames; the rest is the snapshot
+    printf("Floor: frames emulated per displayed frame; the excess is copying the %zu-byte machine\n",
+           sizeof(Chip8));
+    return 0;
+}
+
+typedef struct {
+    Chip8** instances;
+    int count;
+    Chip8Arena* arena;
+} Fleet;
+
+static void run_fleet_instance(void* context, int index) {
+    Fleet* fleet = context;
+    chip8_run_frame(fleet->instances[index]);
+}
+
+// Same split of instances over slabs as the wall
+static void run_fleet_slab(void* context, int slab) {
+    Fleet* fleet = context;
+    int slabs = arena_slab_count(fleet->arena);
+    int last = (int)((int64_t)(slab + 1) * fleet->count / slabs);
+    for (int i = (int)((int64_t)slab * fleet->count / slabs); i < last; i++) {
+        chip8_run_frame(fleet->instances[i]);
+    }
+}
+
+// Millions of guest instructions per second for `count` copies of `loaded`,
+// each allocated on its own or carved from an arena
+static double fleet_rate(WorkerPool* pool, const Chip8* loaded, int count, bool use_arena, const char** pages) {
+    Fleet fleet = {calloc(count, sizeof(Chip8*)), count, NULL};
+    if (!fleet.instances) {
+        return 0;
+    }
+
+    int slabs = pool_size(pool);
+    if (use_arena) {
+        fleet.arena = arena_create(pool, (count + slabs - 1) / slabs);
+        if (!fleet.arena) {
+            free(fleet.instances);
+            return 0;
+        }
+        *pages = arena_page_kind(fleet.arena);
+    }
+    bool ok = true;
+    for (int slab = 0, i = 0; slab < slabs; slab++) {
+        for (int last = (int)((int64_t)(slab + 1) * count / slabs); i < last; i++) {
+            fleet.instances[i] = use_arena ? arena_alloc(fleet.arena, slab) : chip8_alloc(sizeof(Chip8));
+            if (!fleet.instances[i]) {
+                ok = false;
+                break;
+            }
+            memcpy(fleet.instances[i], loaded, sizeof(Chip8));
+        }
+    }
+
+    double rate = 0;
+    if (ok) {
+        int frames = FLEET_WORK / count > FLEET_MIN_FRAMES ? FLEET_WORK / count : FLEET_MIN_FRAMES;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int f = 0; f < frames; f++) {
+            if (use_arena) {
+                pool_run_threads(pool, run_fleet_slab, &fleet);
+            } else {
+                pool_run(pool, count, run_fleet_instance, &fleet);
+            }
+        }
+        double seconds = seconds_since(start);
+
+        uint64_t executed = 0;
+        for (int i = 0; i < count; i++) {
+            executed += fleet.instances[i]->cycles - fleet.instances[i]->idle_cycles;
+        }
+        executed -= (uint64_t)count * (loaded->cycles - loaded->idle_cycles);
+        rate = executed / seconds / 1e6;
+    } else {
+        printf("Error: out of memory for %d instances\n", count);
+    }
+
+    if (!use_arena) {
+        for (int i = 0; i < count; i++) {
+            chip8_free(fleet.instances[i]);
+        }
+    }
+    arena_destroy(fleet.arena);
+    free(fleet.instances);
+    return rate;
+}
+
+// Guest instructions per second as the fleet grows, with every instance
+// malloc'd on its own and scheduled dynamically, against per-thread arena
+// slabs run by their owning thread
+static int bench_fleet(const char* rom, int max_instances, int threads) {
+    if (!rom) {
+        printf("Error: fleet needs --rom\n");
+        return 1;
+    }
+
+    static Chip8 loaded;
+    chip8_init(&loaded);
+    loaded.muted = true;
+    chip8_seed_rng(&loaded, 1);
+    if (!chip8_load_rom(&loaded, rom)) {
+        return 1;
+    }
+
+    WorkerPool* pool = pool_create(threads);
+    if (!pool) {
+        printf("Error: out of memory\n");
+        return 1;
+    }
+
+    const char* pages = "none";
+    printf("Fleet of %s on %d threads, %zu bytes per slot\n", rom, pool_size(pool), ARENA_SLOT_SIZE);
+    printf("%-10s %14s %14s %8s\n", "instances", "malloc Mips", "arena Mips", "gain");
+    for (int count = FLEET_MIN_INSTANCES; count <= max_instances; count *= 2) {
+        double scattered = fleet_rate(pool, &loaded, count, false, &pages);
+        double arena = fleet_rate(pool, &loaded, count, true, &pages);
+        printf("%-10d %14.1f %14.1f %7.2fx\n", count, scattered, arena, scattered > 0 ? arena / scattered : 0.0);
+    }
+    printf("Arena pages: %s\n", pages);
+
+    pool_destroy(pool);
+    return 0;
+}
+
+static void print_block(const char* name, size_t offset, size_t size) {
+    printf("%-8s %6zu %6zu   lines %zu-%zu\n", name, offset, size, offset / CHIP8_CACHE_LINE,
+           (offset + size - 1) / CHIP8_CACHE_LINE);
+}
+
+// Where the hot and cold blocks of the machine sit, guest instructions per
+// second for one instance run back to back, and arena fleets too big for
+// the cache, where only the lines an instance touches get fetched
+static int bench_layout(const char* rom, int max_instances, int threads) {
+    if (!rom) {
+        printf("Error: layout needs --rom\n");
+        return 1;
+    }
+
+    printf("Chip8 is %zu bytes, %zu-byte lines\n", sizeof(Chip8), (size_t)CHIP8_CACHE_LINE);
+    printf("%-8s %6s %6s\n", "block", "offset", "size");
+    print_block("hot", 0, CHIP8_END_OF(run_hook));
+    print_block("sched", offsetof(Chip8, sched), sizeof(Chip8Scheduler));
+    print_block("stack", offsetof(Chip8, stack), sizeof(((Chip8*)0)->stack));
+    print_block("memory", offsetof(Chip8, memory), MEMORY_SIZE);
+    print_block("screen", offsetof(Chip8, screen), SCREEN_WIDTH * SCREEN_HEIGHT);
+
+    static Chip8 loaded, cpu;
+    chip8_init(&loaded);
+    loaded.muted = true;
+    chip8_seed_rng(&loaded, 1);
+    if (!chip8_load_rom(&loaded, rom)) {
+        return 1;
+    }
+
+    // One long run, so the scheduler only interrupts it at timer ticks
+    memcpy(&cpu, &loaded, sizeof(Chip8));
+    chip8_set_clock(&cpu, LAYOUT_CYCLES / 10);
+    Uint64 start = SDL_GetPerformanceCounter();
+    chip8_run_until(&cpu, LAYOUT_CYCLES);
+    double seconds = seconds_since(start);
+    printf("Single instance: %.1f Mips (%.0f%% idle)\n", (cpu.cycles - cpu.idle_cycles) / seconds / 1e6,
+           100.0 * cpu.idle_cycles / cpu.cycles);
+
+    WorkerPool* pool = pool_create(threads);
+    if (!pool) {
+        printf("Error: out of memory\n");
+        return 1;
+    }
+    const char* pages = "none";
+    printf("%-10s %14s\n", "instances", "arena Mips");
+    for (int i = LAYOUT_FLEETS - 1; i >= 0; i--) {
+        int count = max_instances >> (2 * i);
+        if (count >= FLEET_MIN_INSTANCES) {
+            printf("%-10d %14.1f\n", count, fleet_rate(pool, &loaded, count, true, &pages));
+        }
+    }
+    printf("Arena pages: %s, %d threads\n", pages, pool_size(pool));
+
+    pool_destroy(pool);
+    return 0;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage:\n");
+    printf("  %s filters [--rom file] [--size WxH] [--frames N] [--threads N]\n", program);
+    printf("  %s runahead --rom file [--key K]\n", program);
+    printf("  %s fleet --rom file [--instances N] [--threads N]\n", program);
+    printf("  %s layout --rom file [--instances N] [--threads N]\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char* rom = NULL;
+    int width = FILTER_DEFAULT_WIDTH;
+    int height = FILTER_DEFAULT_HEIGHT;
+    int frames = FILTER_DEFAULT_FRAMES;
+    int threads = pool_default_threads();
+    int key = 1;
+    int instances = FLEET_DEFAULT_INSTANCES;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--rom") == 0) {
+            rom = argv[i + 1];
+        } else if (strcmp(argv[i], "--size") == 0) {
+            sscanf(argv[i + 1], "%dx%d", &width, &height);
+        } else if (strcmp(argv[i], "--frames") == 0) {
+            frames = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--instances") == 0) {
+            instances = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--key") == 0) {
+            key = (int)strtol(argv[i + 1], NULL, 16) & KEY_MASK;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (width < 1 || height < 1 || frames < 1 || threads < 0 || instances < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "filters") == 0) {
+        return bench_filters(rom, width, height, frames, threads);
+    }
+    if (strcmp(argv[1], "runahead") == 0) {
+        return bench_runahead(rom, key);
+    }
+    if (strcmp(argv[1], "fleet") == 0) {
+        return bench_fleet(rom, instances, threads);
+    }
+    if (strcmp(argv[1], "layout") == 0) {
+        return bench_layout(rom, instances, threads);
+    }
+
+    print_usage(argv[0]);
+    return 1;
+}
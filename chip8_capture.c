@@ -0,0 +1,378 @@
+#include "chip8_capture.h"
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAPTURE_IDLE_MS 4
+#define CAPTURE_FILE_BUFFER (64 * 1024)
+// Type, gap, timers, and a delta that degenerates to one literal run
+#define CAPTURE_MAX_RECORD (16 + CAPTURE_PLANE_SIZE + 8)
+
+struct Chip8Capture {
+    FILE* file;
+
+    // Single-producer, single-consumer ring. The emulation thread owns
+    // `head`, the encoder owns `tail`.
+    CaptureFrame queue[CAPTURE_QUEUE_FRAMES];
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+    SDL_atomic_t stopping;
+    SDL_sem* finished;
+
+    // Non-real-time streams wait on `drained` for room in the ring, with
+    // `waiting` set so the encoder knows to post it
+    bool realtime;
+    SDL_atomic_t waiting;
+    SDL_sem* drained;
+
+    // Producer statistics
+    uint32_t captured;
+    uint32_t dropped;
+
+    // Encoder state
+    uint8_t previous[CAPTURE_PLANE_SIZE];
+    uint64_t previous_frame;
+    uint32_t since_keyframe;
+    uint64_t bytes_written;
+};
+
+// Shared encoder thread, started with the first stream and stopped with the last
+static SDL_SpinLock encoder_lock = 0;
+static SDL_Thread* encoder_thread = NULL;
+static SDL_atomic_t encoder_running;
+static SDL_sem* encoder_wake = NULL;
+static void* streams[CAPTURE_MAX_STREAMS];
+static int stream_count = 0;
+
+static void put_varint(uint8_t* buf, int* pos, uint64_t value) {
+    while (value >= 0x80) {
+        buf[(*pos)++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[(*pos)++] = (uint8_t)value;
+}
+
+// Appends the XOR of two bitplanes as a run list
+static int encode_delta(uint8_t* buf, int pos, const uint8_t* delta) {
+    int i = 0;
+    while (i < CAPTURE_PLANE_SIZE) {
+        int zeros = 0;
+        while (i + zeros < CAPTURE_PLANE_SIZE && delta[i + zeros] == 0) {
+            zeros++;
+        }
+        i += zeros;
+
+        // A literal run ends at the first pair of zero bytes
+        int literals = 0;
+        while (i + literals < CAPTURE_PLANE_SIZE &&
+               (delta[i + literals] != 0 ||
+                (i + literals + 1 < CAPTURE_PLANE_SIZE && delta[i + literals + 1] != 0))) {
+            literals++;
+        }
+
+        put_varint(buf, &pos, zeros);
+        put_varint(buf, &pos, literals);
+        memcpy(buf + pos, delta + i, literals);
+        pos += literals;
+        i += literals;
+    }
+    return pos;
+}
+
+static void encode_frame(Chip8Capture* capture, const CaptureFrame* frame) {
+    uint8_t buf[CAPTURE_MAX_RECORD];
+    int pos = 0;
+    bool key = capture->since_keyframe == 0;
+
+    buf[pos++] = key ? CAPTURE_KEYFRAME : CAPTURE_DELTA;
+    put_varint(buf, &pos, frame->frame - capture->previous_frame);
+    buf[pos++] = frame->delay_timer;
+    buf[pos++] = frame->sound_timer;
+
+    if (key) {
+        memcpy(buf + pos, frame->plane, CAPTURE_PLANE_SIZE);
+        pos += CAPTURE_PLANE_SIZE;
+    } else {
+        uint8_t delta[CAPTURE_PLANE_SIZE];
+        for (int i = 0; i < CAPTURE_PLANE_SIZE; i++) {
+            delta[i] = frame->plane[i] ^ capture->previous[i];
+        }
+        pos = encode_delta(buf, pos, delta);
+    }
+
+    fwrite(buf, 1, pos, capture->file);
+    capture->bytes_written += pos;
+    memcpy(capture->previous, frame->plane, CAPTURE_PLANE_SIZE);
+    capture->previous_frame = frame->frame;
+    capture->since_keyframe = (capture->since_keyframe + 1) % CAPTURE_KEYFRAME_INTERVAL;
+}
+
+// Encodes everything queued on one stream; returns the number of frames
+static int drain(Chip8Capture* capture) {
+    unsigned tail = (unsigned)SDL_AtomicGet(&capture->tail);
+    unsigned head = (unsigned)SDL_AtomicGet(&capture->head);
+    int count = (int)(head - tail);
+
+    for (; tail != head; tail++) {
+        encode_frame(capture, &capture->queue[tail % CAPTURE_QUEUE_FRAMES]);
+    }
+    SDL_AtomicSet(&capture->tail, (int)tail);
+    return count;
+}
+
+static int encoder_main(void* data) {
+    (void)data;
+
+    while (SDL_AtomicGet(&encoder_running)) {
+        int work = 0;
+        for (int i = 0; i < CAPTURE_MAX_STREAMS; i++) {
+            Chip8Capture* capture = SDL_AtomicGetPtr(&streams[i]);
+            if (!capture) {
+                continue;
+            }
+
+            // Read the stop request first so no frame queued before it is missed
+            int stopping = SDL_AtomicGet(&capture->stopping);
+            work += drain(capture);
+            if (SDL_AtomicCAS(&capture->waiting, 1, 0)) {
+                SDL_SemPost(capture->drained);
+            }
+            if (stopping) {
+                fflush(capture->file);
+                SDL_AtomicSetPtr(&streams[i], NULL);
+                SDL_SemPost(capture->finished);
+            }
+        }
+        if (!work) {
+            SDL_SemWaitTimeout(encoder_wake, CAPTURE_IDLE_MS);
+        }
+    }
+    return 0;
+}
+
+static void destroy_capture(Chip8Capture* capture) {
+    fclose(capture->file);
+    if (capture->finished) {
+        SDL_DestroySemaphore(capture->finished);
+    }
+    if (capture->drained) {
+        SDL_DestroySemaphore(capture->drained);
+    }
+    free(capture);
+}
+
+Chip8Capture* capture_start(const char* filename, bool realtime) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        printf("Error: Could not create capture file: %s\n", filename);
+        return NULL;
+    }
+
+    Chip8Capture* capture = calloc(1, sizeof(Chip8Capture));
+    if (!capture) {
+        fclose(file);
+        return NULL;
+    }
+    capture->file = file;
+    capture->realtime = realtime;
+    capture->finished = SDL_CreateSemaphore(0);
+    capture->drained = SDL_CreateSemaphore(0);
+    if (!capture->finished || !capture->drained) {
+        printf("Error: Could not create capture semaphores: %s\n", SDL_GetError());
+        destroy_capture(capture);
+        return NULL;
+    }
+    setvbuf(file, NULL, _IOFBF, CAPTURE_FILE_BUFFER);
+
+    fwrite(CAPTURE_MAGIC, 1, 4, file);
+    fputc(CAPTURE_VERSION, file);
+    fputc(SCREEN_WIDTH, file);
+    fputc(SCREEN_HEIGHT, file);
+    fputc(CAPTURE_FPS, file);
+
+    SDL_AtomicLock(&encoder_lock);
+    int slot = -1;
+    for (int i = 0; i < CAPTURE_MAX_STREAMS && slot < 0; i++) {
+        if (SDL_AtomicCASPtr(&streams[i], NULL, capture)) {
+            slot = i;
+        }
+    }
+    if (slot >= 0 && stream_count++ == 0) {
+        SDL_AtomicSet(&encoder_running, 1);
+        encoder_wake = SDL_CreateSemaphore(0);
+        encoder_thread = SDL_CreateThread(encoder_main, "chip8_capture", NULL);
+    }
+    SDL_AtomicUnlock(&encoder_lock);
+
+    if (slot < 0) {
+        printf("Error: too many capture streams\n");
+        destroy_capture(capture);
+        return NULL;
+    }
+
+    printf("Capturing video to %s\n", filename);
+    return capture;
+}
+
+void capture_frame(Chip8Capture* capture, const Chip8* cpu) {
+    // Unsigned, so the indices wrap instead of going negative after 2^31
+    // frames
+    unsigned head = (unsigned)SDL_AtomicGet(&capture->head);
+    unsigned queued = head - (unsigned)SDL_AtomicGet(&capture->tail);
+    while (queued >= CAPTURE_QUEUE_FRAMES) {
+        if (capture->realtime) {
+            capture->dropped++;
+            return;
+        }
+        // The encoder rechecks `waiting` after every pass, so the post
+        // cannot be missed even if it drained just before we set it
+        SDL_AtomicSet(&capture->waiting, 1);
+        SDL_SemPost(encoder_wake);
+        SDL_SemWait(capture->drained);
+        queued = head - (unsigned)SDL_AtomicGet(&capture->tail);
+    }
+    // Real-time sessions never get here; faster-than-real-time runs wake the
+    // encoder early instead of waiting for its idle poll
+    if (queued == CAPTURE_QUEUE_FRAMES / 2) {
+        SDL_SemPost(encoder_wake);
+    }
+
+    CaptureFrame* frame = &capture->queue[head % CAPTURE_QUEUE_FRAMES];
+    frame->frame = cpu->sched.frame_count;
+    frame->delay_timer = cpu->delay_timer;
+    frame->sound_timer = cpu->sound_timer;
+
+    // Eight pixels at a time: the multiply gathers the low bit of each byte
+    // into the top byte, first pixel lowest
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        for (int b = 0; b < SCREEN_HEIGHT / 8; b++) {
+            uint64_t pixels;
+            memcpy(&pixels, &cpu->screen[x][b * 8], sizeof(pixels));
+            pixels &= 0x0101010101010101ull;
+            frame->plane[x * 4 + b] = (uint8_t)((pixels * 0x0102040810204080ull) >> 56);
+        }
+    }
+
+    capture->captured++;
+    SDL_AtomicSet(&capture->head, (int)(head + 1));
+}
+
+uint32_t capture_stop(Chip8Capture* capture) {
+    if (!capture) {
+        return 0;
+    }
+
+    SDL_AtomicSet(&capture->stopping, 1);
+    SDL_SemWait(capture->finished);
+
+    SDL_AtomicLock(&encoder_lock);
+    if (--stream_count == 0) {
+        SDL_AtomicSet(&encoder_running, 0);
+        SDL_WaitThread(encoder_thread, NULL);
+        SDL_DestroySemaphore(encoder_wake);
+        encoder_thread = NULL;
+        encoder_wake = NULL;
+    }
+    SDL_AtomicUnlock(&encoder_lock);
+
+    printf("Captured %u frames (%u dropped), %llu bytes\n", capture->captured, capture->dropped,
+           (unsigned long long)capture->bytes_written);
+    uint32_t dropped = capture->dropped;
+    destroy_capture(capture);
+    return dropped;
+}
+
+// Reader
+
+static int get_varint(FILE* file, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(file);
+        if (byte == EOF) {
+            return 0;
+        }
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int capture_reader_open(CaptureReader* reader, const char* filename) {
+    memset(reader, 0, sizeof(CaptureReader));
+    reader->file = fopen(filename, "rb");
+    if (!reader->file) {
+        printf("Error: Could not open capture file: %s\n", filename);
+        return 0;
+    }
+
+    uint8_t header[8];
+    if (fread(header, 1, sizeof(header), reader->file) != sizeof(header) ||
+        memcmp(header, CAPTURE_MAGIC, 4) != 0 || header[4] != CAPTURE_VERSION ||
+        header[5] != SCREEN_WIDTH || header[6] != SCREEN_HEIGHT) {
+        printf("Error: %s is not a CHIP-8 capture\n", filename);
+        fclose(reader->file);
+        reader->file = NULL;
+        return 0;
+    }
+    reader->width = header[5];
+    reader->height = header[6];
+    reader->fps = header[7];
+    return 1;
+}
+
+int capture_reader_next(CaptureReader* reader, CaptureFrame* frame) {
+    CaptureFrame* current = &reader->current;
+    int type = fgetc(reader->file);
+    if (type == EOF) {
+        return 0;
+    }
+
+    uint64_t gap;
+    int delay = 0;
+    int sound = 0;
+    if (!get_varint(reader->file, &gap) || (delay = fgetc(reader->file)) == EOF ||
+        (sound = fgetc(reader->file)) == EOF) {
+        return -1;
+    }
+    current->frame += gap;
+    current->delay_timer = (uint8_t)delay;
+    current->sound_timer = (uint8_t)sound;
+
+    if (type == CAPTURE_KEYFRAME) {
+        if (fread(current->plane, 1, CAPTURE_PLANE_SIZE, reader->file) != CAPTURE_PLANE_SIZE) {
+            return -1;
+        }
+    } else if (type == CAPTURE_DELTA) {
+        uint64_t pos = 0;
+        while (pos < CAPTURE_PLANE_SIZE) {
+            uint64_t zeros, literals;
+            if (!get_varint(reader->file, &zeros) || !get_varint(reader->file, &literals) ||
+                pos + zeros + literals > CAPTURE_PLANE_SIZE) {
+                return -1;
+            }
+            pos += zeros;
+            for (uint64_t i = 0; i < literals; i++) {
+                int byte = fgetc(reader->file);
+                if (byte == EOF) {
+                    return -1;
+                }
+                current->plane[pos++] ^= (uint8_t)byte;
+            }
+        }
+    } else {
+        return -1;
+    }
+
+    *frame = *current;
+    return 1;
+}
+
+void capture_reader_close(CaptureReader* reader) {
+    if (reader->file) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
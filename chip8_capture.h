@@ -0,0 +1,74 @@
+#ifndef CHIP8_CAPTURE_H
+#define CHIP8_CAPTURE_H
+
+#include "chip8_cpu.h"
+#include <stdio.h>
+
+// Gameplay video capture
+//
+// The emulation thread packs each finished frame into a bitplane and hands
+// it to a per-stream single-producer ring. One shared encoder thread drains
+// every open stream and writes a delta/RLE file, so recording costs the
+// emulator a 256-byte pack and two atomic operations per frame.
+//
+// A real-time stream (the window) never waits: when its ring is full the
+// frame is dropped and counted. Any other stream (headless runs, which
+// produce frames far faster than 60 Hz) waits for the encoder instead, so
+// it keeps every frame.
+//
+// File:   "C8CV" u8 version, u8 width, u8 height, u8 fps, then frames
+// Frame:  u8 type, varint frame gap, u8 delay timer, u8 sound timer, payload
+//           CAPTURE_KEYFRAME  the 256-byte bitplane
+//           CAPTURE_DELTA     bitplane XOR previous frame as RLE runs of
+//                             (varint zero count, varint literal count,
+//                             literal bytes) covering all 256 bytes
+// Bitplane: 64 little-endian u32 columns, bit y = pixel (x, y).
+// The frame gap is the number of emulated frames since the previous record;
+// gaps above one are frames that were not captured.
+
+#define CAPTURE_MAGIC "C8CV"
+#define CAPTURE_VERSION 1
+#define CAPTURE_FPS 60
+#define CAPTURE_PLANE_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT / 8)
+#define CAPTURE_QUEUE_FRAMES 64
+#define CAPTURE_KEYFRAME_INTERVAL 300
+#define CAPTURE_MAX_STREAMS 256
+
+#define CAPTURE_DELTA    0
+#define CAPTURE_KEYFRAME 1
+
+typedef struct Chip8Capture Chip8Capture;
+
+Chip8Capture* capture_start(const char* filename, bool realtime);
+// Queues the instance's current screen as emulated frame `cpu->sched.frame_count`
+void capture_frame(Chip8Capture* capture, const Chip8* cpu);
+// Flushes queued frames, closes the file and reports dropped frames.
+// Returns the number dropped.
+uint32_t capture_stop(Chip8Capture* capture);
+
+// Decoded frame, used by the video tool
+typedef struct {
+    uint64_t frame;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t plane[CAPTURE_PLANE_SIZE];
+} CaptureFrame;
+
+typedef struct {
+    FILE* file;
+    uint8_t width;
+    uint8_t height;
+    uint8_t fps;
+    CaptureFrame current;
+} CaptureReader;
+
+int capture_reader_open(CaptureReader* reader, const char* filename);
+// Returns 1 and fills `frame`, 0 at the end, -1 if the file is corrupt
+int capture_reader_next(CaptureReader* reader, CaptureFrame* frame);
+void capture_reader_close(CaptureReader* reader);
+
+static inline int capture_pixel(const uint8_t* plane, int x, int y) {
+    return (plane[x * 4 + (y >> 3)] >> (y & 7)) & 1;
+}
+
+#endif
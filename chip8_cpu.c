@@ -1,9 +1,17 @@
 #include "chip8_cpu.h"
+#include "chip8_log.h"
 #include "chip8_opcodes.h"
 #include "chip8_platform.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static void dispatch_events(Chip8* cpu);
 
 static const uint8_t fontset[80] = {
     0xF0, 0x90, 0x90, 0x90, 0xF0,
@@ -29,46 +37,163 @@ void chip8_init(Chip8* cpu) {
     memset(cpu->V, 0, REGISTER_COUNT);
     memset(cpu->stack, 0, STACK_SIZE * sizeof(uint16_t));
     memset(cpu->screen, 0, SCREEN_WIDTH * SCREEN_HEIGHT);
-    memset(cpu->keypad, 0, KEY_COUNT);
     
     cpu->I = 0;
+    cpu->keypad = 0;
     cpu->pc = 0x200;
     cpu->sp = 0;
     cpu->delay_timer = 0;
     cpu->sound_timer = 0;
     cpu->draw_flag = false;
+    cpu->muted = false;
+    cpu->log_stream = 0;
+    chip8_seed_rng(cpu, (uint32_t)time(NULL));
+    cpu->profile = &quirk_profiles[QUIRKS_CHIP8];
+    cpu->cycles = 0;
+    cpu->idle_cycles = 0;
+    cpu->run_hook = NULL;
+    cpu->hook_data = NULL;
+    cpu->event_hook = NULL;
+    cpu->state_hash = 0;
+    
+    memset(&cpu->sched, 0, sizeof(cpu->sched));
+    chip8_set_clock(cpu, CHIP8_CLOCK_HZ);
     
     memcpy(cpu->memory, fontset, sizeof(fontset));
 }
 
-void chip8_load_rom(Chip8* cpu, const char* filename) {
+// Reads a ROM file and picks its quirk profile. Returns 0, after logging
+// why, if the file cannot be opened or does not fit.
+int chip8_load_rom(Chip8* cpu, const char* filename) {
     FILE* file = fopen(filename, "rb");
     if (!file) {
-        printf("Error: Could not open ROM file: %s\n", filename);
-        exit(1);
+        log_printf(LOG_ERROR, cpu->log_stream, "Could not open ROM file: %s", filename);
+        return 0;
     }
     
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    // One byte more than fits tells a full ROM from an oversized one
+    uint8_t data[MEMORY_SIZE - 0x200 + 1];
+    size_t size = fread(data, 1, sizeof(data), file);
+    fclose(file);
     
-    if (file_size > (MEMORY_SIZE - 0x200)) {
-        printf("Error: ROM file is too large\n");
-        fclose(file);
-        exit(1);
+    if (!chip8_load_rom_data(cpu, data, size)) {
+        log_printf(LOG_ERROR, cpu->log_stream, "ROM file is too large: %s", filename);
+        return 0;
     }
+    cpu->profile = chip8_profile_for_rom(filename);
     
-    size_t bytes_read = fread(cpu->memory + 0x200, 1, file_size, file);
-    fclose(file);
+    log_printf(LOG_INFO, cpu->log_stream, "Loaded %zu bytes from %s (%s quirks)", size, filename, cpu->profile->name);
+    return 1;
+}
+
+// Copies a ROM image that is already in memory. Returns 0 if it does not fit.
+int chip8_load_rom_data(Chip8* cpu, const uint8_t* data, size_t size) {
+    if (size > MEMORY_SIZE - 0x200) {
+        return 0;
+    }
     
-    printf("Loaded %zu bytes from %s\n", bytes_read, filename);
+    memcpy(cpu->memory + 0x200, data, size);
+    return 1;
+}
+
+void chip8_set_profile(Chip8* cpu, const QuirkProfile* profile) {
+    cpu->profile = profile;
+}
+
+// Seeds the Cxnn generator. Peers and replays that share a seed stay in sync.
+void chip8_seed_rng(Chip8* cpu, uint32_t seed) {
+    // xorshift must not start from zero
+    cpu->rng_state = seed ? seed : 0x2545F491;
+}
+
+static void set_key(Chip8* cpu, uint8_t key, bool pressed) {
+    if (pressed) {
+        cpu->keypad |= 1 << key;
+    } else {
+        cpu->keypad &= ~(1 << key);
+    }
+    if (cpu->event_hook) {
+        cpu->event_hook(cpu, pressed ? CHIP8_EVENT_KEY_DOWN : CHIP8_EVENT_KEY_UP, key);
+    }
+}
+
+void chip8_set_keypad_mask(Chip8* cpu, uint16_t mask) {
+    // Key by key while a tool is watching, so it sees every change
+    if (cpu->event_hook) {
+        for (uint16_t changed = cpu->keypad ^ mask; changed; changed &= changed - 1) {
+            uint8_t key = __builtin_ctz(changed);
+            set_key(cpu, key, mask & (1 << key));
+        }
+    }
+    cpu->keypad = mask;
+}
+
+uint16_t chip8_keypad_mask(const Chip8* cpu) {
+    return cpu->keypad;
+}
+
+void* chip8_alloc(size_t size) {
+    // Whole lines, which aligned_alloc requires
+    size = (size + CHIP8_CACHE_LINE - 1) & ~(size_t)(CHIP8_CACHE_LINE - 1);
+#ifdef _WIN32
+    return _aligned_malloc(size, CHIP8_CACHE_LINE);
+#else
+    return aligned_alloc(CHIP8_CACHE_LINE, size);
+#endif
+}
+
+void chip8_free(void* block) {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+}
+
+void chip8_save_state(const Chip8* cpu, Chip8* snapshot) {
+    memcpy(snapshot, cpu, sizeof(Chip8));
+}
+
+void chip8_load_state(Chip8* cpu, const Chip8* snapshot) {
+    int (*run_hook)(Chip8*, int) = cpu->run_hook;
+    void* hook_data = cpu->hook_data;
+    void (*event_hook)(Chip8*, Chip8InputType, uint8_t) = cpu->event_hook;
+    int log_stream = cpu->log_stream;
+    
+    memcpy(cpu, snapshot, sizeof(Chip8));
+    cpu->run_hook = run_hook;
+    cpu->hook_data = hook_data;
+    cpu->event_hook = event_hook;
+    cpu->log_stream = log_stream;
+}
+
+// Costs `frames` frames of emulation plus a copy of the whole machine, so
+// N frames ahead can never cost less than N + 1 plain frames. CHIP-8 frames
+// are so cheap that the copy alone is worth over half of one.
+void chip8_run_ahead(const Chip8* cpu, Chip8* future, int frames) {
+    memcpy(future, cpu, sizeof(Chip8));
+    future->run_hook = NULL;
+    future->hook_data = NULL;
+    future->event_hook = NULL;
+    future->muted = true;
+    future->log_stream = LOG_SILENT;
+    for (int i = 0; i < frames; i++) {
+        chip8_run_frame(future);
+    }
 }
 
 void chip8_cycle(Chip8* cpu) {
-    uint16_t opcode = cpu->memory[cpu->pc] << 8 | cpu->memory[cpu->pc + 1];
+    uint16_t opcode = cpu->memory[cpu->pc & ADDR_MASK] << 8 | cpu->memory[(cpu->pc + 1) & ADDR_MASK];
     cpu->pc += 2;
     
-    execute_opcode(cpu, opcode);
+    cpu->profile->step(cpu, opcode);
+    cpu->cycles++;
+    dispatch_events(cpu);
+}
+
+// Runs a batch of instructions through the profile's specialised loop
+void chip8_run(Chip8* cpu, int cycles) {
+    cpu->profile->run(cpu, cycles);
 }
 
 void chip8_decrement_timers(Chip8* cpu) {
@@ -78,8 +203,130 @@ void chip8_decrement_timers(Chip8* cpu) {
     
     if (cpu->sound_timer > 0) {
         cpu->sound_timer--;
-        if (cpu->sound_timer == 0) {
+        if (cpu->sound_timer == 0 && !cpu->muted) {
             platform_beep();
         }
     }
+    
+    if (cpu->event_hook) {
+        cpu->event_hook(cpu, CHIP8_EVENT_TIMER_TICK, 0);
+    }
+}
+
+// Sets the emulated instruction rate. Timers and frames stay at 60 Hz.
+void chip8_set_clock(Chip8* cpu, uint32_t clock_hz) {
+    Chip8Scheduler* sched = &cpu->sched;
+    
+    sched->timer_period = clock_hz / CHIP8_TIMER_HZ;
+    if (sched->timer_period == 0) {
+        sched->timer_period = 1;
+    }
+    sched->frame_period = sched->timer_period;
+    sched->next_timer = cpu->cycles + sched->timer_period;
+    sched->next_frame = cpu->cycles + sched->frame_period;
+}
+
+void chip8_queue_key(Chip8* cpu, uint8_t key, bool pressed) {
+    chip8_queue_key_at(cpu, cpu->cycles, key, pressed);
+}
+
+void chip8_queue_key_at(Chip8* cpu, uint64_t cycle, uint8_t key, bool pressed) {
+    Chip8Scheduler* sched = &cpu->sched;
+    
+    if (key >= KEY_COUNT) {
+        return;
+    }
+    
+    // Apply straight away if the queue is full rather than drop the key
+    if (sched->input_tail - sched->input_head >= CHIP8_INPUT_QUEUE_SIZE) {
+        set_key(cpu, key, pressed);
+        return;
+    }
+    
+    // Keep the FIFO ordered by cycle
+    if (sched->input_tail != sched->input_head) {
+        uint64_t last = sched->input[(sched->input_tail - 1) % CHIP8_INPUT_QUEUE_SIZE].cycle;
+        if (cycle < last) {
+            cycle = last;
+        }
+    }
+    
+    Chip8InputEvent* event = &sched->input[sched->input_tail % CHIP8_INPUT_QUEUE_SIZE];
+    event->cycle = cycle;
+    event->type = pressed ? CHIP8_EVENT_KEY_DOWN : CHIP8_EVENT_KEY_UP;
+    event->key = key;
+    sched->input_tail++;
+}
+
+// Handles every event due at or before the current cycle
+static void dispatch_events(Chip8* cpu) {
+    Chip8Scheduler* sched = &cpu->sched;
+    
+    while (sched->input_head != sched->input_tail) {
+        Chip8InputEvent* event = &sched->input[sched->input_head % CHIP8_INPUT_QUEUE_SIZE];
+        if (event->cycle > cpu->cycles) {
+            break;
+        }
+        set_key(cpu, event->key, event->type == CHIP8_EVENT_KEY_DOWN);
+        sched->input_head++;
+    }
+    
+    while (sched->next_timer <= cpu->cycles) {
+        chip8_decrement_timers(cpu);
+        sched->next_timer += sched->timer_period;
+    }
+    
+    while (sched->next_frame <= cpu->cycles) {
+        sched->frame_count++;
+        sched->next_frame += sched->frame_period;
+    }
+}
+
+static uint64_t next_event_cycle(const Chip8* cpu, uint64_t limit) {
+    const Chip8Scheduler* sched = &cpu->sched;
+    uint64_t next = limit;
+    
+    if (sched->next_timer < next) {
+        next = sched->next_timer;
+    }
+    if (sched->next_frame < next) {
+        next = sched->next_frame;
+    }
+    if (sched->input_head != sched->input_tail) {
+        uint64_t input_cycle = sched->input[sched->input_head % CHIP8_INPUT_QUEUE_SIZE].cycle;
+        if (input_cycle < next) {
+            next = input_cycle;
+        }
+    }
+    return next;
+}
+
+// Runs until the cycle counter reaches `cycle`, handling events exactly on
+// their timestamps. Instructions between events run as one uninterrupted batch.
+void chip8_run_until(Chip8* cpu, uint64_t cycle) {
+    for (;;) {
+        dispatch_events(cpu);
+        if (cpu->cycles >= cycle) {
+            break;
+        }
+        
+        uint64_t next = next_event_cycle(cpu, cycle);
+        int batch = (int)(next - cpu->cycles);
+        if (cpu->run_hook) {
+            int ran = cpu->run_hook(cpu, batch);
+            if (ran < batch) {
+                cpu->cycles += ran;
+                break;
+            }
+        } else {
+            // An idle guest cannot change state before the next event
+            cpu->idle_cycles += batch - cpu->profile->run(cpu, batch);
+        }
+        cpu->cycles = next;
+    }
+}
+
+// Runs up to and including the next frame boundary
+void chip8_run_frame(Chip8* cpu) {
+    chip8_run_until(cpu, cpu->sched.next_frame);
 }
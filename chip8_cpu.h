@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define MEMORY_SIZE 4096
 #define REGISTER_COUNT 16
@@ -11,23 +12,138 @@
 #define SCREEN_HEIGHT 32
 #define KEY_COUNT 16
 
+// Index masks for wrapping guest-controlled values
+#define ADDR_MASK (MEMORY_SIZE - 1)
+#define STACK_MASK (STACK_SIZE - 1)
+#define KEY_MASK (KEY_COUNT - 1)
+
+// Emulated clock: 600 instructions per second, timers and frames at 60 Hz
+#define CHIP8_CLOCK_HZ 600
+#define CHIP8_TIMER_HZ 60
+#define CHIP8_INPUT_QUEUE_SIZE 64
+#define CHIP8_MAX_RUN_AHEAD 3
+
+#define CHIP8_CACHE_LINE 64
+#define CHIP8_CACHE_ALIGNED _Alignas(CHIP8_CACHE_LINE)
+
+typedef struct Chip8 Chip8;
+
+typedef enum {
+    CHIP8_EVENT_KEY_DOWN,
+    CHIP8_EVENT_KEY_UP,
+    // Reported to event_hook only, never queued
+    CHIP8_EVENT_TIMER_TICK
+} Chip8InputType;
+
+typedef struct {
+    uint64_t cycle;
+    uint8_t type;
+    uint8_t key;
+} Chip8InputEvent;
+
+// Cycle-timestamped events. The timer tick and frame end are periodic, queued
+// input is a FIFO ordered by cycle.
+typedef struct {
+    uint32_t timer_period;
+    uint32_t frame_period;
+    uint64_t next_timer;
+    uint64_t next_frame;
+    uint64_t frame_count;
+    uint32_t input_head;
+    uint32_t input_tail;
+    Chip8InputEvent input[CHIP8_INPUT_QUEUE_SIZE];
+} Chip8Scheduler;
+
+// Interpreter specialised for one set of CHIP-8/SCHIP/XO-CHIP quirks
 typedef struct {
-    uint8_t memory[MEMORY_SIZE];
-    uint8_t V[REGISTER_COUNT];
+    const char* name;
+    int (*run)(Chip8* cpu, int cycles);
+    void (*step)(Chip8* cpu, uint16_t opcode);
+} QuirkProfile;
+
+// Laid out by how often the run loop touches each part. The hot block is
+// what nearly every instruction or batch reads or writes, and fills the
+// first cache line on its own. The scheduler, the stack (sharing its line
+// with the tool fields), memory and the screen each start on a line of
+// their own. Instances are cache-line aligned, so allocate them with
+// chip8_alloc rather than malloc.
+struct Chip8 {
+    // Hot block
+    CHIP8_CACHE_ALIGNED uint8_t V[REGISTER_COUNT];
     uint16_t I;
     uint16_t pc;
+    uint16_t keypad;            // bit n set while key n is down
+    uint8_t sp;
     uint8_t delay_timer;
     uint8_t sound_timer;
-    uint16_t stack[STACK_SIZE];
-    uint8_t sp;
-    uint8_t screen[SCREEN_WIDTH][SCREEN_HEIGHT];
-    uint8_t keypad[KEY_COUNT];
     bool draw_flag;
-} Chip8;
+    bool muted;
+    uint32_t rng_state;
+    uint64_t cycles;
+    uint64_t idle_cycles;
+    const QuirkProfile* profile;
+    // Instrumented replacement for profile->run (tracing, debugging).
+    // NULL on the normal path. Returns the cycles it executed; running fewer
+    // than asked (a breakpoint) makes chip8_run_until return early.
+    int (*run_hook)(Chip8* cpu, int cycles);
+    
+    CHIP8_CACHE_ALIGNED Chip8Scheduler sched;
+    
+    CHIP8_CACHE_ALIGNED uint16_t stack[STACK_SIZE];
+    void* hook_data;
+    // Incrementally maintained hash of memory, screen, V and I while the
+    // state hasher is attached (chip8_hash.h)
+    uint64_t state_hash;
+    // Log stream for messages about this instance (chip8_log.h): 0 alone,
+    // n for wall instance n. Kept by chip8_load_state, like the hooks.
+    int log_stream;
+    // Called after each timer tick and each key change takes effect, for
+    // tools that record every input to the machine (tracing). NULL normally.
+    void (*event_hook)(Chip8* cpu, Chip8InputType type, uint8_t key);
+    
+    CHIP8_CACHE_ALIGNED uint8_t memory[MEMORY_SIZE];
+    CHIP8_CACHE_ALIGNED uint8_t screen[SCREEN_WIDTH][SCREEN_HEIGHT];
+};
+
+#define CHIP8_END_OF(member) (offsetof(Chip8, member) + sizeof(((Chip8*)0)->member))
+
+_Static_assert(CHIP8_END_OF(run_hook) <= CHIP8_CACHE_LINE, "Chip8 hot block must fit one cache line");
+_Static_assert(offsetof(Chip8, sched) == CHIP8_CACHE_LINE, "Chip8 scheduler must start on the second line");
+_Static_assert(offsetof(Chip8, sched.input) < 2 * CHIP8_CACHE_LINE, "Chip8 scheduler counters must share a line");
+_Static_assert(CHIP8_END_OF(event_hook) - offsetof(Chip8, stack) <= CHIP8_CACHE_LINE, "Chip8 stack must share one line with the tool fields");
+_Static_assert(offsetof(Chip8, memory) % CHIP8_CACHE_LINE == 0, "Chip8 memory must be cache-line aligned");
+_Static_assert(offsetof(Chip8, screen) % CHIP8_CACHE_LINE == 0, "Chip8 screen must be cache-line aligned");
+_Static_assert(sizeof(Chip8) % CHIP8_CACHE_LINE == 0, "Chip8 instances must not share a cache line");
 
 void chip8_init(Chip8* cpu);
-void chip8_load_rom(Chip8* cpu, const char* filename);
+int chip8_load_rom(Chip8* cpu, const char* filename);
+int chip8_load_rom_data(Chip8* cpu, const uint8_t* data, size_t size);
+void chip8_set_profile(Chip8* cpu, const QuirkProfile* profile);
+void chip8_seed_rng(Chip8* cpu, uint32_t seed);
+void chip8_set_keypad_mask(Chip8* cpu, uint16_t mask);
+uint16_t chip8_keypad_mask(const Chip8* cpu);
+
+// Uninitialised, cache-line aligned memory for `size` bytes of machines or
+// of structures that embed them; NULL if out of memory
+void* chip8_alloc(size_t size);
+void chip8_free(void* block);
+
+// Whole-machine snapshots. The tool hooks of `cpu` are kept on restore.
+void chip8_save_state(const Chip8* cpu, Chip8* snapshot);
+void chip8_load_state(Chip8* cpu, const Chip8* snapshot);
+// Run-ahead: `future` becomes `cpu` advanced `frames` frames with its
+// current and queued input, silently and without tool hooks. `cpu` is
+// untouched, so there is nothing to restore.
+void chip8_run_ahead(const Chip8* cpu, Chip8* future, int frames);
 void chip8_cycle(Chip8* cpu);
+void chip8_run(Chip8* cpu, int cycles);
 void chip8_decrement_timers(Chip8* cpu);
 
+// Scheduler-driven execution
+void chip8_set_clock(Chip8* cpu, uint32_t clock_hz);
+void chip8_queue_key(Chip8* cpu, uint8_t key, bool pressed);
+void chip8_queue_key_at(Chip8* cpu, uint64_t cycle, uint8_t key, bool pressed);
+void chip8_run_until(Chip8* cpu, uint64_t cycle);
+void chip8_run_frame(Chip8* cpu);
+
 #endif
@@ -0,0 +1,633 @@
+#include "chip8_debugger.h"
+#include "chip8_net.h"
+#include "chip8_opcodes.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_WATCH -1
+#define MEM_DUMP_MAX 256
+// Replies a client has not read yet; one that falls this far behind is
+// dropped rather than waited for
+#define DEBUG_OUTPUT_SIZE 65536
+
+typedef struct {
+    bool active;
+    uint8_t kind;
+    uint16_t target;
+    uint16_t length;
+    // Last value seen by a register watch
+    uint16_t value;
+} Chip8Watch;
+
+struct Chip8Debugger {
+    Chip8* cpu;
+    NetSocket* listener;
+    NetSocket* client;
+    char output[DEBUG_OUTPUT_SIZE];
+    int output_length;
+    // Set when the client stopped reading or went away while sending;
+    // chip8_debugger_poll drops it, since sends also happen mid-run
+    bool client_failed;
+    char line[DEBUG_LINE_SIZE];
+    int line_length;
+    bool line_overflow;
+
+    uint8_t breakpoints[MEMORY_SIZE];
+    int breakpoint_count;
+    Chip8Watch watches[DEBUG_MAX_WATCHES];
+    int watch_count;
+
+    bool paused;
+    // Lets the instruction under a breakpoint run once execution resumes
+    bool resuming;
+    int step_remaining;
+    bool run_to_frame;
+    uint64_t target_frame;
+};
+
+static int debug_run(Chip8* cpu, int cycles);
+
+// Sends as much queued output as the socket takes without waiting
+static void flush_output(Chip8Debugger* debugger) {
+    if (!debugger->output_length || debugger->client_failed) {
+        return;
+    }
+    int sent = net_stream_send(debugger->client, debugger->output, debugger->output_length);
+    if (sent < 0) {
+        debugger->client_failed = true;
+        return;
+    }
+    debugger->output_length -= sent;
+    memmove(debugger->output, debugger->output + sent, debugger->output_length);
+}
+
+static void send_line(Chip8Debugger* debugger, const char* format, ...) {
+    if (!debugger->client || debugger->client_failed) {
+        return;
+    }
+
+    char buffer[DEBUG_LINE_SIZE * 4];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer) - 1, format, args);
+    va_end(args);
+
+    if (length < 0) {
+        return;
+    }
+    if (length > (int)sizeof(buffer) - 2) {
+        length = (int)sizeof(buffer) - 2;
+    }
+    buffer[length++] = '\n';
+
+    if (debugger->output_length + length > DEBUG_OUTPUT_SIZE) {
+        debugger->client_failed = true;
+        return;
+    }
+    memcpy(debugger->output + debugger->output_length, buffer, length);
+    debugger->output_length += length;
+    flush_output(debugger);
+}
+
+// Installs the debug run hook while something needs per-instruction checks
+// and removes it again once nothing does
+static bool update_hook(Chip8Debugger* debugger) {
+    Chip8* cpu = debugger->cpu;
+    bool needed = debugger->breakpoint_count || debugger->watch_count || debugger->step_remaining;
+
+    if (needed && cpu->run_hook != debug_run) {
+        if (cpu->run_hook) {
+            return false;
+        }
+        cpu->hook_data = debugger;
+        cpu->run_hook = debug_run;
+    } else if (!needed && cpu->run_hook == debug_run) {
+        cpu->run_hook = NULL;
+        cpu->hook_data = NULL;
+    }
+    return true;
+}
+
+static void stop(Chip8Debugger* debugger, const char* reason, uint64_t cycle) {
+    debugger->paused = true;
+    debugger->step_remaining = 0;
+    debugger->run_to_frame = false;
+    update_hook(debugger);
+    send_line(debugger, "STOP %s pc=%03X cycle=%llu", reason, debugger->cpu->pc & ADDR_MASK,
+              (unsigned long long)cycle);
+}
+
+static int register_value(const Chip8* cpu, int reg) {
+    switch (reg) {
+        case DEBUG_REG_I: return cpu->I;
+        case DEBUG_REG_DT: return cpu->delay_timer;
+        case DEBUG_REG_ST: return cpu->sound_timer;
+        case DEBUG_REG_SP: return cpu->sp;
+        default: return cpu->V[reg & 0xF];
+    }
+}
+
+static bool ranges_overlap(uint16_t a, int a_length, uint16_t b, int b_length) {
+    for (int i = 0; i < a_length; i++) {
+        uint16_t offset = (uint16_t)(((a + i) & ADDR_MASK) - b) & ADDR_MASK;
+        if (offset < b_length) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Memory watches are matched against the accesses the opcode is about to make
+static int check_memory_watches(Chip8Debugger* debugger, const Chip8* cpu, uint16_t opcode) {
+    if ((opcode & 0xF000) != 0xD000 && (opcode & 0xF000) != 0xF000) {
+        return NO_WATCH;
+    }
+
+    Chip8MemAccess access;
+    chip8_decode_mem_access(cpu, opcode, &access);
+    for (int id = 0; id < DEBUG_MAX_WATCHES; id++) {
+        const Chip8Watch* watch = &debugger->watches[id];
+        if (!watch->active || watch->kind & WATCH_REGISTER) {
+            continue;
+        }
+        if ((watch->kind & WATCH_READ) &&
+            ranges_overlap(access.read_addr, access.read_len, watch->target, watch->length)) {
+            return id;
+        }
+        if ((watch->kind & WATCH_WRITE) &&
+            ranges_overlap(access.write_addr, access.write_len, watch->target, watch->length)) {
+            return id;
+        }
+    }
+    return NO_WATCH;
+}
+
+static int check_register_watches(Chip8Debugger* debugger, const Chip8* cpu) {
+    int hit = NO_WATCH;
+    for (int id = 0; id < DEBUG_MAX_WATCHES; id++) {
+        Chip8Watch* watch = &debugger->watches[id];
+        if (!watch->active || !(watch->kind & WATCH_REGISTER)) {
+            continue;
+        }
+        uint16_t value = (uint16_t)register_value(cpu, watch->target);
+        if (value != watch->value) {
+            watch->value = value;
+            if (hit == NO_WATCH) {
+                hit = id;
+            }
+        }
+    }
+    return hit;
+}
+
+// Debug replacement for profile->run. Returns early when execution stops.
+static int debug_run(Chip8* cpu, int cycles) {
+    Chip8Debugger* debugger = cpu->hook_data;
+    if (debugger->paused) {
+        return 0;
+    }
+
+    for (int i = 0; i < cycles; i++) {
+        uint16_t pc = cpu->pc & ADDR_MASK;
+        if (debugger->breakpoints[pc] && !debugger->resuming) {
+            stop(debugger, "break", cpu->cycles + i);
+            return i;
+        }
+        debugger->resuming = false;
+
+        uint16_t opcode = cpu->memory[pc] << 8 | cpu->memory[(pc + 1) & ADDR_MASK];
+        int hit = NO_WATCH;
+        if (debugger->watch_count) {
+            hit = check_memory_watches(debugger, cpu, opcode);
+        }
+
+        cpu->pc += 2;
+        cpu->profile->step(cpu, opcode);
+
+        if (debugger->watch_count) {
+            int register_hit = check_register_watches(debugger, cpu);
+            if (hit == NO_WATCH) {
+                hit = register_hit;
+            }
+        }
+        if (hit != NO_WATCH) {
+            char reason[32];
+            snprintf(reason, sizeof(reason), "watch %d at=%03X", hit, pc);
+            stop(debugger, reason, cpu->cycles + i + 1);
+            return i + 1;
+        }
+        if (debugger->step_remaining && --debugger->step_remaining == 0) {
+            stop(debugger, "step", cpu->cycles + i + 1);
+            return i + 1;
+        }
+    }
+    return cycles;
+}
+
+Chip8Debugger* chip8_debugger_create(Chip8* cpu, uint16_t port) {
+    if (cpu->run_hook) {
+        printf("Error: another tool is already attached to this instance\n");
+        return NULL;
+    }
+    if (!net_init()) {
+        return NULL;
+    }
+
+    Chip8Debugger* debugger = calloc(1, sizeof(Chip8Debugger));
+    if (!debugger) {
+        net_cleanup();
+        return NULL;
+    }
+
+    debugger->cpu = cpu;
+    debugger->listener = net_tcp_listen(port);
+    if (!debugger->listener) {
+        free(debugger);
+        net_cleanup();
+        return NULL;
+    }
+
+    printf("Debugger listening on 127.0.0.1:%u\n", port);
+    return debugger;
+}
+
+static void reset_session(Chip8Debugger* debugger) {
+    memset(debugger->breakpoints, 0, sizeof(debugger->breakpoints));
+    memset(debugger->watches, 0, sizeof(debugger->watches));
+    debugger->breakpoint_count = 0;
+    debugger->watch_count = 0;
+    debugger->step_remaining = 0;
+    debugger->run_to_frame = false;
+    debugger->paused = false;
+    update_hook(debugger);
+}
+
+// A client that goes away must not leave the instance stopped
+static void close_client(Chip8Debugger* debugger) {
+    net_close(debugger->client);
+    debugger->client = NULL;
+    reset_session(debugger);
+}
+
+void chip8_debugger_destroy(Chip8Debugger* debugger) {
+    if (!debugger) {
+        return;
+    }
+
+    reset_session(debugger);
+    net_close(debugger->client);
+    net_close(debugger->listener);
+    free(debugger);
+    net_cleanup();
+}
+
+bool chip8_debugger_paused(const Chip8Debugger* debugger) {
+    return debugger->paused;
+}
+
+bool chip8_debugger_set_breakpoint(Chip8Debugger* debugger, uint16_t addr, bool enabled) {
+    addr &= ADDR_MASK;
+    if (debugger->breakpoints[addr] == enabled) {
+        return true;
+    }
+
+    debugger->breakpoints[addr] = enabled;
+    debugger->breakpoint_count += enabled ? 1 : -1;
+    if (!update_hook(debugger)) {
+        debugger->breakpoints[addr] = 0;
+        debugger->breakpoint_count--;
+        return false;
+    }
+    return true;
+}
+
+int chip8_debugger_add_watch(Chip8Debugger* debugger, uint8_t kind, uint16_t target, uint16_t length) {
+    for (int id = 0; id < DEBUG_MAX_WATCHES; id++) {
+        Chip8Watch* watch = &debugger->watches[id];
+        if (watch->active) {
+            continue;
+        }
+
+        watch->active = true;
+        watch->kind = kind;
+        watch->target = (kind & WATCH_REGISTER) ? target : (target & ADDR_MASK);
+        watch->length = length ? length : 1;
+        watch->value = (kind & WATCH_REGISTER) ? (uint16_t)register_value(debugger->cpu, target) : 0;
+        debugger->watch_count++;
+        if (!update_hook(debugger)) {
+            chip8_debugger_remove_watch(debugger, id);
+            return -1;
+        }
+        return id;
+    }
+    return -1;
+}
+
+bool chip8_debugger_remove_watch(Chip8Debugger* debugger, int id) {
+    if (id < 0 || id >= DEBUG_MAX_WATCHES || !debugger->watches[id].active) {
+        return false;
+    }
+    debugger->watches[id].active = false;
+    debugger->watch_count--;
+    update_hook(debugger);
+    return true;
+}
+
+void chip8_debugger_pause(Chip8Debugger* debugger) {
+    if (!debugger->paused) {
+        stop(debugger, "pause", debugger->cpu->cycles);
+    }
+}
+
+void chip8_debugger_resume(Chip8Debugger* debugger) {
+    if (debugger->paused) {
+        debugger->paused = false;
+        debugger->resuming = true;
+    }
+}
+
+bool chip8_debugger_step(Chip8Debugger* debugger, int count) {
+    debugger->step_remaining = count > 0 ? count : 1;
+    if (!update_hook(debugger)) {
+        debugger->step_remaining = 0;
+        return false;
+    }
+    chip8_debugger_resume(debugger);
+    return true;
+}
+
+void chip8_debugger_run_frames(Chip8Debugger* debugger, int count) {
+    debugger->run_to_frame = true;
+    debugger->target_frame = debugger->cpu->sched.frame_count + (count > 0 ? count : 1);
+    chip8_debugger_resume(debugger);
+}
+
+// Command handling
+
+static bool parse_register(const char* name, int* reg) {
+    if ((name[0] == 'V' || name[0] == 'v') && name[1] && !name[2]) {
+        char* end;
+        long index = strtol(name + 1, &end, 16);
+        if (*end == '\0') {
+            *reg = (int)index;
+            return true;
+        }
+    }
+    if (strcmp(name, "I") == 0) *reg = DEBUG_REG_I;
+    else if (strcmp(name, "DT") == 0) *reg = DEBUG_REG_DT;
+    else if (strcmp(name, "ST") == 0) *reg = DEBUG_REG_ST;
+    else if (strcmp(name, "SP") == 0) *reg = DEBUG_REG_SP;
+    else return false;
+    return true;
+}
+
+static bool parse_hex(const char* text, long* value) {
+    char* end;
+    if (!text) {
+        return false;
+    }
+    *value = strtol(text, &end, 16);
+    return *end == '\0' && end != text;
+}
+
+static void send_regs(Chip8Debugger* debugger) {
+    const Chip8* cpu = debugger->cpu;
+    char v[REGISTER_COUNT * 3 + 1];
+    for (int r = 0; r < REGISTER_COUNT; r++) {
+        snprintf(v + r * 3, 4, "%02X ", cpu->V[r]);
+    }
+    v[REGISTER_COUNT * 3 - 1] = '\0';
+
+    send_line(debugger, "OK pc=%03X I=%03X sp=%X dt=%02X st=%02X V=%s", cpu->pc & ADDR_MASK, cpu->I,
+              cpu->sp, cpu->delay_timer, cpu->sound_timer, v);
+}
+
+static void send_memory(Chip8Debugger* debugger, long addr, long length) {
+    char dump[MEM_DUMP_MAX * 3 + 1];
+    if (length < 1 || length > MEM_DUMP_MAX) {
+        send_line(debugger, "ERR length must be 1-%d", MEM_DUMP_MAX);
+        return;
+    }
+    for (long i = 0; i < length; i++) {
+        snprintf(dump + i * 3, 4, " %02X", debugger->cpu->memory[(addr + i) & ADDR_MASK]);
+    }
+    send_line(debugger, "OK %03lX:%s", addr & ADDR_MASK, dump);
+}
+
+static void command_watch(Chip8Debugger* debugger, char* args[], int count) {
+    int id = -1;
+    if (count >= 3 && strcmp(args[1], "reg") == 0) {
+        int reg;
+        if (!parse_register(args[2], &reg)) {
+            send_line(debugger, "ERR unknown register %s", args[2]);
+            return;
+        }
+        id = chip8_debugger_add_watch(debugger, WATCH_REGISTER, (uint16_t)reg, 1);
+    } else if (count >= 3 && strcmp(args[1], "mem") == 0) {
+        long addr;
+        long length = 1;
+        uint8_t kind = WATCH_WRITE;
+        if (!parse_hex(args[2], &addr) || (count >= 4 && !parse_hex(args[3], &length))) {
+            send_line(debugger, "ERR bad address or length");
+            return;
+        }
+        if (count >= 5) {
+            kind = 0;
+            if (strchr(args[4], 'r')) kind |= WATCH_READ;
+            if (strchr(args[4], 'w')) kind |= WATCH_WRITE;
+        }
+        if (!kind || length < 1 || length > MEMORY_SIZE) {
+            send_line(debugger, "ERR bad watch mode or length");
+            return;
+        }
+        id = chip8_debugger_add_watch(debugger, kind, (uint16_t)addr, (uint16_t)length);
+    } else {
+        send_line(debugger, "ERR usage: watch mem <addr> [len] [r|w|rw] | watch reg <name>");
+        return;
+    }
+
+    if (id < 0) {
+        send_line(debugger, "ERR watch table full or another tool is attached");
+    } else {
+        send_line(debugger, "OK watch %d", id);
+    }
+}
+
+static void command_lists(Chip8Debugger* debugger, bool watches) {
+    char text[DEBUG_LINE_SIZE * 3] = "OK";
+    size_t used = 2;
+
+    if (watches) {
+        for (int id = 0; id < DEBUG_MAX_WATCHES; id++) {
+            const Chip8Watch* watch = &debugger->watches[id];
+            if (!watch->active) {
+                continue;
+            }
+            if (watch->kind & WATCH_REGISTER) {
+                used += snprintf(text + used, sizeof(text) - used, " %d:reg:%d", id, watch->target);
+            } else {
+                used += snprintf(text + used, sizeof(text) - used, " %d:mem:%03X+%u:%s%s", id,
+                                 watch->target, watch->length, watch->kind & WATCH_READ ? "r" : "",
+                                 watch->kind & WATCH_WRITE ? "w" : "");
+            }
+            if (used >= sizeof(text)) break;
+        }
+    } else {
+        for (int addr = 0; addr < MEMORY_SIZE && used + 5 < sizeof(text); addr++) {
+            if (debugger->breakpoints[addr]) {
+                used += snprintf(text + used, sizeof(text) - used, " %03X", addr);
+            }
+        }
+    }
+    send_line(debugger, "%s", text);
+}
+
+static void handle_command(Chip8Debugger* debugger, char* line) {
+    char* args[8];
+    int count = 0;
+    for (char* token = strtok(line, " \t\r"); token && count < 8; token = strtok(NULL, " \t\r")) {
+        args[count++] = token;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    const char* command = args[0];
+    long value;
+    long extra;
+
+    if (strcmp(command, "break") == 0 || strcmp(command, "clear") == 0) {
+        if (count < 2 || !parse_hex(args[1], &value)) {
+            send_line(debugger, "ERR usage: %s <addr>", command);
+        } else if (!chip8_debugger_set_breakpoint(debugger, (uint16_t)value, command[0] == 'b')) {
+            send_line(debugger, "ERR another tool is attached");
+        } else {
+            send_line(debugger, "OK");
+        }
+    } else if (strcmp(command, "breaks") == 0) {
+        command_lists(debugger, false);
+    } else if (strcmp(command, "watch") == 0) {
+        command_watch(debugger, args, count);
+    } else if (strcmp(command, "unwatch") == 0) {
+        bool removed = count >= 2 && chip8_debugger_remove_watch(debugger, atoi(args[1]));
+        send_line(debugger, removed ? "OK" : "ERR no such watch");
+    } else if (strcmp(command, "watches") == 0) {
+        command_lists(debugger, true);
+    } else if (strcmp(command, "pause") == 0) {
+        send_line(debugger, "OK");
+        chip8_debugger_pause(debugger);
+    } else if (strcmp(command, "continue") == 0) {
+        chip8_debugger_resume(debugger);
+        send_line(debugger, "OK");
+    } else if (strcmp(command, "step") == 0) {
+        int steps = count >= 2 ? atoi(args[1]) : 1;
+        send_line(debugger, chip8_debugger_step(debugger, steps) ? "OK" : "ERR another tool is attached");
+    } else if (strcmp(command, "frame") == 0) {
+        chip8_debugger_run_frames(debugger, count >= 2 ? atoi(args[1]) : 1);
+        send_line(debugger, "OK");
+    } else if (strcmp(command, "status") == 0) {
+        send_line(debugger, "OK %s frame=%llu cycle=%llu", debugger->paused ? "paused" : "running",
+                  (unsigned long long)debugger->cpu->sched.frame_count,
+                  (unsigned long long)debugger->cpu->cycles);
+    } else if (strcmp(command, "regs") == 0) {
+        send_regs(debugger);
+    } else if (strcmp(command, "mem") == 0) {
+        if (count < 2 || !parse_hex(args[1], &value)) {
+            send_line(debugger, "ERR usage: mem <addr> [len]");
+        } else {
+            send_memory(debugger, value, count >= 3 ? strtol(args[2], NULL, 16) : 16);
+        }
+    } else if (strcmp(command, "poke") == 0) {
+        if (count < 3 || !parse_hex(args[1], &value)) {
+            send_line(debugger, "ERR usage: poke <addr> <byte>...");
+            return;
+        }
+        for (int i = 2; i < count; i++) {
+            if (!parse_hex(args[i], &extra) || extra < 0 || extra > 0xFF) {
+                send_line(debugger, "ERR bad byte %s", args[i]);
+                return;
+            }
+            debugger->cpu->memory[(value + i - 2) & ADDR_MASK] = (uint8_t)extra;
+        }
+        send_line(debugger, "OK");
+    } else if (strcmp(command, "detach") == 0) {
+        send_line(debugger, "OK");
+        flush_output(debugger);
+        close_client(debugger);
+    } else {
+        send_line(debugger, "ERR unknown command %s", command);
+    }
+}
+
+static void read_client(Chip8Debugger* debugger) {
+    char buffer[DEBUG_LINE_SIZE];
+
+    while (debugger->client) {
+        int received = net_stream_recv(debugger->client, buffer, sizeof(buffer));
+        if (received == 0) {
+            return;
+        }
+        if (received < 0) {
+            printf("Debugger client disconnected\n");
+            close_client(debugger);
+            return;
+        }
+
+        for (int i = 0; i < received && debugger->client; i++) {
+            char c = buffer[i];
+            if (c != '\n') {
+                if (debugger->line_length < DEBUG_LINE_SIZE - 1) {
+                    debugger->line[debugger->line_length++] = c;
+                } else {
+                    debugger->line_overflow = true;
+                }
+                continue;
+            }
+
+            debugger->line[debugger->line_length] = '\0';
+            if (debugger->line_overflow) {
+                send_line(debugger, "ERR line too long");
+            } else {
+                handle_command(debugger, debugger->line);
+            }
+            debugger->line_length = 0;
+            debugger->line_overflow = false;
+        }
+    }
+}
+
+void chip8_debugger_poll(Chip8Debugger* debugger) {
+    NetSocket* incoming;
+    while ((incoming = net_tcp_accept(debugger->listener)) != NULL) {
+        if (debugger->client) {
+            const char busy[] = "ERR another client is attached\n";
+            net_stream_send(incoming, busy, (int)sizeof(busy) - 1);
+            net_close(incoming);
+            continue;
+        }
+        debugger->client = incoming;
+        debugger->output_length = 0;
+        debugger->client_failed = false;
+        debugger->line_length = 0;
+        debugger->line_overflow = false;
+        printf("Debugger client attached\n");
+        send_line(debugger, "CHIP8 debugger, %s", debugger->paused ? "paused" : "running");
+    }
+
+    read_client(debugger);
+
+    if (debugger->client) {
+        flush_output(debugger);
+        if (debugger->client_failed) {
+            printf("Debugger client is not taking replies, disconnected\n");
+            close_client(debugger);
+        }
+    }
+
+    if (debugger->run_to_frame && !debugger->paused &&
+        debugger->cpu->sched.frame_count >= debugger->target_frame) {
+        stop(debugger, "frame", debugger->cpu->cycles);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef CHIP8_DEBUGGER_H
+#define CHIP8_DEBUGGER_H
+
+#include "chip8_cpu.h"
+
+// Debugger with a line-based remote protocol on a loopback TCP port
+//
+// Breakpoints live in a byte-per-address map that is only consulted by the
+// debugger's own run hook. The hook is installed while a breakpoint,
+// watchpoint or step is pending and removed afterwards, so an attached but
+// idle debugger costs the normal run loop nothing.
+//
+// Protocol: one command per line, one "OK ..." or "ERR ..." reply per
+// command. "STOP <reason> ..." lines are sent whenever execution pauses.
+//   break <addr>           clear <addr>            breaks
+//   watch mem <addr> [len] [r|w|rw]                watch reg <V0-VF|I|DT|ST|SP>
+//   unwatch <id>           watches
+//   pause                  continue                step [count]
+//   frame [count]          status                  regs
+//   mem <addr> [len]       poke <addr> <byte>...   detach
+// Addresses and bytes are hex. Detaching (or disconnecting) clears all
+// breakpoints and watchpoints and resumes the instance.
+
+#define DEBUG_MAX_WATCHES 16
+#define DEBUG_LINE_SIZE 256
+
+#define WATCH_READ     0x01
+#define WATCH_WRITE    0x02
+#define WATCH_REGISTER 0x04
+
+// Register numbers for watchpoints: V0-VF are 0-15
+#define DEBUG_REG_I  16
+#define DEBUG_REG_DT 17
+#define DEBUG_REG_ST 18
+#define DEBUG_REG_SP 19
+
+typedef struct Chip8Debugger Chip8Debugger;
+
+// Listens on 127.0.0.1:`port` for a debugging client. Fails if another tool
+// is already attached to `cpu`.
+Chip8Debugger* chip8_debugger_create(Chip8* cpu, uint16_t port);
+void chip8_debugger_destroy(Chip8Debugger* debugger);
+
+// Accepts a client and runs its commands; call once per host frame
+void chip8_debugger_poll(Chip8Debugger* debugger);
+// While paused, the host must not advance the instance
+bool chip8_debugger_paused(const Chip8Debugger* debugger);
+
+bool chip8_debugger_set_breakpoint(Chip8Debugger* debugger, uint16_t addr, bool enabled);
+// Returns the watch id, or -1 if the table is full
+int chip8_debugger_add_watch(Chip8Debugger* debugger, uint8_t kind, uint16_t target, uint16_t length);
+bool chip8_debugger_remove_watch(Chip8Debugger* debugger, int id);
+
+void chip8_debugger_pause(Chip8Debugger* debugger);
+void chip8_debugger_resume(Chip8Debugger* debugger);
+// Executes `count` instructions, then pauses
+bool chip8_debugger_step(Chip8Debugger* debugger, int count);
+// Runs until `count` more frames have completed, then pauses
+void chip8_debugger_run_frames(Chip8Debugger* debugger, int count);
+
+#endif
@@ -0,0 +1,139 @@
+#define SDL_MAIN_HANDLED
+#include "chip8_cpu.h"
+#include "chip8_search.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Searches a ROM's state space for input sequences that reach a goal
+
+typedef struct {
+    int pc;
+    int mem_addr;
+    int mem_value;
+} ExploreGoal;
+
+// Headless runs are silent
+void platform_beep(void) {
+}
+
+static bool reached_goal(const Chip8* cpu, void* context) {
+    const ExploreGoal* goal = context;
+    if (goal->pc >= 0 && (cpu->pc & ADDR_MASK) == goal->pc) {
+        return true;
+    }
+    return goal->mem_addr >= 0 && cpu->memory[goal->mem_addr] == goal->mem_value;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage: %s <rom> [options]\n", program);
+    printf("  --depth N          input steps to search (default 32)\n");
+    printf("  --hold N           frames each input is held (default 4)\n");
+    printf("  --keys HEX         keys to try, e.g. 14CD (default all)\n");
+    printf("  --threads N        extra worker threads\n");
+    printf("  --frontier N       states kept per level (default 8192)\n");
+    printf("  --goal-pc ADDR     stop when a step ends with the PC at ADDR\n");
+    printf("  --goal-mem A=V     stop when memory[A] == V (hex)\n");
+    printf("  --full-hash        rehash every state from scratch instead\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    SearchConfig config;
+    chip8_search_default_config(&config);
+    ExploreGoal goal = {-1, -1, 0};
+    uint16_t inputs[KEY_COUNT + 1];
+    const char* keys = NULL;
+
+    for (int i = 2; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (strcmp(option, "--full-hash") == 0) {
+            config.full_hash = true;
+            continue;
+        }
+        if (!value) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+
+        if (strcmp(option, "--depth") == 0) {
+            config.max_depth = atoi(value);
+        } else if (strcmp(option, "--hold") == 0) {
+            config.frames_per_step = atoi(value);
+        } else if (strcmp(option, "--keys") == 0) {
+            keys = value;
+        } else if (strcmp(option, "--threads") == 0) {
+            config.threads = atoi(value);
+        } else if (strcmp(option, "--frontier") == 0) {
+            config.max_frontier = atoi(value);
+        } else if (strcmp(option, "--goal-pc") == 0) {
+            goal.pc = (int)strtol(value, NULL, 16) & ADDR_MASK;
+        } else if (strcmp(option, "--goal-mem") == 0) {
+            char* end;
+            goal.mem_addr = (int)strtol(value, &end, 16) & ADDR_MASK;
+            goal.mem_value = (*end == '=') ? (int)strtol(end + 1, NULL, 16) : 0;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // No key plus each listed key on its own
+    if (keys) {
+        config.input_count = 0;
+        inputs[config.input_count++] = 0;
+        for (const char* c = keys; *c && config.input_count <= KEY_COUNT; c++) {
+            char digit[2] = {*c, '\0'};
+            inputs[config.input_count++] = 1 << (strtol(digit, NULL, 16) & KEY_MASK);
+        }
+        config.inputs = inputs;
+    }
+    if (goal.pc >= 0 || goal.mem_addr >= 0) {
+        config.goal = reached_goal;
+        config.goal_context = &goal;
+    }
+
+    static Chip8 cpu;
+    chip8_init(&cpu);
+    chip8_seed_rng(&cpu, 1);
+    if (!chip8_load_rom(&cpu, argv[1])) {
+        return 1;
+    }
+    cpu.muted = true;
+
+    SearchResult result;
+    if (!chip8_search_run(&cpu, &config, &result)) {
+        return 1;
+    }
+
+    printf("Depth %d, %llu states expanded, %llu unique, %llu duplicate, %llu dropped\n",
+           result.depth, (unsigned long long)result.expanded, (unsigned long long)result.unique,
+           (unsigned long long)result.duplicates, (unsigned long long)result.dropped);
+    printf("%.3f s, %.0f states/s (%s hashing)\n", result.seconds,
+           result.seconds > 0 ? result.expanded / result.seconds : 0.0,
+           config.full_hash ? "full" : "incremental");
+
+    if (result.found) {
+        printf("Goal reached after %d steps of %d frames. Keys:", result.depth,
+               config.frames_per_step);
+        for (int d = 0; d < result.depth; d++) {
+            uint16_t mask = result.path[d];
+            if (mask) {
+                printf(" %X", __builtin_ctz(mask));
+            } else {
+                printf(" -");
+            }
+        }
+        printf("\n");
+    } else if (config.goal) {
+        printf("Goal not reached\n");
+    }
+    return result.found || !config.goal ? 0 : 2;
+}
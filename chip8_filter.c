@@ -0,0 +1,560 @@
+#include "chip8_filter.h"
+#include "chip8_pool.h"
+#include "chip8_spans.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FILTER_SSE2 1
+#endif
+
+#define MAP_WIDTH  (SCREEN_WIDTH * FILTER_MAX_FACTOR)
+#define MAP_HEIGHT (SCREEN_HEIGHT * FILTER_MAX_FACTOR)
+// Maps keep a border that repeats the edge pixels, so the scalers read every
+// neighbour without bounds checks, a whole vector at a time
+#define MAP_PAD 16
+#define MAP_STRIDE (MAP_WIDTH + 2 * MAP_PAD)
+#define PIXEL_ON  0xFF
+#define PIXEL_OFF 0x00
+
+// Brightness of an output row by its position inside a map row
+enum {
+    SHADE_FULL,
+    SHADE_GAP,
+    SHADE_COUNT
+};
+
+// Channel weights out of 256
+#define WEIGHT_FULL 256
+#define WEIGHT_SCANLINE_GAP 128
+#define WEIGHT_CRT_GAP 96
+#define WEIGHT_CRT_MASK 160
+
+typedef uint8_t PixelMap[MAP_HEIGHT + 2][MAP_STRIDE];
+
+struct FilterPipeline {
+    WorkerPool* pool;
+    FilterScaler scaler;
+    FilterPost post;
+
+    // Scaled screen, PIXEL_ON/PIXEL_OFF bytes, row-major
+    PixelMap map;
+    PixelMap temp;
+    int map_width;
+    int map_height;
+
+    // Output tables for the size and mode they were built for
+    int width;
+    int height;
+    FilterScaler table_scaler;
+    FilterPost table_post;
+    int* column_start;   // first output column of each map column, map_width + 1
+    uint16_t* row_map;
+    uint8_t* row_shade;
+    uint32_t* lines;     // [SHADE_COUNT][off, on][width]
+    uint8_t* scratch;    // [FILTER_BANDS][width] expanded map row per band
+    uint32_t* band_lines; // [FILTER_BANDS][width] last line built per band
+
+    // Current frame
+    uint8_t* pixels;
+    int pitch;
+};
+
+static const char* scaler_names[SCALER_COUNT] = {"None", "Scale2x", "Scale3x", "Scale4x", "EPX"};
+static const char* post_names[POST_COUNT] = {"None", "Scanlines", "CRT"};
+
+FilterPipeline* filter_create(int threads) {
+    FilterPipeline* filter = calloc(1, sizeof(FilterPipeline));
+    if (!filter) {
+        return NULL;
+    }
+    filter->pool = pool_create(threads);
+    if (!filter->pool) {
+        free(filter);
+        return NULL;
+    }
+    filter->table_scaler = SCALER_COUNT;
+    return filter;
+}
+
+static void free_tables(FilterPipeline* filter) {
+    free(filter->column_start);
+    free(filter->row_map);
+    free(filter->row_shade);
+    free(filter->lines);
+    free(filter->scratch);
+    free(filter->band_lines);
+    filter->column_start = NULL;
+    filter->row_map = NULL;
+    filter->row_shade = NULL;
+    filter->lines = NULL;
+    filter->scratch = NULL;
+    filter->band_lines = NULL;
+    filter->width = 0;
+    filter->height = 0;
+}
+
+void filter_destroy(FilterPipeline* filter) {
+    if (!filter) {
+        return;
+    }
+    free_tables(filter);
+    pool_destroy(filter->pool);
+    free(filter);
+}
+
+void filter_set_mode(FilterPipeline* filter, FilterScaler scaler, FilterPost post) {
+    filter->scaler = (scaler >= 0 && scaler < SCALER_COUNT) ? scaler : SCALER_NONE;
+    filter->post = (post >= 0 && post < POST_COUNT) ? post : POST_NONE;
+}
+
+FilterScaler filter_scaler(const FilterPipeline* filter) {
+    return filter->scaler;
+}
+
+FilterPost filter_post(const FilterPipeline* filter) {
+    return filter->post;
+}
+
+const char* filter_scaler_name(FilterScaler scaler) {
+    return (scaler >= 0 && scaler < SCALER_COUNT) ? scaler_names[scaler] : "?";
+}
+
+const char* filter_post_name(FilterPost post) {
+    return (post >= 0 && post < POST_COUNT) ? post_names[post] : "?";
+}
+
+// Pixel-art scalers on PIXEL_ON/PIXEL_OFF maps, written once against a
+// small lane API: 16 pixels per step with SSE2, one otherwise.
+//   A B C
+//   D E F
+//   G H I
+
+#ifdef FILTER_SSE2
+typedef __m128i Lanes;
+#define LANE_COUNT 16
+
+static inline Lanes lanes_load(const uint8_t* p) {
+    return _mm_loadu_si128((const __m128i*)p);
+}
+
+static inline Lanes lanes_eq(Lanes a, Lanes b) {
+    return _mm_cmpeq_epi8(a, b);
+}
+
+static inline Lanes lanes_and(Lanes a, Lanes b) {
+    return _mm_and_si128(a, b);
+}
+
+static inline Lanes lanes_or(Lanes a, Lanes b) {
+    return _mm_or_si128(a, b);
+}
+
+// a & ~b
+static inline Lanes lanes_and_not(Lanes a, Lanes b) {
+    return _mm_andnot_si128(b, a);
+}
+
+static inline Lanes lanes_select(Lanes mask, Lanes a, Lanes b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// out = a0 b0 a1 b1 ...
+static inline void lanes_store2(uint8_t* out, Lanes a, Lanes b) {
+    _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(a, b));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(a, b));
+}
+
+// out = a0 b0 c0 a1 b1 c1 ...; SSE2 has no byte shuffle, so via memory
+static inline void lanes_store3(uint8_t* out, Lanes a, Lanes b, Lanes c) {
+    uint8_t lanes[3][LANE_COUNT];
+    _mm_storeu_si128((__m128i*)lanes[0], a);
+    _mm_storeu_si128((__m128i*)lanes[1], b);
+    _mm_storeu_si128((__m128i*)lanes[2], c);
+    for (int i = 0; i < LANE_COUNT; i++) {
+        out[3 * i] = lanes[0][i];
+        out[3 * i + 1] = lanes[1][i];
+        out[3 * i + 2] = lanes[2][i];
+    }
+}
+#else
+typedef uint8_t Lanes;
+#define LANE_COUNT 1
+
+static inline Lanes lanes_load(const uint8_t* p) {
+    return *p;
+}
+
+static inline Lanes lanes_eq(Lanes a, Lanes b) {
+    return a == b ? 0xFF : 0x00;
+}
+
+static inline Lanes lanes_and(Lanes a, Lanes b) {
+    return a & b;
+}
+
+static inline Lanes lanes_or(Lanes a, Lanes b) {
+    return a | b;
+}
+
+static inline Lanes lanes_and_not(Lanes a, Lanes b) {
+    return a & ~b;
+}
+
+static inline Lanes lanes_select(Lanes mask, Lanes a, Lanes b) {
+    return (mask & a) | (~mask & b);
+}
+
+static inline void lanes_store2(uint8_t* out, Lanes a, Lanes b) {
+    out[0] = a;
+    out[1] = b;
+}
+
+static inline void lanes_store3(uint8_t* out, Lanes a, Lanes b, Lanes c) {
+    out[0] = a;
+    out[1] = b;
+    out[2] = c;
+}
+#endif
+
+static uint8_t* map_row(PixelMap map, int y) {
+    return map[y + 1] + MAP_PAD;
+}
+
+static void pad_edges(PixelMap map, int w, int h) {
+    for (int y = 0; y < h; y++) {
+        uint8_t* row = map_row(map, y);
+        row[-1] = row[0];
+        row[w] = row[w - 1];
+    }
+    memcpy(map_row(map, -1) - 1, map_row(map, 0) - 1, w + 2);
+    memcpy(map_row(map, h) - 1, map_row(map, h - 1) - 1, w + 2);
+}
+
+// Widths are multiples of 16 (64 or 128), so no step runs past the border
+static void scale2x(PixelMap dst, PixelMap src, int w, int h) {
+    pad_edges(src, w, h);
+    for (int y = 0; y < h; y++) {
+        const uint8_t* up = map_row(src, y - 1);
+        const uint8_t* row = map_row(src, y);
+        const uint8_t* down = map_row(src, y + 1);
+        uint8_t* top = map_row(dst, 2 * y);
+        uint8_t* bottom = map_row(dst, 2 * y + 1);
+
+        for (int x = 0; x < w; x += LANE_COUNT) {
+            Lanes B = lanes_load(up + x);
+            Lanes D = lanes_load(row + x - 1);
+            Lanes E = lanes_load(row + x);
+            Lanes F = lanes_load(row + x + 1);
+            Lanes H = lanes_load(down + x);
+
+            // Only corners of an edge change: B != H and D != F
+            Lanes flat = lanes_or(lanes_eq(B, H), lanes_eq(D, F));
+            lanes_store2(top + 2 * x,
+                         lanes_select(lanes_and_not(lanes_eq(D, B), flat), D, E),
+                         lanes_select(lanes_and_not(lanes_eq(B, F), flat), F, E));
+            lanes_store2(bottom + 2 * x,
+                         lanes_select(lanes_and_not(lanes_eq(D, H), flat), D, E),
+                         lanes_select(lanes_and_not(lanes_eq(H, F), flat), F, E));
+        }
+    }
+}
+
+static void scale3x(PixelMap dst, PixelMap src, int w, int h) {
+    pad_edges(src, w, h);
+    for (int y = 0; y < h; y++) {
+        const uint8_t* up = map_row(src, y - 1);
+        const uint8_t* row = map_row(src, y);
+        const uint8_t* down = map_row(src, y + 1);
+        uint8_t* top = map_row(dst, 3 * y);
+        uint8_t* middle = map_row(dst, 3 * y + 1);
+        uint8_t* bottom = map_row(dst, 3 * y + 2);
+
+        for (int x = 0; x < w; x += LANE_COUNT) {
+            Lanes A = lanes_load(up + x - 1);
+            Lanes B = lanes_load(up + x);
+            Lanes C = lanes_load(up + x + 1);
+            Lanes D = lanes_load(row + x - 1);
+            Lanes E = lanes_load(row + x);
+            Lanes F = lanes_load(row + x + 1);
+            Lanes G = lanes_load(down + x - 1);
+            Lanes H = lanes_load(down + x);
+            Lanes I = lanes_load(down + x + 1);
+
+            Lanes flat = lanes_or(lanes_eq(B, H), lanes_eq(D, F));
+            Lanes db = lanes_and_not(lanes_eq(D, B), flat);
+            Lanes bf = lanes_and_not(lanes_eq(B, F), flat);
+            Lanes dh = lanes_and_not(lanes_eq(D, H), flat);
+            Lanes hf = lanes_and_not(lanes_eq(H, F), flat);
+
+            lanes_store3(top + 3 * x,
+                         lanes_select(db, D, E),
+                         lanes_select(lanes_or(lanes_and_not(db, lanes_eq(E, C)),
+                                               lanes_and_not(bf, lanes_eq(E, A))), B, E),
+                         lanes_select(bf, F, E));
+            lanes_store3(middle + 3 * x,
+                         lanes_select(lanes_or(lanes_and_not(db, lanes_eq(E, G)),
+                                               lanes_and_not(dh, lanes_eq(E, A))), D, E),
+                         E,
+                         lanes_select(lanes_or(lanes_and_not(bf, lanes_eq(E, I)),
+                                               lanes_and_not(hf, lanes_eq(E, C))), F, E));
+            lanes_store3(bottom + 3 * x,
+                         lanes_select(dh, D, E),
+                         lanes_select(lanes_or(lanes_and_not(dh, lanes_eq(E, I)),
+                                               lanes_and_not(hf, lanes_eq(E, G))), H, E),
+                         lanes_select(hf, F, E));
+        }
+    }
+}
+
+// Eric's Pixel Expansion. Neighbours here are A above, B right, C left and
+// D below; a pixel with three or four equal neighbours is left alone.
+static void epx(PixelMap dst, PixelMap src, int w, int h) {
+    pad_edges(src, w, h);
+    for (int y = 0; y < h; y++) {
+        const uint8_t* row = map_row(src, y);
+        uint8_t* top = map_row(dst, 2 * y);
+        uint8_t* bottom = map_row(dst, 2 * y + 1);
+
+        for (int x = 0; x < w; x += LANE_COUNT) {
+            Lanes P = lanes_load(row + x);
+            Lanes A = lanes_load(map_row(src, y - 1) + x);
+            Lanes B = lanes_load(row + x + 1);
+            Lanes C = lanes_load(row + x - 1);
+            Lanes D = lanes_load(map_row(src, y + 1) + x);
+
+            Lanes ab = lanes_eq(A, B);
+            Lanes ac = lanes_eq(A, C);
+            Lanes ad = lanes_eq(A, D);
+            Lanes bc = lanes_eq(B, C);
+            Lanes bd = lanes_eq(B, D);
+            Lanes cd = lanes_eq(C, D);
+            Lanes keep = lanes_or(lanes_or(lanes_and(ab, ac), lanes_and(ab, ad)),
+                                  lanes_or(lanes_and(ac, ad), lanes_and(bc, bd)));
+
+            lanes_store2(top + 2 * x,
+                         lanes_select(lanes_and_not(ac, keep), A, P),
+                         lanes_select(lanes_and_not(ab, keep), B, P));
+            lanes_store2(bottom + 2 * x,
+                         lanes_select(lanes_and_not(cd, keep), C, P),
+                         lanes_select(lanes_and_not(bd, keep), D, P));
+        }
+    }
+}
+
+static void build_map(FilterPipeline* filter, const Chip8* cpu) {
+    uint8_t (*base)[MAP_STRIDE] = (filter->scaler == SCALER_NONE) ? filter->map : filter->temp;
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        uint8_t* row = map_row(base, y);
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            row[x] = cpu->screen[x][y] ? PIXEL_ON : PIXEL_OFF;
+        }
+    }
+
+    int w = SCREEN_WIDTH;
+    int h = SCREEN_HEIGHT;
+    int factor = 1;
+    switch (filter->scaler) {
+        case SCALER_SCALE2X:
+            scale2x(filter->map, filter->temp, w, h);
+            factor = 2;
+            break;
+        case SCALER_SCALE3X:
+            scale3x(filter->map, filter->temp, w, h);
+            factor = 3;
+            break;
+        case SCALER_SCALE4X:
+            // Scale2x twice
+            scale2x(filter->map, filter->temp, w, h);
+            memcpy(filter->temp, filter->map, sizeof(PixelMap));
+            scale2x(filter->map, filter->temp, w * 2, h * 2);
+            factor = 4;
+            break;
+        case SCALER_EPX:
+            epx(filter->map, filter->temp, w, h);
+            factor = 2;
+            break;
+        default:
+            break;
+    }
+    filter->map_width = w * factor;
+    filter->map_height = h * factor;
+}
+
+static uint32_t scale_color(uint32_t color, int r, int g, int b) {
+    uint32_t red = ((color >> 16) & 0xFF) * r >> 8;
+    uint32_t green = ((color >> 8) & 0xFF) * g >> 8;
+    uint32_t blue = (color & 0xFF) * b >> 8;
+    return (color & 0xFF000000) | (red > 255 ? 255 : red) << 16 | (green > 255 ? 255 : green) << 8 |
+           (blue > 255 ? 255 : blue);
+}
+
+// Rebuilds the column and row maps and the coloured lines when the output
+// size or mode changed
+static bool prepare(FilterPipeline* filter, int width, int height) {
+    if (filter->width == width && filter->height == height &&
+        filter->table_scaler == filter->scaler && filter->table_post == filter->post) {
+        return true;
+    }
+    free_tables(filter);
+
+    filter->column_start = malloc((filter->map_width + 1) * sizeof(int));
+    filter->row_map = malloc(height * sizeof(uint16_t));
+    filter->row_shade = malloc(height);
+    filter->lines = malloc((size_t)SHADE_COUNT * 2 * width * sizeof(uint32_t));
+    filter->scratch = malloc((size_t)FILTER_BANDS * width);
+    filter->band_lines = malloc((size_t)FILTER_BANDS * width * sizeof(uint32_t));
+    if (!filter->column_start || !filter->row_map || !filter->row_shade || !filter->lines || !filter->scratch ||
+        !filter->band_lines) {
+        free_tables(filter);
+        return false;
+    }
+    filter->width = width;
+    filter->height = height;
+    filter->table_scaler = filter->scaler;
+    filter->table_post = filter->post;
+
+    int map_w = filter->map_width;
+    int map_h = filter->map_height;
+    // Nearest neighbour: output column x shows map column x * map_w / width
+    for (int column = 0; column <= map_w; column++) {
+        filter->column_start[column] = (int)(((int64_t)column * width + map_w - 1) / map_w);
+    }
+
+    // Scanlines darken the last quarter of each map row, when there are
+    // enough output rows per map row to show one
+    bool scanlines = filter->post != POST_NONE && height >= 2 * map_h;
+    for (int y = 0; y < height; y++) {
+        int64_t position = (int64_t)y * map_h;
+        filter->row_map[y] = (uint16_t)(position / height);
+        int quarter = (int)((position % height) * 4 / height);
+        filter->row_shade[y] = (scanlines && quarter == 3) ? SHADE_GAP : SHADE_FULL;
+    }
+
+    // The CRT aperture grille tints each column towards red, green or blue
+    bool grille = filter->post == POST_CRT && width >= 3 * map_w;
+    int gap = (filter->post == POST_CRT) ? WEIGHT_CRT_GAP : WEIGHT_SCANLINE_GAP;
+    for (int shade = 0; shade < SHADE_COUNT; shade++) {
+        int weight = (shade == SHADE_GAP) ? gap : WEIGHT_FULL;
+        uint32_t* off = filter->lines + (size_t)(shade * 2) * width;
+        uint32_t* on = off + width;
+        for (int x = 0; x < width; x++) {
+            int r = weight, g = weight, b = weight;
+            if (grille) {
+                int dim = weight * WEIGHT_CRT_MASK >> 8;
+                r = (x % 3 == 0) ? weight : dim;
+                g = (x % 3 == 1) ? weight : dim;
+                b = (x % 3 == 2) ? weight : dim;
+            }
+            off[x] = scale_color(FILTER_COLOR_OFF, r, g, b);
+            on[x] = scale_color(FILTER_COLOR_ON, r, g, b);
+        }
+    }
+    return true;
+}
+
+// line[x] = mask[x] ? on[x] : off[x], into a cached buffer
+static void build_line(uint32_t* line, const uint8_t* mask, const uint32_t* off, const uint32_t* on, int width) {
+    int x = 0;
+#ifdef FILTER_SSE2
+    for (; x + 16 <= width; x += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(mask + x));
+        __m128i low = _mm_unpacklo_epi8(bytes, bytes);
+        __m128i high = _mm_unpackhi_epi8(bytes, bytes);
+        __m128i select[4] = {
+            _mm_unpacklo_epi16(low, low), _mm_unpackhi_epi16(low, low),
+            _mm_unpacklo_epi16(high, high), _mm_unpackhi_epi16(high, high)
+        };
+        for (int i = 0; i < 4; i++) {
+            __m128i lit = _mm_loadu_si128((const __m128i*)(on + x + i * 4));
+            __m128i dark = _mm_loadu_si128((const __m128i*)(off + x + i * 4));
+            _mm_storeu_si128((__m128i*)(line + x + i * 4),
+                             _mm_or_si128(_mm_and_si128(select[i], lit), _mm_andnot_si128(select[i], dark)));
+        }
+    }
+#endif
+    for (; x < width; x++) {
+        line[x] = mask[x] ? on[x] : off[x];
+    }
+}
+
+// Copies a finished line to the output without pulling the output into the
+// cache; texture memory is often write-combined and never read back
+static void copy_line(uint32_t* out, const uint32_t* line, int width) {
+#ifdef FILTER_SSE2
+    int x = 0;
+    while (x < width && ((uintptr_t)(out + x) & 15)) {
+        out[x] = line[x];
+        x++;
+    }
+    for (; x + 16 <= width; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(line + x));
+        __m128i b = _mm_loadu_si128((const __m128i*)(line + x + 4));
+        __m128i c = _mm_loadu_si128((const __m128i*)(line + x + 8));
+        __m128i d = _mm_loadu_si128((const __m128i*)(line + x + 12));
+        _mm_stream_si128((__m128i*)(out + x), a);
+        _mm_stream_si128((__m128i*)(out + x + 4), b);
+        _mm_stream_si128((__m128i*)(out + x + 8), c);
+        _mm_stream_si128((__m128i*)(out + x + 12), d);
+    }
+    for (; x < width; x++) {
+        out[x] = line[x];
+    }
+#else
+    memcpy(out, line, width * sizeof(uint32_t));
+#endif
+}
+
+static void render_band(void* data, int band) {
+    FilterPipeline* filter = data;
+    Uint64 span = spans_begin();
+    int width = filter->width;
+    int first = band * filter->height / FILTER_BANDS;
+    int last = (band + 1) * filter->height / FILTER_BANDS;
+    uint8_t* mask = filter->scratch + (size_t)band * width;
+    uint32_t* line = filter->band_lines + (size_t)band * width;
+    int expanded = -1;
+    int built = -1;
+
+    for (int y = first; y < last; y++) {
+        // Rows from the same map row share one expanded mask
+        int row = filter->row_map[y];
+        if (row != expanded) {
+            const uint8_t* source = map_row(filter->map, row);
+            for (int column = 0; column < filter->map_width; column++) {
+                int start = filter->column_start[column];
+                memset(mask + start, source[column], filter->column_start[column + 1] - start);
+            }
+            expanded = row;
+        }
+
+        // Most output rows repeat the one above
+        int shade = filter->row_shade[y];
+        if (row * SHADE_COUNT + shade != built) {
+            const uint32_t* off = filter->lines + (size_t)(shade * 2) * width;
+            build_line(line, mask, off, off + width, width);
+            built = row * SHADE_COUNT + shade;
+        }
+        copy_line((uint32_t*)(filter->pixels + (size_t)y * filter->pitch), line, width);
+    }
+#ifdef FILTER_SSE2
+    _mm_sfence();
+#endif
+    spans_end(span, "filter_band", band);
+}
+
+bool filter_render(FilterPipeline* filter, const Chip8* cpu, void* pixels, int pitch, int width, int height) {
+    build_map(filter, cpu);
+    if (!prepare(filter, width, height)) {
+        printf("Error: filter tables for %dx%d could not be allocated\n", width, height);
+        return false;
+    }
+
+    filter->pixels = pixels;
+    filter->pitch = pitch;
+    pool_run(filter->pool, FILTER_BANDS, render_band, filter);
+    return true;
+}
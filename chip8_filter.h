@@ -0,0 +1,58 @@
+#ifndef CHIP8_FILTER_H
+#define CHIP8_FILTER_H
+
+#include "chip8_cpu.h"
+
+// CPU upscaling pipeline for the window
+//
+// A pixel-art scaler (Scale2x/3x/4x or EPX) first enlarges the 64x32 screen
+// into a small 0/1 map. The output stage then stretches that map to the
+// full output size with nearest-neighbour sampling, applying scanlines or
+// a scanline plus aperture-grille CRT look. Everything that only depends
+// on the output size (column and row maps, the coloured on/off lines for
+// each scanline brightness) is rebuilt only when the size or mode changes.
+// Per frame, each distinct output line is built once in cache by selecting
+// between two coloured lines 16 pixels at a time with SSE2, then written to
+// every output row that repeats it with streaming stores, so the output is
+// never read back. Row bands run on the worker pool.
+
+typedef enum {
+    SCALER_NONE,
+    SCALER_SCALE2X,
+    SCALER_SCALE3X,
+    SCALER_SCALE4X,
+    SCALER_EPX,
+    SCALER_COUNT
+} FilterScaler;
+
+typedef enum {
+    POST_NONE,
+    POST_SCANLINES,
+    POST_CRT,
+    POST_COUNT
+} FilterPost;
+
+#define FILTER_MAX_FACTOR 4
+#define FILTER_BANDS 32
+
+#define FILTER_COLOR_ON  0xFFFFFFFF
+#define FILTER_COLOR_OFF 0xFF000000
+
+typedef struct FilterPipeline FilterPipeline;
+
+// `threads` extra worker threads, as for pool_create
+FilterPipeline* filter_create(int threads);
+void filter_destroy(FilterPipeline* filter);
+
+void filter_set_mode(FilterPipeline* filter, FilterScaler scaler, FilterPost post);
+FilterScaler filter_scaler(const FilterPipeline* filter);
+FilterPost filter_post(const FilterPipeline* filter);
+const char* filter_scaler_name(FilterScaler scaler);
+const char* filter_post_name(FilterPost post);
+
+// Renders the screen into a `width` x `height` ARGB8888 image whose rows are
+// `pitch` bytes apart, e.g. a locked streaming texture. Returns false if the
+// output tables could not be allocated.
+bool filter_render(FilterPipeline* filter, const Chip8* cpu, void* pixels, int pitch, int width, int height);
+
+#endif
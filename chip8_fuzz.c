@@ -0,0 +1,222 @@
+// In-process fuzzing harness for the interpreter core
+//
+// Works as a libFuzzer target and with AFL++ through its libFuzzer driver:
+//   make fuzz
+// Build with -DCHIP8_FUZZ_MAIN instead of -fsanitize=fuzzer for a standalone
+// binary that replays crash files or measures throughput.
+//
+// Input layout:
+//   byte 0     quirk profile, modulo the profile count
+//   bytes 1-2  ROM length, little-endian, clamped to the bytes available
+//   ROM image
+//   script     one byte per key event: high nibble = frames to wait before
+//              it, low nibble = key to toggle
+//
+// Each run starts from a pristine machine copied over the instance, which is
+// much cheaper than chip8_init plus a file load, and stops after a fixed
+// cycle budget. Guest PCs and opcode classes are exported as libFuzzer extra
+// counters so inputs that reach new guest code are kept.
+
+#include "chip8_cpu.h"
+#include "chip8_opcodes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// About 13 frames; override with CHIP8_FUZZ_CYCLES for deeper runs
+#define FUZZ_DEFAULT_CYCLES 128
+#define FUZZ_CLASS_COUNT 4096
+
+#if defined(__linux__) && !defined(CHIP8_FUZZ_MAIN)
+#define FUZZ_COUNTERS __attribute__((used, section("__libfuzzer_extra_counters")))
+#else
+#define FUZZ_COUNTERS
+#endif
+
+FUZZ_COUNTERS static uint8_t pc_coverage[MEMORY_SIZE];
+FUZZ_COUNTERS static uint8_t class_coverage[FUZZ_CLASS_COUNT];
+
+static Chip8 pristine;
+static Chip8 cpu;
+static uint64_t max_cycles = FUZZ_DEFAULT_CYCLES;
+static int initialized = 0;
+
+// Fuzz runs are silent
+void platform_beep(void) {
+}
+
+// Opcode class: the top nibble, plus the selector bits for the groups that
+// dispatch on them (0nnn, 8xyN, ExNN, FxNN). Looked up rather than switched
+// on, so it adds no branch beside the interpreter's own dispatch.
+static const uint8_t class_selector_mask[16] = {
+    [0x0] = 0xFF, [0x8] = 0x0F, [0xE] = 0xFF, [0xF] = 0xFF
+};
+
+static inline int opcode_class(uint16_t opcode) {
+    return (opcode >> 12) << 8 | (opcode & class_selector_mask[opcode >> 12]);
+}
+
+// Records coverage for each instruction inside the profile's inlined
+// interpreter
+static inline __attribute__((always_inline)) bool fuzz_execute(
+    bool (*execute)(Chip8*, uint16_t), Chip8* c, uint16_t pc, uint16_t opcode) {
+    pc_coverage[pc & ADDR_MASK]++;
+    class_coverage[opcode_class(opcode)]++;
+    return execute(c, opcode);
+}
+
+// Instrumented copy of every quirk profile's run loop
+#define PROFILE_VARIANT fuzz
+#define PROFILE_EXECUTE(execute, cpu, i, pc, opcode) fuzz_execute(execute, cpu, pc, opcode)
+#include "chip8_opcodes_profiles.h"
+
+static int (*const fuzz_profile_run[QUIRK_PROFILE_COUNT])(Chip8* cpu, int cycles) = {
+    [QUIRKS_CHIP8]  = run_chip8_fuzz,
+    [QUIRKS_SCHIP]  = run_schip_fuzz,
+    [QUIRKS_XOCHIP] = run_xochip_fuzz,
+};
+
+// Replaces profile->run. Idle cycles are skipped as on the normal path.
+static int fuzz_run(Chip8* c, int cycles) {
+    int ran = fuzz_profile_run[c->profile - quirk_profiles](c, cycles);
+    c->idle_cycles += cycles - ran;
+    return cycles;
+}
+
+static void fuzz_init(void) {
+    const char* budget = getenv("CHIP8_FUZZ_CYCLES");
+    if (budget && atoi(budget) > 0) {
+        max_cycles = (uint64_t)atoi(budget);
+    }
+
+    chip8_init(&pristine);
+    chip8_seed_rng(&pristine, 1);
+    pristine.muted = true;
+    pristine.run_hook = fuzz_run;
+    initialized = 1;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (!initialized) {
+        fuzz_init();
+    }
+    if (size < 3) {
+        return 0;
+    }
+
+    chip8_load_state(&cpu, &pristine);
+    cpu.run_hook = fuzz_run;
+    cpu.profile = &quirk_profiles[data[0] % QUIRK_PROFILE_COUNT];
+
+    size_t rom_size = data[1] | data[2] << 8;
+    if (rom_size > size - 3) {
+        rom_size = size - 3;
+    }
+    if (rom_size > MEMORY_SIZE - 0x200) {
+        rom_size = MEMORY_SIZE - 0x200;
+    }
+    chip8_load_rom_data(&cpu, data + 3, rom_size);
+
+    // Queue the input script; keys toggle so the script stays one byte per event
+    const uint8_t* script = data + 3 + rom_size;
+    size_t script_size = size - 3 - rom_size;
+    uint64_t cycle = 0;
+    uint16_t keys = 0;
+    for (size_t i = 0; i < script_size && i < CHIP8_INPUT_QUEUE_SIZE; i++) {
+        uint8_t key = script[i] & 0x0F;
+        cycle += (uint64_t)(script[i] >> 4) * cpu.sched.frame_period;
+        if (cycle >= max_cycles) {
+            break;
+        }
+        keys ^= 1 << key;
+        chip8_queue_key_at(&cpu, cycle, key, (keys >> key) & 1);
+    }
+
+    chip8_run_until(&cpu, max_cycles);
+    return 0;
+}
+
+#ifdef CHIP8_FUZZ_MAIN
+#include <time.h>
+
+#define BENCH_INPUT_SIZE 512
+
+static int run_file(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        printf("Could not open %s\n", filename);
+        return 1;
+    }
+
+    static uint8_t data[MEMORY_SIZE * 2];
+    size_t size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+
+    LLVMFuzzerTestOneInput(data, size);
+    printf("%s: ran %zu bytes, pc %03X\n", filename, size, cpu.pc & ADDR_MASK);
+    return 0;
+}
+
+static uint32_t bench_random(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Mutates a random input a few bytes at a time, the way a fuzzer would, for
+// `seconds` and reports executions per second
+static int run_bench(double seconds) {
+    static uint8_t data[BENCH_INPUT_SIZE];
+    uint32_t state = 0x12345678;
+    uint64_t execs = 0;
+
+    for (int i = 0; i < BENCH_INPUT_SIZE; i++) {
+        data[i] = (uint8_t)bench_random(&state);
+    }
+    data[1] = (BENCH_INPUT_SIZE - 64) & 0xFF;
+    data[2] = (BENCH_INPUT_SIZE - 64) >> 8;
+
+    clock_t start = clock();
+    clock_t limit = start + (clock_t)(seconds * CLOCKS_PER_SEC);
+    while (clock() < limit) {
+        for (int batch = 0; batch < 1000; batch++) {
+            for (int m = 0; m < 4; m++) {
+                uint32_t r = bench_random(&state);
+                data[3 + r % (BENCH_INPUT_SIZE - 3)] = (uint8_t)(r >> 24);
+            }
+            LLVMFuzzerTestOneInput(data, sizeof(data));
+            execs++;
+        }
+    }
+
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    int pcs = 0;
+    int classes = 0;
+    for (int i = 0; i < MEMORY_SIZE; i++) pcs += pc_coverage[i] != 0;
+    for (int i = 0; i < FUZZ_CLASS_COUNT; i++) classes += class_coverage[i] != 0;
+
+    printf("%llu execs in %.2f s: %.0f execs/s (%llu cycles each)\n",
+           (unsigned long long)execs, elapsed, execs / elapsed, (unsigned long long)max_cycles);
+    printf("Coverage: %d guest PCs, %d opcode classes\n", pcs, classes);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <input>... | --bench <seconds>\n", argv[0]);
+        return 1;
+    }
+
+    fuzz_init();
+    if (strcmp(argv[1], "--bench") == 0) {
+        return run_bench(argc >= 3 ? atof(argv[2]) : 5.0);
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        status |= run_file(argv[i]);
+    }
+    return status;
+}
+#endif
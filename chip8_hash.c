@@ -0,0 +1,183 @@
+#include "chip8_hash.h"
+#include "chip8_opcodes.h"
+#include <string.h>
+
+// Key domains, so equal indices in different parts of the state never share a key
+#define DOMAIN_MEMORY   (1ull << 32)
+#define DOMAIN_REGISTER (2ull << 32)
+#define DOMAIN_PIXEL    (3ull << 32)
+#define REG_I REGISTER_COUNT
+
+#define SPRITE_WIDTH 8
+#define MAX_SPRITE_PIXELS (SPRITE_WIDTH * 15)
+
+// splitmix64 finalizer
+static inline uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Zero bytes have no key, so untouched memory costs nothing to hash
+static inline uint64_t memory_key(uint16_t addr, uint8_t value) {
+    return value ? mix64(DOMAIN_MEMORY | (uint64_t)addr << 8 | value) : 0;
+}
+
+static inline uint64_t register_key(int reg, uint16_t value) {
+    return mix64(DOMAIN_REGISTER | (uint64_t)reg << 16 | value);
+}
+
+static inline uint64_t pixel_key(int x, int y) {
+    return mix64(DOMAIN_PIXEL | (uint64_t)(x * SCREEN_HEIGHT + y));
+}
+
+static uint64_t screen_hash(const Chip8* cpu) {
+    uint64_t hash = 0;
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            if (cpu->screen[x][y]) {
+                hash ^= pixel_key(x, y);
+            }
+        }
+    }
+    return hash;
+}
+
+// The part of the hash the run hook maintains
+static uint64_t data_hash(const Chip8* cpu) {
+    uint64_t hash = screen_hash(cpu);
+    for (int addr = 0; addr < MEMORY_SIZE; addr++) {
+        hash ^= memory_key(addr, cpu->memory[addr]);
+    }
+    for (int r = 0; r < REGISTER_COUNT; r++) {
+        hash ^= register_key(r, cpu->V[r]);
+    }
+    return hash ^ register_key(REG_I, cpu->I);
+}
+
+// A few words that change nearly every instruction; cheaper to fold in on read
+static uint64_t control_hash(const Chip8* cpu) {
+    uint64_t hash = mix64((uint64_t)cpu->pc << 48 | (uint64_t)cpu->sp << 40 |
+                          (uint64_t)cpu->delay_timer << 32 | (uint64_t)cpu->sound_timer << 24 |
+                          chip8_keypad_mask(cpu));
+    hash = mix64(hash ^ cpu->rng_state);
+    for (int i = 0; i < STACK_SIZE && i < cpu->sp; i++) {
+        hash = mix64(hash ^ cpu->stack[i]);
+    }
+    return hash;
+}
+
+// Hashing replacement for profile->run
+static int hash_run(Chip8* cpu, int cycles) {
+    uint64_t hash = cpu->state_hash;
+
+    for (int i = 0; i < cycles; i++) {
+        uint16_t pc = cpu->pc & ADDR_MASK;
+        uint16_t opcode = cpu->memory[pc] << 8 | cpu->memory[(pc + 1) & ADDR_MASK];
+
+        uint64_t V_before[2];
+        memcpy(V_before, cpu->V, REGISTER_COUNT);
+        uint16_t I_before = cpu->I;
+
+        // Memory writes and pixel flips are located before the step
+        Chip8MemAccess access = {0};
+        uint8_t old_bytes[REGISTER_COUNT];
+        uint8_t pixel_x[MAX_SPRITE_PIXELS];
+        uint8_t pixel_y[MAX_SPRITE_PIXELS];
+        uint8_t pixel_old[MAX_SPRITE_PIXELS];
+        int pixel_count = 0;
+
+        switch (opcode & 0xF000) {
+            case 0x0000:
+                if (opcode == 0x00E0) {
+                    hash ^= screen_hash(cpu);
+                }
+                break;
+            case 0xD000: {
+                // Only set sprite bits can flip a pixel; positions are taken
+                // with wrap-around, and a clipped one simply never changes
+                int x0 = cpu->V[(opcode >> 8) & 0xF] % SCREEN_WIDTH;
+                int y0 = cpu->V[(opcode >> 4) & 0xF] % SCREEN_HEIGHT;
+                for (int row = 0; row < (opcode & 0xF); row++) {
+                    uint8_t sprite = cpu->memory[(cpu->I + row) & ADDR_MASK];
+                    for (int col = 0; sprite && col < SPRITE_WIDTH; col++) {
+                        if (sprite & (0x80 >> col)) {
+                            int x = (x0 + col) % SCREEN_WIDTH;
+                            int y = (y0 + row) % SCREEN_HEIGHT;
+                            pixel_x[pixel_count] = (uint8_t)x;
+                            pixel_y[pixel_count] = (uint8_t)y;
+                            pixel_old[pixel_count++] = cpu->screen[x][y];
+                        }
+                    }
+                }
+                break;
+            }
+            case 0xF000:
+                chip8_decode_mem_access(cpu, opcode, &access);
+                for (int m = 0; m < access.write_len; m++) {
+                    old_bytes[m] = cpu->memory[(access.write_addr + m) & ADDR_MASK];
+                }
+                break;
+        }
+
+        cpu->pc += 2;
+        cpu->profile->step(cpu, opcode);
+
+        // Most opcodes change one register at most; compare eight at a time
+        uint64_t V_after[2];
+        memcpy(V_after, cpu->V, REGISTER_COUNT);
+        if ((V_before[0] ^ V_after[0]) | (V_before[1] ^ V_after[1])) {
+            const uint8_t* before = (const uint8_t*)V_before;
+            for (int r = 0; r < REGISTER_COUNT; r++) {
+                if (before[r] != cpu->V[r]) {
+                    hash ^= register_key(r, before[r]) ^ register_key(r, cpu->V[r]);
+                }
+            }
+        }
+        if (cpu->I != I_before) {
+            hash ^= register_key(REG_I, I_before) ^ register_key(REG_I, cpu->I);
+        }
+
+        for (int m = 0; m < access.write_len; m++) {
+            uint16_t addr = (access.write_addr + m) & ADDR_MASK;
+            hash ^= memory_key(addr, old_bytes[m]) ^ memory_key(addr, cpu->memory[addr]);
+        }
+        for (int p = 0; p < pixel_count; p++) {
+            if (cpu->screen[pixel_x[p]][pixel_y[p]] != pixel_old[p]) {
+                hash ^= pixel_key(pixel_x[p], pixel_y[p]);
+            }
+        }
+    }
+
+    cpu->state_hash = hash;
+    return cycles;
+}
+
+bool chip8_hash_attach(Chip8* cpu) {
+    if (cpu->run_hook && cpu->run_hook != hash_run) {
+        return false;
+    }
+    cpu->run_hook = hash_run;
+    cpu->hook_data = NULL;
+    chip8_hash_refresh(cpu);
+    return true;
+}
+
+void chip8_hash_detach(Chip8* cpu) {
+    if (cpu->run_hook == hash_run) {
+        cpu->run_hook = NULL;
+    }
+}
+
+void chip8_hash_refresh(Chip8* cpu) {
+    cpu->state_hash = data_hash(cpu);
+}
+
+uint64_t chip8_hash(const Chip8* cpu) {
+    return cpu->state_hash ^ control_hash(cpu);
+}
+
+uint64_t chip8_hash_full(const Chip8* cpu) {
+    return data_hash(cpu) ^ control_hash(cpu);
+}
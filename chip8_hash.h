@@ -0,0 +1,30 @@
+#ifndef CHIP8_HASH_H
+#define CHIP8_HASH_H
+
+#include "chip8_cpu.h"
+
+// Incremental machine-state hashing
+//
+// Zobrist-style: every memory byte, lit pixel and register value has its own
+// 64-bit key, and the state hash is the XOR of the keys present. Keys are
+// derived with a 64-bit mixer rather than stored, so there are no tables.
+// The attached run hook updates cpu->state_hash as V/I change, as Fx33/Fx55
+// write memory and as Dxyn/00E0 change pixels. The small control state (pc,
+// stack, timers, RNG, keys) is folded in when the hash is read.
+//
+// The hash travels with the Chip8 struct, so snapshots and copies of a
+// hashed instance stay valid. Call chip8_hash_refresh after the host writes
+// memory or the screen directly (chip8_load_rom and friends).
+
+// Installs the hashing run hook and computes the initial hash. Fails if
+// another tool is already attached.
+bool chip8_hash_attach(Chip8* cpu);
+void chip8_hash_detach(Chip8* cpu);
+void chip8_hash_refresh(Chip8* cpu);
+
+// Current hash of the whole machine state
+uint64_t chip8_hash(const Chip8* cpu);
+// Same value computed from scratch, for checking and for unhooked instances
+uint64_t chip8_hash_full(const Chip8* cpu);
+
+#endif
@@ -0,0 +1,205 @@
+#define SDL_MAIN_HANDLED
+#include "chip8_capture.h"
+#include "chip8_cpu.h"
+#include "chip8_debugger.h"
+#include "chip8_log.h"
+#include "chip8_movie.h"
+#include "chip8_profiler.h"
+#include "chip8_shm.h"
+#include "chip8_trace.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_FRAMES 3600
+#define PROFILE_SUMMARY_ROUTINES 15
+
+// Headless runs are silent
+void platform_beep(void) {
+}
+
+static uint32_t screen_checksum(const Chip8* cpu) {
+    uint32_t hash = 2166136261u;
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            hash = (hash ^ cpu->screen[x][y]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// Runs one frame and hands its result to whichever outputs are enabled
+static void run_frame(Chip8* cpu, Chip8Capture* capture, Chip8Shm* shm, MovieRecorder* movie) {
+    uint64_t frame = cpu->sched.frame_count;
+    if (shm) {
+        chip8_shm_apply_input(shm, cpu);
+    }
+    if (movie) {
+        movie_record_input(movie, cpu);
+    }
+    chip8_run_frame(cpu);
+    if (movie) {
+        movie_record_frame(movie, cpu);
+    }
+
+    // A breakpoint can stop the frame part way
+    if (cpu->sched.frame_count == frame) {
+        return;
+    }
+    if (capture) {
+        capture_frame(capture, cpu);
+    }
+    if (shm) {
+        chip8_shm_publish(shm, cpu, false);
+    }
+}
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [--trace file | --profile prefix | --debug port] [--record file] [--shm name] [--movie file] <rom> [frames]\n", program);
+    printf("  --profile writes <prefix>.folded (collapsed stacks) and <prefix>.heat\n");
+    printf("  --movie records the input (e.g. from --shm) for chip8_movietool\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* rom = NULL;
+    const char* trace_file = NULL;
+    const char* profile_prefix = NULL;
+    int debug_port = 0;
+    const char* record_file = NULL;
+    const char* shm_name = NULL;
+    const char* movie_file = NULL;
+    long frames = DEFAULT_FRAMES;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_prefix = argv[++i];
+        } else if (strcmp(argv[i], "--debug") == 0 && i + 1 < argc) {
+            debug_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_file = argv[++i];
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            shm_name = argv[++i];
+        } else if (strcmp(argv[i], "--movie") == 0 && i + 1 < argc) {
+            movie_file = argv[++i];
+        } else if (!rom) {
+            rom = argv[i];
+        } else {
+            frames = strtol(argv[i], NULL, 10);
+        }
+    }
+
+    if (!rom || frames <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // A bad ROM's unknown opcodes are logged without slowing the run
+    log_start();
+    atexit(log_stop);
+
+    static Chip8 cpu;
+    chip8_init(&cpu);
+    if (!chip8_load_rom(&cpu, rom)) {
+        return 1;
+    }
+
+    // Tools start in order. If one fails, the ones already running go
+    // through the same teardown as a normal exit, so a trace is flushed and
+    // nothing is left running.
+    bool ready = true;
+
+    Chip8Trace* trace = NULL;
+    if (trace_file) {
+        trace = chip8_trace_start(&cpu, trace_file);
+        ready = trace != NULL;
+    }
+
+    Chip8Profiler* profiler = NULL;
+    if (ready && profile_prefix) {
+        profiler = chip8_profiler_start(&cpu);
+        ready = profiler != NULL;
+    }
+
+    Chip8Debugger* debugger = NULL;
+    if (ready && debug_port) {
+        debugger = chip8_debugger_create(&cpu, (uint16_t)debug_port);
+        ready = debugger != NULL;
+    }
+
+    Chip8Capture* capture = NULL;
+    if (ready && record_file) {
+        // Headless runs are not real-time, so the capture keeps every frame
+        capture = capture_start(record_file, false);
+        ready = capture != NULL;
+    }
+
+    Chip8Shm* shm = NULL;
+    if (ready && shm_name) {
+        shm = chip8_shm_create(shm_name);
+        ready = shm != NULL;
+    }
+
+    MovieRecorder* movie = NULL;
+    if (ready && movie_file) {
+        movie = movie_record_start(movie_file, &cpu);
+        ready = movie != NULL;
+    }
+
+    if (ready) {
+        // Run as fast as possible through the same scheduler API as the window
+        Uint64 start = SDL_GetPerformanceCounter();
+        if (debugger) {
+            // Frames can end early at a breakpoint, so count completed frames
+            while (cpu.sched.frame_count < (uint64_t)frames) {
+                chip8_debugger_poll(debugger);
+                if (chip8_debugger_paused(debugger)) {
+                    SDL_Delay(1);
+                    continue;
+                }
+                run_frame(&cpu, capture, shm, movie);
+            }
+        } else {
+            for (long i = 0; i < frames; i++) {
+                run_frame(&cpu, capture, shm, movie);
+            }
+        }
+        Uint64 end = SDL_GetPerformanceCounter();
+
+        double seconds = (double)(end - start) / SDL_GetPerformanceFrequency();
+        printf("Ran %ld frames (%llu cycles) in %.3f s", frames,
+               (unsigned long long)cpu.cycles, seconds);
+        if (seconds > 0) {
+            printf(", %.2f MIPS", cpu.cycles / seconds / 1e6);
+        }
+        printf("\nScreen checksum: %08X\n", screen_checksum(&cpu));
+
+        if (shm) {
+            chip8_shm_publish(shm, &cpu, true);
+        }
+    }
+
+    chip8_shm_close(shm);
+    movie_record_stop(movie, &cpu);
+    chip8_trace_stop(trace);
+
+    if (profiler && ready) {
+        char path[1024];
+        printf("\n");
+        chip8_profiler_print_summary(profiler, PROFILE_SUMMARY_ROUTINES);
+        snprintf(path, sizeof(path), "%s.folded", profile_prefix);
+        chip8_profiler_write_folded(profiler, path);
+        snprintf(path, sizeof(path), "%s.heat", profile_prefix);
+        chip8_profiler_write_heatmap(profiler, path);
+    }
+    chip8_profiler_stop(profiler);
+
+    chip8_debugger_destroy(debugger);
+
+    // A headless capture waits for the encoder, so any drop is a bug
+    bool dropped = capture_stop(capture) != 0;
+
+    return ready && !dropped ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+#include "chip8_hud.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GLYPH_WIDTH 3
+#define GLYPH_HEIGHT 5
+#define GLYPH_ADVANCE (GLYPH_WIDTH + 1)
+#define HUD_LINE_CHARS 16
+#define HUD_LINE_COUNT 6
+#define HUD_SCALE 2
+#define SPEED_SCALE 4
+#define HUD_MARGIN 8
+
+// Lines: speed (always shown) followed by the performance figures
+enum {
+    LINE_SPEED,
+    LINE_FPS,
+    LINE_MIPS,
+    LINE_FRAME_P99,
+    LINE_PRESENT,
+    LINE_SKIPPED
+};
+
+// 3x5 bitmap font, one row per byte, most significant of the 3 bits on the left
+static const char glyph_chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.%:/- ";
+static const uint8_t glyph_rows[][GLYPH_HEIGHT] = {
+    {7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 7, 1, 7}, {5, 5, 7, 1, 1},
+    {7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 1, 1, 1}, {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7},
+    {2, 5, 7, 5, 5}, {6, 5, 6, 5, 6}, {3, 4, 4, 4, 3}, {6, 5, 5, 5, 6}, {7, 4, 6, 4, 7},
+    {7, 4, 6, 4, 4}, {3, 4, 5, 5, 3}, {5, 5, 7, 5, 5}, {7, 2, 2, 2, 7}, {1, 1, 1, 5, 2},
+    {5, 5, 6, 5, 5}, {4, 4, 4, 4, 7}, {5, 7, 7, 5, 5}, {6, 5, 5, 5, 5}, {2, 5, 5, 5, 2},
+    {6, 5, 6, 4, 4}, {2, 5, 5, 6, 3}, {6, 5, 6, 5, 5}, {3, 4, 2, 1, 6}, {7, 2, 2, 2, 2},
+    {5, 5, 5, 5, 7}, {5, 5, 5, 5, 2}, {5, 5, 7, 7, 5}, {5, 5, 2, 5, 5}, {5, 5, 2, 2, 2},
+    {7, 1, 2, 4, 7}, {0, 0, 0, 0, 2}, {5, 1, 2, 4, 5}, {0, 2, 0, 2, 0}, {1, 1, 2, 4, 4},
+    {0, 0, 7, 0, 0}, {0, 0, 0, 0, 0}
+};
+
+#define GLYPH_COUNT ((int)sizeof(glyph_rows) / GLYPH_HEIGHT)
+
+typedef struct {
+    SDL_Texture* texture;
+    char text[HUD_LINE_CHARS + 1];
+    int width;
+    int scale;
+    bool dirty;
+} HudLine;
+
+static SDL_Texture* atlas = NULL;
+static HudLine lines[HUD_LINE_COUNT];
+static bool visible = false;
+static bool redraw_pending = false;
+
+// Measurements accumulated between updates
+static double frame_history[HUD_FRAME_HISTORY];
+static int frame_history_count = 0;
+static int frame_history_pos = 0;
+static int frames_since_update = 0;
+static double present_total_ms = 0;
+static int presents_since_update = 0;
+static uint64_t cycles_at_update = 0;
+static uint64_t idle_at_update = 0;
+static Uint32 last_update_ticks = 0;
+
+static int glyph_index(char c) {
+    const char* found = strchr(glyph_chars, c);
+    return (found && c != '\0') ? (int)(found - glyph_chars) : GLYPH_COUNT - 1;
+}
+
+// Renders the font once into a white-on-transparent atlas texture
+static SDL_Texture* create_atlas(SDL_Renderer* renderer) {
+    int width = GLYPH_COUNT * GLYPH_WIDTH;
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, GLYPH_HEIGHT, 32,
+                                                          SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+        return NULL;
+    }
+
+    for (int g = 0; g < GLYPH_COUNT; g++) {
+        for (int row = 0; row < GLYPH_HEIGHT; row++) {
+            uint32_t* pixels = (uint32_t*)((uint8_t*)surface->pixels + row * surface->pitch);
+            for (int col = 0; col < GLYPH_WIDTH; col++) {
+                bool on = glyph_rows[g][row] & (4 >> col);
+                pixels[g * GLYPH_WIDTH + col] = on ? 0xFFFFFFFF : 0x00000000;
+            }
+        }
+    }
+
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_FreeSurface(surface);
+    if (texture) {
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    }
+    return texture;
+}
+
+void hud_init(SDL_Renderer* renderer) {
+    atlas = create_atlas(renderer);
+    if (!atlas) {
+        printf("HUD atlas creation failed: %s\n", SDL_GetError());
+        return;
+    }
+
+    for (int i = 0; i < HUD_LINE_COUNT; i++) {
+        HudLine* line = &lines[i];
+        line->scale = (i == LINE_SPEED) ? SPEED_SCALE : HUD_SCALE;
+        line->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                          SDL_TEXTUREACCESS_TARGET,
+                                          HUD_LINE_CHARS * GLYPH_ADVANCE * line->scale,
+                                          GLYPH_HEIGHT * line->scale);
+        if (line->texture) {
+            SDL_SetTextureBlendMode(line->texture, SDL_BLENDMODE_BLEND);
+        }
+        line->text[0] = '\0';
+        line->dirty = false;
+    }
+
+    last_update_ticks = SDL_GetTicks();
+}
+
+void hud_cleanup(void) {
+    for (int i = 0; i < HUD_LINE_COUNT; i++) {
+        if (lines[i].texture) {
+            SDL_DestroyTexture(lines[i].texture);
+            lines[i].texture = NULL;
+        }
+    }
+    if (atlas) {
+        SDL_DestroyTexture(atlas);
+        atlas = NULL;
+    }
+}
+
+void hud_toggle(void) {
+    visible = !visible;
+    redraw_pending = true;
+}
+
+bool hud_is_visible(void) {
+    return visible;
+}
+
+bool hud_needs_redraw(void) {
+    return redraw_pending;
+}
+
+static void set_line(int index, const char* text) {
+    HudLine* line = &lines[index];
+    if (strncmp(line->text, text, HUD_LINE_CHARS) == 0) {
+        return;
+    }
+
+    strncpy(line->text, text, HUD_LINE_CHARS);
+    line->text[HUD_LINE_CHARS] = '\0';
+    line->dirty = true;
+    if (visible || index == LINE_SPEED) {
+        redraw_pending = true;
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+static double frame_time_p99(void) {
+    double sorted[HUD_FRAME_HISTORY];
+    if (frame_history_count == 0) {
+        return 0;
+    }
+
+    memcpy(sorted, frame_history, frame_history_count * sizeof(double));
+    qsort(sorted, frame_history_count, sizeof(double), compare_doubles);
+    return sorted[(frame_history_count * 99) / 100];
+}
+
+void hud_record_frame(double frame_ms, uint64_t cycles, uint64_t idle_cycles) {
+    frame_history[frame_history_pos] = frame_ms;
+    frame_history_pos = (frame_history_pos + 1) % HUD_FRAME_HISTORY;
+    if (frame_history_count < HUD_FRAME_HISTORY) {
+        frame_history_count++;
+    }
+    frames_since_update++;
+
+    Uint32 now = SDL_GetTicks();
+    Uint32 elapsed = now - last_update_ticks;
+    if (elapsed < HUD_UPDATE_INTERVAL_MS) {
+        return;
+    }
+
+    // Cycles restart from zero when a new instance is loaded
+    if (cycles < cycles_at_update || idle_cycles < idle_at_update) {
+        cycles_at_update = cycles;
+        idle_at_update = idle_cycles;
+    }
+
+    double seconds = elapsed / 1000.0;
+    double mips = (cycles - cycles_at_update) / seconds / 1e6;
+    double present_ms = presents_since_update ? present_total_ms / presents_since_update : 0;
+    char text[32];
+
+    snprintf(text, sizeof(text), "FPS %.1f", frames_since_update / seconds);
+    set_line(LINE_FPS, text);
+    snprintf(text, sizeof(text), "MIPS %.4f", mips);
+    set_line(LINE_MIPS, text);
+    snprintf(text, sizeof(text), "P99 %.2fMS", frame_time_p99());
+    set_line(LINE_FRAME_P99, text);
+    snprintf(text, sizeof(text), "PRES %.2fMS", present_ms);
+    set_line(LINE_PRESENT, text);
+    snprintf(text, sizeof(text), "SKIP %llu", (unsigned long long)(idle_cycles - idle_at_update));
+    set_line(LINE_SKIPPED, text);
+
+    cycles_at_update = cycles;
+    idle_at_update = idle_cycles;
+    frames_since_update = 0;
+    present_total_ms = 0;
+    presents_since_update = 0;
+    last_update_ticks = now;
+}
+
+void hud_record_present(double present_ms) {
+    present_total_ms += present_ms;
+    presents_since_update++;
+}
+
+void hud_set_speed(int speed_percent) {
+    char text[16];
+    snprintf(text, sizeof(text), "%d%%", speed_percent);
+    set_line(LINE_SPEED, text);
+}
+
+// Re-renders a line's texture from the atlas. Only called when its text changed.
+static void render_line(SDL_Renderer* renderer, HudLine* line) {
+    int scale = line->scale;
+    int length = (int)strlen(line->text);
+
+    SDL_SetRenderTarget(renderer, line->texture);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+
+    for (int i = 0; i < length; i++) {
+        SDL_Rect src = {glyph_index(line->text[i]) * GLYPH_WIDTH, 0, GLYPH_WIDTH, GLYPH_HEIGHT};
+        SDL_Rect dst = {i * GLYPH_ADVANCE * scale, 0, GLYPH_WIDTH * scale, GLYPH_HEIGHT * scale};
+        SDL_RenderCopy(renderer, atlas, &src, &dst);
+    }
+
+    SDL_SetRenderTarget(renderer, NULL);
+    line->width = length * GLYPH_ADVANCE * scale;
+    line->dirty = false;
+}
+
+static void draw_line(SDL_Renderer* renderer, HudLine* line, int x, int y) {
+    if (!line->texture) {
+        return;
+    }
+    if (line->dirty) {
+        render_line(renderer, line);
+    }
+
+    SDL_Rect src = {0, 0, line->width, GLYPH_HEIGHT * line->scale};
+    SDL_Rect dst = {x, y, line->width, GLYPH_HEIGHT * line->scale};
+    SDL_RenderCopy(renderer, line->texture, &src, &dst);
+}
+
+void hud_draw(SDL_Renderer* renderer, int window_width) {
+    if (!atlas) {
+        return;
+    }
+
+    // Speed percentage in the top-right corner, as before
+    draw_line(renderer, &lines[LINE_SPEED], window_width - 120, 20);
+
+    if (visible) {
+        int line_height = (GLYPH_HEIGHT + 2) * HUD_SCALE;
+        int height = (HUD_LINE_COUNT - 1) * line_height + HUD_MARGIN;
+        SDL_Rect panel = {0, 0, HUD_LINE_CHARS * GLYPH_ADVANCE * HUD_SCALE + HUD_MARGIN, height};
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+        SDL_RenderFillRect(renderer, &panel);
+
+        for (int i = LINE_FPS; i < HUD_LINE_COUNT; i++) {
+            draw_line(renderer, &lines[i], HUD_MARGIN / 2, HUD_MARGIN / 2 + (i - LINE_FPS) * line_height);
+        }
+    }
+
+    redraw_pending = false;
+}
@@ -0,0 +1,30 @@
+#ifndef CHIP8_HUD_H
+#define CHIP8_HUD_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Performance overlay. Text is drawn from a glyph atlas texture into one
+// cached texture per line, and a line is only re-rendered when its text
+// changes. Figures are refreshed twice a second.
+
+#define HUD_UPDATE_INTERVAL_MS 500
+#define HUD_FRAME_HISTORY 128
+
+void hud_init(SDL_Renderer* renderer);
+void hud_cleanup(void);
+
+void hud_toggle(void);
+bool hud_is_visible(void);
+// True when a visible line changed since the last hud_draw
+bool hud_needs_redraw(void);
+
+// Per-frame measurements from the main loop and the renderer
+void hud_record_frame(double frame_ms, uint64_t cycles, uint64_t idle_cycles);
+void hud_record_present(double present_ms);
+void hud_set_speed(int speed_percent);
+
+void hud_draw(SDL_Renderer* renderer, int window_width);
+
+#endif
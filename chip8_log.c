@@ -0,0 +1,482 @@
+#include "chip8_log.h"
+#include <SDL2/SDL.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_MAX_THREADS 64
+#define LOG_BURST_MS 1000
+#define LOG_STREAMS_INITIAL 8
+#define LOG_MAX_ARGS 8
+
+typedef struct {
+    int level;
+    int stream;
+    unsigned repeats;
+    char text[LOG_TEXT_SIZE];
+} LogMessage;
+
+// What identifies a message before it is formatted: the call's format
+// string and its raw arguments, strings by a hash of their contents.
+// Formats read_key does not understand are keyed by their text instead,
+// with a NULL format.
+typedef struct {
+    const char* format;
+    int count;
+    uint64_t args[LOG_MAX_ARGS];
+} LogKey;
+
+// A distinct message a stream logged recently, and how often it came again
+// since that was last reported
+typedef struct {
+    bool used;
+    LogKey key;
+    int level;
+    unsigned repeats;
+    Uint32 reported;
+    char text[LOG_TEXT_SIZE];
+} LogRecent;
+
+// Repeat folding and the burst limit for one stream, so a noisy instance
+// neither evicts another's recent messages nor spends its budget
+typedef struct {
+    bool used;
+    int stream;
+    LogRecent recent[LOG_RECENT];
+    int next_recent;
+    Uint32 burst_start;
+    int burst_used;
+    unsigned suppressed;
+} LogStream;
+
+// `head` and everything below `messages` belong to the logging thread;
+// `tail` and `dropped` are shared with the drain thread
+typedef struct {
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+    SDL_atomic_t dropped;
+    LogMessage messages[LOG_RING_SIZE];
+
+    // Open-addressed by stream, grown to stay at most half full
+    LogStream* streams;
+    int stream_capacity;
+    int stream_count;
+} LogRing;
+
+static SDL_atomic_t min_level = {LOG_INFO};
+
+static void* rings[LOG_MAX_THREADS];
+static SDL_atomic_t ring_count;
+
+static _Thread_local LogRing* thread_ring;
+// Set once the ring table is full; such threads log synchronously
+static _Thread_local bool thread_unregistered;
+
+// Drain thread, woken once per batch: producers post only when they flip
+// `wake_pending` from 0
+static SDL_Thread* drain_thread;
+static SDL_sem* wake;
+static SDL_atomic_t wake_pending;
+static SDL_atomic_t async;
+
+static void write_line(int level, int stream, const char* text, unsigned repeats) {
+    static const char* const prefixes[] = {"Debug: ", "", "Warning: ", "Error: "};
+    char line[LOG_TEXT_SIZE + 64];
+    int length = 0;
+
+    if (stream > 0) {
+        length = snprintf(line, sizeof(line), "[%d] ", stream);
+    }
+    length += snprintf(line + length, sizeof(line) - length, "%s%s", prefixes[level], text);
+    // A single repeat reads as the message itself
+    if (repeats > 1 && length < (int)sizeof(line)) {
+        snprintf(line + length, sizeof(line) - length, " (repeated %u times)", repeats);
+    }
+    // One call per line so synchronous writers from several threads do not
+    // interleave
+    puts(line);
+}
+
+static LogRing* register_thread(void) {
+    if (thread_unregistered) {
+        return NULL;
+    }
+
+    int slot = SDL_AtomicAdd(&ring_count, 1);
+    LogRing* ring = slot < LOG_MAX_THREADS ? calloc(1, sizeof(LogRing)) : NULL;
+    LogStream* streams = ring ? calloc(LOG_STREAMS_INITIAL, sizeof(LogStream)) : NULL;
+    if (!streams) {
+        free(ring);
+        thread_unregistered = true;
+        return NULL;
+    }
+    ring->streams = streams;
+    ring->stream_capacity = LOG_STREAMS_INITIAL;
+    SDL_AtomicSetPtr(&rings[slot], ring);
+    thread_ring = ring;
+    return ring;
+}
+
+static void push(LogRing* ring, int level, int stream, const char* text, unsigned repeats) {
+    if (!SDL_AtomicGet(&async) || level == LOG_ERROR) {
+        write_line(level, stream, text, repeats);
+        return;
+    }
+
+    unsigned head = (unsigned)SDL_AtomicGet(&ring->head);
+    if (head - (unsigned)SDL_AtomicGet(&ring->tail) == LOG_RING_SIZE) {
+        SDL_AtomicAdd(&ring->dropped, 1);
+        return;
+    }
+
+    LogMessage* message = &ring->messages[head % LOG_RING_SIZE];
+    message->level = level;
+    message->stream = stream;
+    message->repeats = repeats;
+    strcpy(message->text, text);
+    SDL_AtomicSet(&ring->head, (int)(head + 1));
+
+    if (SDL_AtomicCAS(&wake_pending, 0, 1)) {
+        SDL_SemPost(wake);
+    }
+}
+
+static void report_repeats(LogRing* ring, LogStream* state, LogRecent* recent, Uint32 now) {
+    push(ring, recent->level, state->stream, recent->text, recent->repeats);
+    recent->repeats = 0;
+    recent->reported = now;
+}
+
+static void report_suppressed(LogRing* ring, LogStream* state) {
+    char text[LOG_TEXT_SIZE];
+    snprintf(text, sizeof(text), "%u more messages suppressed", state->suppressed);
+    push(ring, LOG_WARN, state->stream, text, 0);
+    state->suppressed = 0;
+}
+
+static LogStream* probe_stream(LogStream* streams, int capacity, int stream) {
+    unsigned index = ((unsigned)stream * 2654435761u) & (capacity - 1);
+    while (streams[index].used && streams[index].stream != stream) {
+        index = (index + 1) & (capacity - 1);
+    }
+    return &streams[index];
+}
+
+// The thread's state for `stream`, created on its first message; NULL if
+// the table cannot grow
+static LogStream* find_stream(LogRing* ring, int stream, Uint32 now) {
+    LogStream* state = probe_stream(ring->streams, ring->stream_capacity, stream);
+    if (state->used) {
+        return state;
+    }
+
+    if (2 * (ring->stream_count + 1) > ring->stream_capacity) {
+        int capacity = 2 * ring->stream_capacity;
+        LogStream* streams = calloc(capacity, sizeof(LogStream));
+        if (!streams) {
+            return NULL;
+        }
+        for (int i = 0; i < ring->stream_capacity; i++) {
+            if (ring->streams[i].used) {
+                *probe_stream(streams, capacity, ring->streams[i].stream) = ring->streams[i];
+            }
+        }
+        free(ring->streams);
+        ring->streams = streams;
+        ring->stream_capacity = capacity;
+        state = probe_stream(streams, capacity, stream);
+    }
+
+    state->used = true;
+    state->stream = stream;
+    state->burst_start = now;
+    ring->stream_count++;
+    return state;
+}
+
+// FNV-1a
+static uint64_t hash_text(const char* text) {
+    uint64_t hash = 14695981039346656037u;
+    for (const char* c = text; *c; c++) {
+        hash = (hash ^ (uint8_t)*c) * 1099511628211u;
+    }
+    return hash;
+}
+
+// Reads the arguments `format` consumes into `key`. Returns false for
+// conversions it does not handle (wide strings, long double, %n) or more
+// than LOG_MAX_ARGS arguments.
+static bool read_key(LogKey* key, const char* format, va_list args) {
+    key->format = format;
+    key->count = 0;
+    for (const char* c = format; *c; c++) {
+        if (*c != '%' || *++c == '%') {
+            continue;
+        }
+
+        while (*c && strchr("-+ #0", *c)) {
+            c++;
+        }
+        // Width, then precision; either may be taken from an argument
+        for (int part = 0; part < 2; part++) {
+            if (part == 1) {
+                if (*c != '.') {
+                    break;
+                }
+                c++;
+            }
+            if (*c == '*') {
+                if (key->count == LOG_MAX_ARGS) {
+                    return false;
+                }
+                key->args[key->count++] = (uint64_t)va_arg(args, int);
+                c++;
+            }
+            while (*c >= '0' && *c <= '9') {
+                c++;
+            }
+        }
+
+        // Unsigned reads are fine for signed arguments of the same size
+        char length = 0;
+        while (*c == 'h') {
+            c++;
+        }
+        while (*c == 'l' || *c == 'z' || *c == 'j' || *c == 't' || *c == 'L') {
+            length = length == 'l' && *c == 'l' ? 'q' : *c;
+            c++;
+        }
+
+        uint64_t value;
+        switch (*c) {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+                switch (length) {
+                    case 0: value = va_arg(args, unsigned); break;
+                    case 'l': value = va_arg(args, unsigned long); break;
+                    case 'q': value = va_arg(args, unsigned long long); break;
+                    case 'j': value = va_arg(args, uintmax_t); break;
+                    case 'z': case 't': value = va_arg(args, size_t); break;
+                    default: return false;
+                }
+                break;
+
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+                if (length == 'L') {
+                    return false;
+                }
+                double number = va_arg(args, double);
+                memcpy(&value, &number, sizeof(value));
+                break;
+            }
+
+            case 's': {
+                if (length) {
+                    return false;
+                }
+                const char* text = va_arg(args, const char*);
+                value = text ? hash_text(text) : 0;
+                break;
+            }
+
+            case 'p':
+                value = (uintptr_t)va_arg(args, void*);
+                break;
+
+            default:
+                return false;
+        }
+        if (key->count == LOG_MAX_ARGS) {
+            return false;
+        }
+        key->args[key->count++] = value;
+    }
+    return true;
+}
+
+static bool same_key(const LogKey* a, const LogKey* b) {
+    return a->format == b->format && a->count == b->count &&
+           memcmp(a->args, b->args, a->count * sizeof(uint64_t)) == 0;
+}
+
+static void log_message(int level, int stream, const char* format, va_list args) {
+    char text[LOG_TEXT_SIZE];
+    Uint32 now = SDL_GetTicks();
+    LogRing* ring = thread_ring ? thread_ring : register_thread();
+    LogStream* state = ring ? find_stream(ring, stream, now) : NULL;
+    if (!state) {
+        vsnprintf(text, sizeof(text), format, args);
+        write_line(level, stream, text, 0);
+        return;
+    }
+
+    // Repeats and suppressed messages are recognised without formatting
+    // them; only messages that are written get formatted
+    LogKey key;
+    va_list copy;
+    va_copy(copy, args);
+    bool formatted = !read_key(&key, format, copy);
+    va_end(copy);
+    if (formatted) {
+        vsnprintf(text, sizeof(text), format, args);
+        key.format = NULL;
+        key.count = 1;
+        key.args[0] = hash_text(text);
+    }
+
+    for (int i = 0; i < LOG_RECENT; i++) {
+        LogRecent* recent = &state->recent[i];
+        if (recent->used && same_key(&recent->key, &key)) {
+            recent->repeats++;
+            if (now - recent->reported >= LOG_REPEAT_MS) {
+                report_repeats(ring, state, recent, now);
+            }
+            return;
+        }
+    }
+
+    if (now - state->burst_start >= LOG_BURST_MS) {
+        if (state->suppressed) {
+            report_suppressed(ring, state);
+        }
+        state->burst_start = now;
+        state->burst_used = 0;
+    }
+    if (state->burst_used == LOG_BURST) {
+        state->suppressed++;
+        return;
+    }
+    state->burst_used++;
+
+    // Replace the oldest distinct message, reporting what it still owes
+    LogRecent* recent = &state->recent[state->next_recent];
+    state->next_recent = (state->next_recent + 1) % LOG_RECENT;
+    if (recent->used && recent->repeats) {
+        report_repeats(ring, state, recent, now);
+    }
+    if (!formatted) {
+        vsnprintf(text, sizeof(text), format, args);
+    }
+    recent->used = true;
+    recent->key = key;
+    recent->level = level;
+    recent->repeats = 0;
+    recent->reported = now;
+    strcpy(recent->text, text);
+
+    push(ring, level, stream, text, 0);
+}
+
+void log_printf(int level, int stream, const char* format, ...) {
+    if (stream == LOG_SILENT || level < SDL_AtomicGet(&min_level)) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    log_message(level, stream, format, args);
+    va_end(args);
+}
+
+void log_set_level(int level) {
+    SDL_AtomicSet(&min_level, level);
+}
+
+// Writes everything queued so far
+static void drain(void) {
+    int count = SDL_AtomicGet(&ring_count);
+    if (count > LOG_MAX_THREADS) {
+        count = LOG_MAX_THREADS;
+    }
+
+    for (int slot = 0; slot < count; slot++) {
+        // NULL while the thread that took the slot is still allocating it
+        LogRing* ring = SDL_AtomicGetPtr(&rings[slot]);
+        if (!ring) {
+            continue;
+        }
+
+        unsigned tail = (unsigned)SDL_AtomicGet(&ring->tail);
+        unsigned head = (unsigned)SDL_AtomicGet(&ring->head);
+        for (; tail != head; tail++) {
+            LogMessage* message = &ring->messages[tail % LOG_RING_SIZE];
+            write_line(message->level, message->stream, message->text, message->repeats);
+        }
+        SDL_AtomicSet(&ring->tail, (int)tail);
+
+        int dropped = SDL_AtomicSet(&ring->dropped, 0);
+        if (dropped) {
+            char text[LOG_TEXT_SIZE];
+            snprintf(text, sizeof(text), "%d messages dropped, the log could not keep up", dropped);
+            write_line(LOG_WARN, 0, text, 0);
+        }
+    }
+    fflush(stdout);
+}
+
+static int drain_main(void* unused) {
+    (void)unused;
+    while (SDL_AtomicGet(&async)) {
+        SDL_SemWait(wake);
+        SDL_AtomicSet(&wake_pending, 0);
+        drain();
+    }
+    return 0;
+}
+
+bool log_start(void) {
+    if (drain_thread) {
+        return true;
+    }
+
+    wake = SDL_CreateSemaphore(0);
+    if (!wake) {
+        return false;
+    }
+    SDL_AtomicSet(&async, 1);
+    drain_thread = SDL_CreateThread(drain_main, "chip8_log", NULL);
+    if (!drain_thread) {
+        SDL_AtomicSet(&async, 0);
+        SDL_DestroySemaphore(wake);
+        wake = NULL;
+        return false;
+    }
+    return true;
+}
+
+void log_stop(void) {
+    if (drain_thread) {
+        SDL_AtomicSet(&async, 0);
+        SDL_SemPost(wake);
+        SDL_WaitThread(drain_thread, NULL);
+        drain_thread = NULL;
+        SDL_DestroySemaphore(wake);
+        wake = NULL;
+        drain();
+    }
+
+    // Nothing else logs now, so every thread's counts can be read from here
+    int count = SDL_AtomicGet(&ring_count);
+    for (int slot = 0; slot < count && slot < LOG_MAX_THREADS; slot++) {
+        LogRing* ring = SDL_AtomicGetPtr(&rings[slot]);
+        if (!ring) {
+            continue;
+        }
+        for (int s = 0; s < ring->stream_capacity; s++) {
+            LogStream* state = &ring->streams[s];
+            if (!state->used) {
+                continue;
+            }
+            for (int i = 0; i < LOG_RECENT; i++) {
+                if (state->recent[i].used && state->recent[i].repeats) {
+                    report_repeats(ring, state, &state->recent[i], SDL_GetTicks());
+                }
+            }
+            if (state->suppressed) {
+                report_suppressed(ring, state);
+            }
+        }
+    }
+    fflush(stdout);
+}
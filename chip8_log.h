@@ -0,0 +1,70 @@
+#ifndef CHIP8_LOG_H
+#define CHIP8_LOG_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Asynchronous, rate-limited logging
+//
+// Each thread formats its messages into a ring of its own, registered on
+// first use, and a background thread drains every ring to stdout. A full
+// ring drops the message and counts it, so logging never waits on the
+// console. Until log_start, and in tools that never call it, messages are
+// written directly.
+//
+// Repeats are folded per stream: a message identical to one of the last
+// LOG_RECENT distinct ones its stream logged is only counted, and the count
+// is reported at most once per LOG_REPEAT_MS, e.g.
+//   Warning: Unknown opcode 0x0123 at PC 0x2A4 (repeated 10000 times)
+// A stream may also log at most LOG_BURST distinct messages per second; the
+// rest are counted and reported as suppressed. So one noisy wall tile never
+// hides the messages of the others. (The state is kept per thread and
+// stream, so a stream logged from several threads gets a budget in each.)
+//
+// Errors skip the ring and are written at once, since they often come
+// right before the process exits.
+//
+// The stream says which instance a message is about: 0 when there is only
+// one, n for instance n of a wall (printed as "[n] "), or LOG_SILENT for
+// machines whose messages would only repeat another's (run-ahead futures).
+
+enum { LOG_DEBUG, LOG_INFO, LOG_WARN, LOG_ERROR };
+
+#define LOG_SILENT -1
+#define LOG_TEXT_SIZE 128
+#define LOG_RING_SIZE 256
+#define LOG_RECENT 8
+#define LOG_REPEAT_MS 1000
+#define LOG_BURST 50
+
+// Lets the compiler check format strings against their arguments, with the
+// printf flavour the C library's vsnprintf implements
+#ifdef __MINGW_PRINTF_FORMAT
+#define LOG_FORMAT __attribute__((format(__MINGW_PRINTF_FORMAT, 3, 4)))
+#else
+#define LOG_FORMAT __attribute__((format(printf, 3, 4)))
+#endif
+
+// Starts the drain thread. Returns false, and keeps logging synchronously,
+// if it cannot.
+bool log_start(void);
+// Reports outstanding repeats and suppressed counts, drains every ring and
+// stops the drain thread. Call once no other thread is logging.
+void log_stop(void);
+// Messages below `level` are discarded; LOG_INFO by default
+void log_set_level(int level);
+
+// printf-style; a trailing newline is added. Fuzzing builds compile the
+// core without the logger (and without SDL); there it still takes, and
+// checks, its arguments but does nothing.
+#ifdef CHIP8_NO_LOG
+LOG_FORMAT static inline void log_printf(int level, int stream, const char* format, ...) {
+    (void)level;
+    (void)stream;
+    (void)format;
+}
+#else
+LOG_FORMAT void log_printf(int level, int stream, const char* format, ...);
+#endif
+
+#endif
@@ -0,0 +1,545 @@
+#include "chip8_movie.h"
+#include "chip8_opcodes.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MOVIE_HEADER_SIZE 12
+// Frame, cycle and stream mask ahead of the machine state
+#define MOVIE_KEYFRAME_PREFIX 18
+#define MOVIE_EVENT_SIZE 10
+// Machine state up to the pending input: memory, V, I/pc/timers, stack, sp,
+// screen, keypad/draw flag/Cxnn/profile, cycle counters, scheduler, count
+#define MOVIE_STATE_FIXED (MEMORY_SIZE + REGISTER_COUNT + 6 + STACK_SIZE * 2 + 1 + \
+                           SCREEN_WIDTH * SCREEN_HEIGHT / 8 + 8 + 16 + 32 + 1)
+#define MOVIE_STATE_PROFILE (MOVIE_STATE_FIXED - 1 - 32 - 16 - 1)
+
+struct MovieRecorder {
+    FILE* file;
+    // Queue position up to which input has been recorded
+    uint32_t seen;
+    uint16_t mask;
+    uint64_t last_cycle;
+    uint64_t next_keyframe;
+};
+
+typedef struct {
+    uint64_t frame;
+    uint64_t cycle;
+    long offset;
+} MovieKeyframe;
+
+struct MoviePlayer {
+    FILE* file;
+    uint32_t seed;
+    uint16_t interval;
+    uint64_t length;
+    MovieKeyframe* keyframes;
+    int keyframe_count;
+
+    // Stream position
+    uint16_t mask;
+    uint64_t last_cycle;
+    bool ended;
+    // Next key change, read but not yet queued
+    bool pending;
+    uint64_t pending_cycle;
+    uint16_t pending_mask;
+};
+
+static void put_u16(uint8_t* buf, int* pos, uint16_t value) {
+    buf[(*pos)++] = (uint8_t)value;
+    buf[(*pos)++] = (uint8_t)(value >> 8);
+}
+
+static void put_u32(uint8_t* buf, int* pos, uint32_t value) {
+    put_u16(buf, pos, (uint16_t)value);
+    put_u16(buf, pos, (uint16_t)(value >> 16));
+}
+
+static void put_u64(uint8_t* buf, int* pos, uint64_t value) {
+    put_u32(buf, pos, (uint32_t)value);
+    put_u32(buf, pos, (uint32_t)(value >> 32));
+}
+
+static void put_varint(uint8_t* buf, int* pos, uint64_t value) {
+    while (value >= 0x80) {
+        buf[(*pos)++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[(*pos)++] = (uint8_t)value;
+}
+
+static uint16_t get_u16(const uint8_t* buf, int* pos) {
+    uint16_t value = buf[*pos] | buf[*pos + 1] << 8;
+    *pos += 2;
+    return value;
+}
+
+static uint32_t get_u32(const uint8_t* buf, int* pos) {
+    uint32_t low = get_u16(buf, pos);
+    return low | (uint32_t)get_u16(buf, pos) << 16;
+}
+
+static uint64_t get_u64(const uint8_t* buf, int* pos) {
+    uint64_t low = get_u32(buf, pos);
+    return low | (uint64_t)get_u32(buf, pos) << 32;
+}
+
+static bool read_varint(FILE* file, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(file);
+        if (byte == EOF) {
+            return false;
+        }
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_u16(FILE* file, uint16_t* value) {
+    uint8_t buf[2];
+    int pos = 0;
+    if (fread(buf, 1, 2, file) != 2) {
+        return false;
+    }
+    *value = get_u16(buf, &pos);
+    return true;
+}
+
+// Machine state
+
+int movie_write_state(const Chip8* cpu, uint8_t* buf) {
+    int pos = 0;
+    memcpy(buf + pos, cpu->memory, MEMORY_SIZE);
+    pos += MEMORY_SIZE;
+    memcpy(buf + pos, cpu->V, REGISTER_COUNT);
+    pos += REGISTER_COUNT;
+    put_u16(buf, &pos, cpu->I);
+    put_u16(buf, &pos, cpu->pc);
+    buf[pos++] = cpu->delay_timer;
+    buf[pos++] = cpu->sound_timer;
+    for (int i = 0; i < STACK_SIZE; i++) {
+        put_u16(buf, &pos, cpu->stack[i]);
+    }
+    buf[pos++] = cpu->sp;
+
+    // One bit per pixel, row-major
+    memset(buf + pos, 0, SCREEN_WIDTH * SCREEN_HEIGHT / 8);
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            int bit = y * SCREEN_WIDTH + x;
+            buf[pos + bit / 8] |= (cpu->screen[x][y] & 1) << (bit % 8);
+        }
+    }
+    pos += SCREEN_WIDTH * SCREEN_HEIGHT / 8;
+
+    put_u16(buf, &pos, chip8_keypad_mask(cpu));
+    buf[pos++] = cpu->draw_flag;
+    put_u32(buf, &pos, cpu->rng_state);
+    buf[pos++] = (uint8_t)(cpu->profile - quirk_profiles);
+    put_u64(buf, &pos, cpu->cycles);
+    put_u64(buf, &pos, cpu->idle_cycles);
+
+    const Chip8Scheduler* sched = &cpu->sched;
+    put_u32(buf, &pos, sched->timer_period);
+    put_u32(buf, &pos, sched->frame_period);
+    put_u64(buf, &pos, sched->next_timer);
+    put_u64(buf, &pos, sched->next_frame);
+    put_u64(buf, &pos, sched->frame_count);
+    buf[pos++] = (uint8_t)(sched->input_tail - sched->input_head);
+    for (uint32_t i = sched->input_head; i != sched->input_tail; i++) {
+        const Chip8InputEvent* event = &sched->input[i % CHIP8_INPUT_QUEUE_SIZE];
+        put_u64(buf, &pos, event->cycle);
+        buf[pos++] = event->type;
+        buf[pos++] = event->key;
+    }
+    return pos;
+}
+
+bool movie_read_state(Chip8* cpu, const uint8_t* buf, int size) {
+    if (size < MOVIE_STATE_FIXED || buf[MOVIE_STATE_FIXED - 1] > CHIP8_INPUT_QUEUE_SIZE ||
+        size != MOVIE_STATE_FIXED + buf[MOVIE_STATE_FIXED - 1] * MOVIE_EVENT_SIZE ||
+        buf[MOVIE_STATE_PROFILE] >= QUIRK_PROFILE_COUNT) {
+        return false;
+    }
+
+    int pos = 0;
+    memcpy(cpu->memory, buf + pos, MEMORY_SIZE);
+    pos += MEMORY_SIZE;
+    memcpy(cpu->V, buf + pos, REGISTER_COUNT);
+    pos += REGISTER_COUNT;
+    cpu->I = get_u16(buf, &pos);
+    cpu->pc = get_u16(buf, &pos);
+    cpu->delay_timer = buf[pos++];
+    cpu->sound_timer = buf[pos++];
+    for (int i = 0; i < STACK_SIZE; i++) {
+        cpu->stack[i] = get_u16(buf, &pos);
+    }
+    cpu->sp = buf[pos++];
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            int bit = y * SCREEN_WIDTH + x;
+            cpu->screen[x][y] = (buf[pos + bit / 8] >> (bit % 8)) & 1;
+        }
+    }
+    pos += SCREEN_WIDTH * SCREEN_HEIGHT / 8;
+
+    chip8_set_keypad_mask(cpu, get_u16(buf, &pos));
+    cpu->draw_flag = buf[pos++] != 0;
+    cpu->rng_state = get_u32(buf, &pos);
+    cpu->profile = &quirk_profiles[buf[pos++]];
+    cpu->cycles = get_u64(buf, &pos);
+    cpu->idle_cycles = get_u64(buf, &pos);
+
+    Chip8Scheduler* sched = &cpu->sched;
+    sched->timer_period = get_u32(buf, &pos);
+    sched->frame_period = get_u32(buf, &pos);
+    sched->next_timer = get_u64(buf, &pos);
+    sched->next_frame = get_u64(buf, &pos);
+    sched->frame_count = get_u64(buf, &pos);
+    sched->input_head = 0;
+    sched->input_tail = buf[pos++];
+    for (uint32_t i = 0; i < sched->input_tail; i++) {
+        Chip8InputEvent* event = &sched->input[i];
+        event->cycle = get_u64(buf, &pos);
+        event->type = buf[pos++];
+        event->key = buf[pos++] & KEY_MASK;
+    }
+    return true;
+}
+
+// Recording
+
+static void write_keyframe(MovieRecorder* movie, const Chip8* cpu) {
+    uint8_t buf[5 + MOVIE_KEYFRAME_PREFIX + MOVIE_MAX_STATE_SIZE];
+    int pos = 5;
+    put_u64(buf, &pos, cpu->sched.frame_count);
+    put_u64(buf, &pos, cpu->cycles);
+    put_u16(buf, &pos, movie->mask);
+    pos += movie_write_state(cpu, buf + pos);
+
+    int header = 0;
+    buf[header++] = MOVIE_KEYFRAME;
+    put_u32(buf, &header, pos - 5);
+    fwrite(buf, 1, pos, movie->file);
+
+    movie->last_cycle = cpu->cycles;
+    movie->next_keyframe = cpu->sched.frame_count + MOVIE_KEYFRAME_SECONDS * MOVIE_FPS;
+}
+
+MovieRecorder* movie_record_start(const char* filename, const Chip8* cpu) {
+    MovieRecorder* movie = calloc(1, sizeof(MovieRecorder));
+    if (!movie) {
+        return NULL;
+    }
+    movie->file = fopen(filename, "wb");
+    if (!movie->file) {
+        printf("Error: Could not create movie file: %s\n", filename);
+        free(movie);
+        return NULL;
+    }
+
+    uint8_t header[MOVIE_HEADER_SIZE];
+    int pos = 0;
+    memcpy(header, MOVIE_MAGIC, 4);
+    pos += 4;
+    header[pos++] = MOVIE_VERSION;
+    header[pos++] = MOVIE_FPS;
+    put_u16(header, &pos, MOVIE_KEYFRAME_SECONDS * MOVIE_FPS);
+    put_u32(header, &pos, cpu->rng_state);
+    fwrite(header, 1, pos, movie->file);
+
+    // Input already queued is part of the first keyframe; the stream mask
+    // starts out as the keypad once that input has been applied
+    const Chip8Scheduler* sched = &cpu->sched;
+    movie->mask = chip8_keypad_mask(cpu);
+    for (uint32_t i = sched->input_head; i != sched->input_tail; i++) {
+        const Chip8InputEvent* event = &sched->input[i % CHIP8_INPUT_QUEUE_SIZE];
+        if (event->type == CHIP8_EVENT_KEY_DOWN) {
+            movie->mask |= 1 << event->key;
+        } else {
+            movie->mask &= ~(1 << event->key);
+        }
+    }
+    movie->seen = sched->input_tail;
+    write_keyframe(movie, cpu);
+
+    printf("Recording movie to %s\n", filename);
+    return movie;
+}
+
+void movie_record_input(MovieRecorder* movie, const Chip8* cpu) {
+    const Chip8Scheduler* sched = &cpu->sched;
+
+    // Events dispatched before this call are still in the ring unless it
+    // wrapped, in which case the oldest are gone
+    uint32_t first = movie->seen;
+    if (sched->input_tail - first > CHIP8_INPUT_QUEUE_SIZE) {
+        first = sched->input_tail - CHIP8_INPUT_QUEUE_SIZE;
+    }
+
+    for (uint32_t i = first; i != sched->input_tail; i++) {
+        const Chip8InputEvent* event = &sched->input[i % CHIP8_INPUT_QUEUE_SIZE];
+        uint16_t mask = movie->mask;
+        if (event->type == CHIP8_EVENT_KEY_DOWN) {
+            mask |= 1 << event->key;
+        } else {
+            mask &= ~(1 << event->key);
+        }
+        if (mask == movie->mask) {
+            continue;
+        }
+
+        uint64_t cycle = event->cycle > movie->last_cycle ? event->cycle : movie->last_cycle;
+        uint8_t buf[16];
+        int pos = 0;
+        buf[pos++] = MOVIE_KEYS;
+        put_varint(buf, &pos, cycle - movie->last_cycle);
+        put_u16(buf, &pos, mask);
+        fwrite(buf, 1, pos, movie->file);
+
+        movie->mask = mask;
+        movie->last_cycle = cycle;
+    }
+    movie->seen = sched->input_tail;
+}
+
+void movie_record_frame(MovieRecorder* movie, const Chip8* cpu) {
+    if (cpu->sched.frame_count >= movie->next_keyframe) {
+        write_keyframe(movie, cpu);
+    }
+}
+
+void movie_record_stop(MovieRecorder* movie, const Chip8* cpu) {
+    if (!movie) {
+        return;
+    }
+
+    uint8_t buf[16];
+    int pos = 0;
+    buf[pos++] = MOVIE_END;
+    put_varint(buf, &pos, cpu->sched.frame_count);
+    fwrite(buf, 1, pos, movie->file);
+
+    if (fclose(movie->file) != 0) {
+        printf("Error: Could not finish movie file\n");
+    } else {
+        printf("Recorded %llu frames\n", (unsigned long long)cpu->sched.frame_count);
+    }
+    free(movie);
+}
+
+// Playback
+
+// Scans every record once to find the keyframes and the length
+static bool index_movie(MoviePlayer* movie) {
+    int capacity = 0;
+    for (;;) {
+        int type = fgetc(movie->file);
+        if (type == EOF) {
+            // A movie cut short still plays up to its last keyframe
+            return movie->keyframe_count > 0;
+        }
+
+        if (type == MOVIE_KEYS) {
+            uint64_t delta;
+            uint16_t mask;
+            if (!read_varint(movie->file, &delta) || !read_u16(movie->file, &mask)) {
+                return movie->keyframe_count > 0;
+            }
+        } else if (type == MOVIE_KEYFRAME) {
+            uint8_t prefix[4 + MOVIE_KEYFRAME_PREFIX];
+            if (fread(prefix, 1, sizeof(prefix), movie->file) != sizeof(prefix)) {
+                return movie->keyframe_count > 0;
+            }
+            int pos = 0;
+            uint32_t size = get_u32(prefix, &pos);
+            if (size < MOVIE_KEYFRAME_PREFIX || size > MOVIE_KEYFRAME_PREFIX + MOVIE_MAX_STATE_SIZE) {
+                return false;
+            }
+
+            if (movie->keyframe_count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                MovieKeyframe* grown = realloc(movie->keyframes, capacity * sizeof(MovieKeyframe));
+                if (!grown) {
+                    return false;
+                }
+                movie->keyframes = grown;
+            }
+            MovieKeyframe* keyframe = &movie->keyframes[movie->keyframe_count++];
+            keyframe->frame = get_u64(prefix, &pos);
+            keyframe->cycle = get_u64(prefix, &pos);
+            keyframe->offset = ftell(movie->file) - (long)sizeof(prefix) - 1;
+            movie->length = keyframe->frame;
+            if (fseek(movie->file, (long)size - MOVIE_KEYFRAME_PREFIX, SEEK_CUR) != 0) {
+                return false;
+            }
+        } else if (type == MOVIE_END) {
+            return read_varint(movie->file, &movie->length) && movie->keyframe_count > 0;
+        } else {
+            return false;
+        }
+    }
+}
+
+MoviePlayer* movie_open(const char* filename) {
+    MoviePlayer* movie = calloc(1, sizeof(MoviePlayer));
+    if (!movie) {
+        return NULL;
+    }
+    movie->file = fopen(filename, "rb");
+    if (!movie->file) {
+        printf("Error: Could not open movie file: %s\n", filename);
+        free(movie);
+        return NULL;
+    }
+
+    uint8_t header[MOVIE_HEADER_SIZE];
+    int pos = 6;
+    if (fread(header, 1, sizeof(header), movie->file) != sizeof(header) ||
+        memcmp(header, MOVIE_MAGIC, 4) != 0 || header[4] != MOVIE_VERSION) {
+        printf("Error: %s is not a CHIP-8 movie\n", filename);
+        movie_close(movie);
+        return NULL;
+    }
+    movie->interval = get_u16(header, &pos);
+    movie->seed = get_u32(header, &pos);
+
+    if (!index_movie(movie)) {
+        printf("Error: %s is truncated or corrupt\n", filename);
+        movie_close(movie);
+        return NULL;
+    }
+    return movie;
+}
+
+void movie_close(MoviePlayer* movie) {
+    if (!movie) {
+        return;
+    }
+    fclose(movie->file);
+    free(movie->keyframes);
+    free(movie);
+}
+
+uint64_t movie_length(const MoviePlayer* movie) {
+    return movie->length;
+}
+
+uint32_t movie_seed(const MoviePlayer* movie) {
+    return movie->seed;
+}
+
+int movie_keyframe_count(const MoviePlayer* movie) {
+    return movie->keyframe_count;
+}
+
+// Restores keyframe `index` and continues the stream after it
+static bool load_keyframe(MoviePlayer* movie, Chip8* cpu, int index) {
+    uint8_t buf[MOVIE_KEYFRAME_PREFIX + MOVIE_MAX_STATE_SIZE];
+    uint8_t header[5];
+    int pos = 1;
+    if (fseek(movie->file, movie->keyframes[index].offset, SEEK_SET) != 0 ||
+        fread(header, 1, sizeof(header), movie->file) != sizeof(header)) {
+        return false;
+    }
+    uint32_t size = get_u32(header, &pos);
+    if (size > sizeof(buf) || fread(buf, 1, size, movie->file) != size) {
+        return false;
+    }
+
+    pos = 16;
+    movie->mask = get_u16(buf, &pos);
+    movie->last_cycle = movie->keyframes[index].cycle;
+    movie->pending = false;
+    movie->ended = false;
+    return movie_read_state(cpu, buf + MOVIE_KEYFRAME_PREFIX, (int)size - MOVIE_KEYFRAME_PREFIX);
+}
+
+// Reads up to the next key change, skipping keyframes. False at the end.
+static bool next_keys(MoviePlayer* movie) {
+    while (!movie->pending && !movie->ended) {
+        int type = fgetc(movie->file);
+        if (type == MOVIE_KEYS) {
+            uint64_t delta;
+            if (!read_varint(movie->file, &delta) || !read_u16(movie->file, &movie->pending_mask)) {
+                movie->ended = true;
+                break;
+            }
+            movie->pending_cycle = movie->last_cycle + delta;
+            movie->pending = true;
+        } else if (type == MOVIE_KEYFRAME) {
+            uint8_t prefix[4 + MOVIE_KEYFRAME_PREFIX];
+            int pos = 0;
+            if (fread(prefix, 1, sizeof(prefix), movie->file) != sizeof(prefix)) {
+                movie->ended = true;
+                break;
+            }
+            uint32_t size = get_u32(prefix, &pos);
+            get_u64(prefix, &pos);
+            movie->last_cycle = get_u64(prefix, &pos);
+            fseek(movie->file, (long)size - MOVIE_KEYFRAME_PREFIX, SEEK_CUR);
+        } else {
+            movie->ended = true;
+        }
+    }
+    return movie->pending;
+}
+
+bool movie_play_frame(MoviePlayer* movie, Chip8* cpu) {
+    if (cpu->sched.frame_count >= movie->length) {
+        return false;
+    }
+
+    // Queue every change up to the end of the frame; if the queue fills,
+    // run up to the change first so nothing is applied early
+    uint64_t end = cpu->sched.next_frame;
+    while (next_keys(movie) && movie->pending_cycle <= end) {
+        const Chip8Scheduler* sched = &cpu->sched;
+        if (sched->input_tail - sched->input_head + KEY_COUNT > CHIP8_INPUT_QUEUE_SIZE) {
+            chip8_run_until(cpu, movie->pending_cycle);
+        }
+
+        uint16_t changed = movie->pending_mask ^ movie->mask;
+        for (int key = 0; key < KEY_COUNT; key++) {
+            if ((changed >> key) & 1) {
+                chip8_queue_key_at(cpu, movie->pending_cycle, (uint8_t)key, (movie->pending_mask >> key) & 1);
+            }
+        }
+        movie->mask = movie->pending_mask;
+        movie->last_cycle = movie->pending_cycle;
+        movie->pending = false;
+    }
+
+    chip8_run_frame(cpu);
+    return true;
+}
+
+bool movie_seek(MoviePlayer* movie, Chip8* cpu, uint64_t frame) {
+    // Latest keyframe strictly before the target, so it is reached on a
+    // frame boundary even if the keyframe was taken mid-frame
+    int index = 0;
+    int low = 1;
+    int high = movie->keyframe_count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (movie->keyframes[mid].frame < frame) {
+            index = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    if (!load_keyframe(movie, cpu, index)) {
+        return false;
+    }
+    while (cpu->sched.frame_count < frame && movie_play_frame(movie, cpu)) {
+    }
+    return true;
+}
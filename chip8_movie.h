@@ -0,0 +1,72 @@
+#ifndef CHIP8_MOVIE_H
+#define CHIP8_MOVIE_H
+
+#include "chip8_cpu.h"
+#include <stdio.h>
+
+// Deterministic input movies
+//
+// A movie is a starting state plus every keypad change stamped with the
+// cycle it takes effect on, so replaying it through the scheduler repeats
+// the session exactly, Cxnn rolls included (the generator state is part of
+// every keyframe). A full state keyframe every MOVIE_KEYFRAME_SECONDS lets
+// a player seek by restoring the nearest earlier keyframe and running at
+// most that many seconds of frames, instead of replaying from the start.
+//
+// File:     "C8MV" u8 version, u8 fps, u16 keyframe interval in frames,
+//           u32 Cxnn seed at the start, then records
+// Record:   u8 type, then
+//             MOVIE_KEYS      varint cycle - previous record's cycle,
+//                             u16 keypad mask from that cycle on
+//             MOVIE_KEYFRAME  u32 size, u64 frame, u64 cycle, u16 keypad
+//                             mask of the stream so far, machine state
+//             MOVIE_END       varint frame count
+// Machine:  memory, registers, stack, packed screen, keypad, Cxnn state,
+//           quirk profile, cycle counters, scheduler and pending input
+//
+// Multi-byte fixed fields are little-endian. The first record is always a
+// keyframe, so a movie does not need the ROM to play.
+
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 1
+#define MOVIE_FPS 60
+#define MOVIE_KEYFRAME_SECONDS 10
+#define MOVIE_MAX_STATE_SIZE 8192
+
+#define MOVIE_KEYS     0
+#define MOVIE_KEYFRAME 1
+#define MOVIE_END      2
+
+typedef struct MovieRecorder MovieRecorder;
+typedef struct MoviePlayer MoviePlayer;
+
+// Starts recording `cpu` from its current state into `filename`
+MovieRecorder* movie_record_start(const char* filename, const Chip8* cpu);
+// Records input queued on `cpu` since the last call; call right before
+// running it, after everything that queues keys
+void movie_record_input(MovieRecorder* movie, const Chip8* cpu);
+// Call after running; writes a keyframe when one is due
+void movie_record_frame(MovieRecorder* movie, const Chip8* cpu);
+void movie_record_stop(MovieRecorder* movie, const Chip8* cpu);
+
+// Opens a movie and indexes its keyframes
+MoviePlayer* movie_open(const char* filename);
+void movie_close(MoviePlayer* movie);
+// Recorded length in frames, and the state the recording started from
+uint64_t movie_length(const MoviePlayer* movie);
+uint32_t movie_seed(const MoviePlayer* movie);
+int movie_keyframe_count(const MoviePlayer* movie);
+// Puts `cpu` at frame `frame` of the movie. The tool hooks of `cpu` are
+// kept, as for chip8_load_state. Returns false if the file is corrupt.
+bool movie_seek(MoviePlayer* movie, Chip8* cpu, uint64_t frame);
+// Queues the recorded input for the next frame and runs it. Returns false
+// at the end of the movie. Start playback with movie_seek(movie, cpu, 0).
+bool movie_play_frame(MoviePlayer* movie, Chip8* cpu);
+
+// Portable machine state, also used by keyframes. Returns the size written
+// to `buf` (at most MOVIE_MAX_STATE_SIZE), or for reading, false if `buf`
+// does not hold a valid state.
+int movie_write_state(const Chip8* cpu, uint8_t* buf);
+bool movie_read_state(Chip8* cpu, const uint8_t* buf, int size);
+
+#endif
@@ -0,0 +1,157 @@
+#define SDL_MAIN_HANDLED
+#include "chip8_movie.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VERIFY_POINTS 8
+
+// Playback is silent
+void platform_beep(void) {
+}
+
+static double seconds_since(Uint64 start) {
+    return (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+static uint32_t screen_checksum(const Chip8* cpu) {
+    uint32_t hash = 2166136261u;
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            hash = (hash ^ cpu->screen[x][y]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage:\n");
+    printf("  %s info <movie>\n", program);
+    printf("  %s play <movie>           replay at full speed\n", program);
+    printf("  %s seek <movie> <frame>   jump to a frame through the nearest keyframe\n", program);
+    printf("  %s verify <movie>         check that seeking matches straight playback\n", program);
+}
+
+static int cmd_info(MoviePlayer* movie) {
+    uint64_t length = movie_length(movie);
+    printf("Frames:    %llu (%.1f s)\n", (unsigned long long)length, (double)length / MOVIE_FPS);
+    printf("Keyframes: %d\n", movie_keyframe_count(movie));
+    printf("Seed:      %08X\n", movie_seed(movie));
+    return 0;
+}
+
+static int cmd_play(MoviePlayer* movie) {
+    static Chip8 cpu;
+    chip8_init(&cpu);
+    cpu.muted = true;
+    if (!movie_seek(movie, &cpu, 0)) {
+        printf("Error: movie is corrupt\n");
+        return 1;
+    }
+
+    uint64_t first = cpu.sched.frame_count;
+    uint64_t cycles = cpu.cycles;
+    Uint64 start = SDL_GetPerformanceCounter();
+    while (movie_play_frame(movie, &cpu)) {
+    }
+    double seconds = seconds_since(start);
+
+    printf("Played %llu frames in %.3f s", (unsigned long long)(cpu.sched.frame_count - first), seconds);
+    if (seconds > 0) {
+        printf(", %.2f MIPS", (cpu.cycles - cycles) / seconds / 1e6);
+    }
+    printf("\nScreen checksum: %08X\n", screen_checksum(&cpu));
+    return 0;
+}
+
+static int cmd_seek(MoviePlayer* movie, uint64_t frame) {
+    static Chip8 cpu;
+    chip8_init(&cpu);
+    cpu.muted = true;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    if (!movie_seek(movie, &cpu, frame)) {
+        printf("Error: movie is corrupt\n");
+        return 1;
+    }
+    double seconds = seconds_since(start);
+
+    printf("Frame %llu reached in %.3f ms\n", (unsigned long long)cpu.sched.frame_count, seconds * 1000);
+    printf("Screen checksum: %08X\n", screen_checksum(&cpu));
+    return 0;
+}
+
+// Plays straight through and compares the whole machine at several frames
+// with what seeking to them produces. Seeking moves a player's stream, so
+// it gets a player of its own.
+static int cmd_verify(MoviePlayer* movie, const char* filename) {
+    MoviePlayer* seeker = movie_open(filename);
+    if (!seeker) {
+        return 1;
+    }
+
+    static Chip8 straight, sought;
+    static uint8_t expected[MOVIE_MAX_STATE_SIZE], actual[MOVIE_MAX_STATE_SIZE];
+    chip8_init(&straight);
+    chip8_init(&sought);
+    straight.muted = true;
+    sought.muted = true;
+
+    uint64_t length = movie_length(movie);
+    int mismatches = 0;
+    bool ok = movie_seek(movie, &straight, 0);
+    for (int point = 1; ok && point <= VERIFY_POINTS; point++) {
+        uint64_t frame = length * point / VERIFY_POINTS;
+        while (straight.sched.frame_count < frame && movie_play_frame(movie, &straight)) {
+        }
+        int expected_size = movie_write_state(&straight, expected);
+
+        ok = movie_seek(seeker, &sought, frame);
+        int actual_size = movie_write_state(&sought, actual);
+
+        bool same = expected_size == actual_size && memcmp(expected, actual, expected_size) == 0;
+        printf("Frame %-8llu %s\n", (unsigned long long)frame, same ? "ok" : "MISMATCH");
+        mismatches += !same;
+    }
+    movie_close(seeker);
+
+    if (!ok) {
+        printf("Error: movie is corrupt\n");
+        return 1;
+    }
+    return mismatches ? 2 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char* command = argv[1];
+    bool known = strcmp(command, "info") == 0 || strcmp(command, "play") == 0 ||
+                 strcmp(command, "verify") == 0 || (strcmp(command, "seek") == 0 && argc >= 4);
+    if (!known) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    MoviePlayer* movie = movie_open(argv[2]);
+    if (!movie) {
+        return 1;
+    }
+
+    int result;
+    if (strcmp(command, "info") == 0) {
+        result = cmd_info(movie);
+    } else if (strcmp(command, "play") == 0) {
+        result = cmd_play(movie);
+    } else if (strcmp(command, "seek") == 0) {
+        result = cmd_seek(movie, strtoull(argv[3], NULL, 10));
+    } else {
+        result = cmd_verify(movie, argv[2]);
+    }
+    movie_close(movie);
+    return result;
+}
@@ -0,0 +1,234 @@
+#include "chip8_net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET SocketHandle;
+#define close_socket closesocket
+#define SEND_FLAGS 0
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SocketHandle;
+#define INVALID_SOCKET -1
+#define close_socket close
+// A peer that disconnects must not raise SIGPIPE
+#define SEND_FLAGS MSG_NOSIGNAL
+#endif
+
+struct NetSocket {
+    SocketHandle handle;
+    struct sockaddr_in peer;
+    int has_peer;
+};
+
+int net_init(void) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        printf("Winsock initialization failed\n");
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+void net_cleanup(void) {
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+static int set_non_blocking(SocketHandle handle) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(handle, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(handle, F_GETFL, 0);
+    return flags >= 0 && fcntl(handle, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+static int would_block(void) {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+static NetSocket* wrap_handle(SocketHandle handle) {
+    NetSocket* sock = calloc(1, sizeof(NetSocket));
+    if (!sock) {
+        close_socket(handle);
+        return NULL;
+    }
+    sock->handle = handle;
+    return sock;
+}
+
+NetSocket* net_udp_open(uint16_t local_port) {
+    SocketHandle handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle == INVALID_SOCKET) {
+        printf("Could not create UDP socket\n");
+        return NULL;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(local_port);
+
+    if (bind(handle, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        printf("Could not bind UDP port %u\n", local_port);
+        close_socket(handle);
+        return NULL;
+    }
+    if (!set_non_blocking(handle)) {
+        printf("Could not make UDP socket non-blocking\n");
+        close_socket(handle);
+        return NULL;
+    }
+
+    return wrap_handle(handle);
+}
+
+int net_set_peer(NetSocket* sock, const char* host, uint16_t port) {
+    struct addrinfo hints;
+    struct addrinfo* result = NULL;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    if (getaddrinfo(host, NULL, &hints, &result) != 0 || !result) {
+        printf("Could not resolve host: %s\n", host);
+        return 0;
+    }
+
+    memcpy(&sock->peer, result->ai_addr, sizeof(sock->peer));
+    sock->peer.sin_port = htons(port);
+    sock->has_peer = 1;
+    freeaddrinfo(result);
+    return 1;
+}
+
+int net_send(NetSocket* sock, const void* data, int length) {
+    if (!sock->has_peer) {
+        return 0;
+    }
+    int sent = sendto(sock->handle, data, length, 0, (struct sockaddr*)&sock->peer,
+                      sizeof(sock->peer));
+    return sent == length;
+}
+
+int net_recv(NetSocket* sock, void* buffer, int capacity) {
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t from_length = sizeof(from);
+        int received = recvfrom(sock->handle, buffer, capacity, 0, (struct sockaddr*)&from,
+                                &from_length);
+        if (received <= 0) {
+            return 0;
+        }
+
+        // Ignore datagrams from anyone but the peer
+        if (sock->has_peer && (from.sin_addr.s_addr != sock->peer.sin_addr.s_addr ||
+                               from.sin_port != sock->peer.sin_port)) {
+            continue;
+        }
+        return received;
+    }
+}
+
+NetSocket* net_tcp_listen(uint16_t port) {
+    SocketHandle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (handle == INVALID_SOCKET) {
+        printf("Could not create TCP socket\n");
+        return NULL;
+    }
+
+    int reuse = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    if (bind(handle, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(handle, 4) != 0) {
+        printf("Could not listen on TCP port %u\n", port);
+        close_socket(handle);
+        return NULL;
+    }
+    if (!set_non_blocking(handle)) {
+        printf("Could not make TCP socket non-blocking\n");
+        close_socket(handle);
+        return NULL;
+    }
+
+    return wrap_handle(handle);
+}
+
+NetSocket* net_tcp_accept(NetSocket* listener) {
+    SocketHandle handle = accept(listener->handle, NULL, NULL);
+    if (handle == INVALID_SOCKET) {
+        return NULL;
+    }
+    if (!set_non_blocking(handle)) {
+        close_socket(handle);
+        return NULL;
+    }
+
+    int no_delay = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+    return wrap_handle(handle);
+}
+
+int net_stream_send(NetSocket* sock, const void* data, int length) {
+    const char* bytes = data;
+    int sent = 0;
+
+    // Sends what the socket takes now; the caller keeps the rest
+    while (sent < length) {
+        int result = send(sock->handle, bytes + sent, length - sent, SEND_FLAGS);
+        if (result > 0) {
+            sent += result;
+        } else if (result < 0 && would_block()) {
+            break;
+        } else {
+            return -1;
+        }
+    }
+    return sent;
+}
+
+int net_stream_recv(NetSocket* sock, void* buffer, int capacity) {
+    int received = recv(sock->handle, buffer, capacity, 0);
+    if (received > 0) {
+        return received;
+    }
+    if (received < 0 && would_block()) {
+        return 0;
+    }
+    return -1;
+}
+
+void net_close(NetSocket* sock) {
+    if (!sock) {
+        return;
+    }
+    close_socket(sock->handle);
+    free(sock);
+}
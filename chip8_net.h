@@ -0,0 +1,32 @@
+#ifndef CHIP8_NET_H
+#define CHIP8_NET_H
+
+#include <stdint.h>
+
+// Thin non-blocking socket layer over Winsock and BSD sockets
+
+typedef struct NetSocket NetSocket;
+
+int net_init(void);
+void net_cleanup(void);
+
+// UDP socket bound to `local_port` that talks to a single peer
+NetSocket* net_udp_open(uint16_t local_port);
+int net_set_peer(NetSocket* sock, const char* host, uint16_t port);
+int net_send(NetSocket* sock, const void* data, int length);
+// Returns the datagram length, or 0 when nothing is waiting
+int net_recv(NetSocket* sock, void* buffer, int capacity);
+
+// TCP listener on the loopback interface, for local tools
+NetSocket* net_tcp_listen(uint16_t port);
+// Returns the next waiting connection, or NULL when there is none
+NetSocket* net_tcp_accept(NetSocket* listener);
+// Stream I/O. Both return the byte count, 0 when the call would block and
+// -1 once the connection is closed. Neither waits: a send may take only
+// part of the data.
+int net_stream_send(NetSocket* sock, const void* data, int length);
+int net_stream_recv(NetSocket* sock, void* buffer, int capacity);
+
+void net_close(NetSocket* sock);
+
+#endif
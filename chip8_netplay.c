@@ -0,0 +1,266 @@
+#include "chip8_netplay.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PACKET_MAGIC "C8NP"
+#define PACKET_HELLO 1
+#define PACKET_INPUT 2
+#define PACKET_HEADER 5
+#define PACKET_MAX (PACKET_HEADER + 9 + NETPLAY_RING * 2)
+
+static void put_u32(uint8_t* buf, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        buf[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+static uint32_t get_u32(const uint8_t* buf) {
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+NetplaySession* netplay_create(int player, uint16_t local_port, const char* host, uint16_t port) {
+    if (player != 1 && player != 2) {
+        printf("Error: netplay player must be 1 or 2\n");
+        return NULL;
+    }
+    if (!net_init()) {
+        return NULL;
+    }
+
+    // The snapshots make the session cache-line aligned
+    NetplaySession* session = chip8_alloc(sizeof(NetplaySession));
+    if (!session) {
+        net_cleanup();
+        return NULL;
+    }
+    memset(session, 0, sizeof(NetplaySession));
+
+    session->sock = net_udp_open(local_port);
+    if (!session->sock || !net_set_peer(session->sock, host, port)) {
+        netplay_destroy(session);
+        return NULL;
+    }
+
+    // Player 1 chooses the seed, player 2 adopts it
+    session->player = player;
+    session->seed = (player == 1) ? (uint32_t)time(NULL) : 0;
+    for (int i = 0; i < NETPLAY_RING; i++) {
+        session->remote_frame[i] = UINT32_MAX;
+    }
+
+    printf("Netplay: player %d on port %u, peer %s:%u\n", player, local_port, host, port);
+    return session;
+}
+
+void netplay_destroy(NetplaySession* session) {
+    if (!session) {
+        return;
+    }
+    if (session->rollbacks) {
+        printf("Netplay: %u rollbacks, %u frames re-simulated, worst %.3f ms\n",
+               session->rollbacks, session->resimulated_frames, session->max_rollback_ms);
+    }
+    net_close(session->sock);
+    net_cleanup();
+    chip8_free(session);
+}
+
+static void send_hello(NetplaySession* session) {
+    uint8_t packet[PACKET_HEADER + 5];
+    memcpy(packet, PACKET_MAGIC, 4);
+    packet[4] = PACKET_HELLO;
+    packet[5] = (uint8_t)session->player;
+    put_u32(packet + 6, session->seed);
+    net_send(session->sock, packet, sizeof(packet));
+    session->last_hello = SDL_GetTicks();
+}
+
+// Sends every local input the peer has not acknowledged yet
+static void send_inputs(NetplaySession* session) {
+    uint8_t packet[PACKET_MAX];
+    if (session->frame == 0) {
+        return;
+    }
+
+    // Oldest unacknowledged frame still in the ring, and at least the newest
+    // frame so the peer keeps hearing from us while it is stalled
+    uint32_t first = session->peer_ack;
+    if (session->frame >= NETPLAY_RING && first < session->frame - NETPLAY_RING + 1) {
+        first = session->frame - NETPLAY_RING + 1;
+    }
+    if (first >= session->frame) {
+        first = session->frame - 1;
+    }
+    uint32_t count = session->frame - first;
+
+    memcpy(packet, PACKET_MAGIC, 4);
+    packet[4] = PACKET_INPUT;
+    put_u32(packet + 5, first);
+    packet[9] = (uint8_t)count;
+    put_u32(packet + 10, session->remote_confirmed);
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t mask = session->local_input[(first + i) % NETPLAY_RING];
+        packet[14 + i * 2] = mask & 0xFF;
+        packet[15 + i * 2] = mask >> 8;
+    }
+    net_send(session->sock, packet, 14 + count * 2);
+}
+
+// Records a confirmed remote input. Returns the frame to roll back to, or
+// UINT32_MAX if the prediction for that frame was right.
+static uint32_t receive_input(NetplaySession* session, uint32_t frame, uint16_t mask) {
+    if (frame < session->remote_confirmed || frame >= session->frame + NETPLAY_MAX_ROLLBACK + 1) {
+        return UINT32_MAX;
+    }
+
+    int slot = frame % NETPLAY_RING;
+    uint32_t rollback = UINT32_MAX;
+    if (frame < session->frame && session->remote_frame[slot] == frame &&
+        !session->remote_known[slot] && session->remote_input[slot] != mask) {
+        rollback = frame;
+    }
+
+    session->remote_input[slot] = mask;
+    session->remote_frame[slot] = frame;
+    session->remote_known[slot] = true;
+    return rollback;
+}
+
+// Drains the socket; returns the earliest mispredicted frame
+static uint32_t poll_packets(NetplaySession* session, Chip8* cpu) {
+    uint8_t packet[PACKET_MAX];
+    uint32_t rollback = UINT32_MAX;
+    int length;
+
+    while ((length = net_recv(session->sock, packet, sizeof(packet))) > 0) {
+        if (length < PACKET_HEADER || memcmp(packet, PACKET_MAGIC, 4) != 0) {
+            continue;
+        }
+
+        if (packet[4] == PACKET_HELLO && length >= PACKET_HEADER + 5) {
+            if (session->player == 2 && !session->connected) {
+                session->seed = get_u32(packet + 6);
+                chip8_seed_rng(cpu, session->seed);
+                session->connected = true;
+                printf("Netplay: connected, seed %08X\n", session->seed);
+            }
+            if (session->player == 1 && !session->connected) {
+                session->connected = true;
+                printf("Netplay: connected, seed %08X\n", session->seed);
+            }
+            // Answer so a peer that missed our hello can finish connecting
+            if (SDL_GetTicks() - session->last_hello >= NETPLAY_HELLO_INTERVAL_MS) {
+                send_hello(session);
+            }
+        } else if (packet[4] == PACKET_INPUT && length >= 14) {
+            // Inputs from player 2 also prove it has our seed
+            if (!session->connected) {
+                if (session->player == 2) {
+                    continue;
+                }
+                session->connected = true;
+                printf("Netplay: connected, seed %08X\n", session->seed);
+            }
+            uint32_t first = get_u32(packet + 5);
+            uint32_t count = packet[9];
+            uint32_t ack = get_u32(packet + 10);
+            if (length < (int)(14 + count * 2)) {
+                continue;
+            }
+            if (ack > session->peer_ack) {
+                session->peer_ack = ack;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                uint16_t mask = packet[14 + i * 2] | packet[15 + i * 2] << 8;
+                uint32_t frame = receive_input(session, first + i, mask);
+                if (frame < rollback) {
+                    rollback = frame;
+                }
+            }
+        }
+    }
+
+    while (session->remote_frame[session->remote_confirmed % NETPLAY_RING] == session->remote_confirmed &&
+           session->remote_known[session->remote_confirmed % NETPLAY_RING]) {
+        session->remote_confirmed++;
+    }
+    return rollback;
+}
+
+bool netplay_connect(NetplaySession* session, Chip8* cpu) {
+    if (!session->connected) {
+        if (session->player == 1) {
+            chip8_seed_rng(cpu, session->seed);
+        }
+        if (SDL_GetTicks() - session->last_hello >= NETPLAY_HELLO_INTERVAL_MS) {
+            send_hello(session);
+        }
+        poll_packets(session, cpu);
+    }
+    return session->connected;
+}
+
+// Remote input for a frame: the confirmed value, or a repeat of the last one
+static uint16_t remote_input_for(NetplaySession* session, uint32_t frame) {
+    int slot = frame % NETPLAY_RING;
+    if (session->remote_frame[slot] == frame && session->remote_known[slot]) {
+        return session->remote_input[slot];
+    }
+
+    uint16_t predicted = 0;
+    if (session->remote_confirmed > 0) {
+        predicted = session->remote_input[(session->remote_confirmed - 1) % NETPLAY_RING];
+    }
+    session->remote_input[slot] = predicted;
+    session->remote_frame[slot] = frame;
+    session->remote_known[slot] = false;
+    return predicted;
+}
+
+static void simulate_frame(NetplaySession* session, Chip8* cpu, uint32_t frame) {
+    int slot = frame % NETPLAY_RING;
+    chip8_save_state(cpu, &session->snapshots[slot]);
+    chip8_set_keypad_mask(cpu, session->local_input[slot] | remote_input_for(session, frame));
+    chip8_run_frame(cpu);
+}
+
+bool netplay_advance(NetplaySession* session, Chip8* cpu, uint16_t local_mask) {
+    uint32_t rollback = poll_packets(session, cpu);
+
+    // Never run further ahead of the peer than a rollback can repair
+    if (session->frame >= session->remote_confirmed + NETPLAY_MAX_ROLLBACK) {
+        send_inputs(session);
+        return false;
+    }
+
+    if (rollback < session->frame) {
+        Uint64 start = SDL_GetPerformanceCounter();
+        bool muted = cpu->muted;
+
+        // Re-simulate silently from the first mispredicted frame
+        chip8_load_state(cpu, &session->snapshots[rollback % NETPLAY_RING]);
+        cpu->muted = true;
+        for (uint32_t frame = rollback; frame < session->frame; frame++) {
+            simulate_frame(session, cpu, frame);
+            session->resimulated_frames++;
+        }
+        cpu->muted = muted;
+        cpu->draw_flag = true;
+
+        double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        if (ms > session->max_rollback_ms) {
+            session->max_rollback_ms = ms;
+        }
+        session->rollbacks++;
+    }
+
+    session->local_input[session->frame % NETPLAY_RING] = local_mask;
+    simulate_frame(session, cpu, session->frame);
+    session->frame++;
+
+    send_inputs(session);
+    return true;
+}
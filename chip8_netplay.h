@@ -0,0 +1,56 @@
+#ifndef CHIP8_NETPLAY_H
+#define CHIP8_NETPLAY_H
+
+#include "chip8_cpu.h"
+#include "chip8_net.h"
+
+// Two-player rollback netplay over UDP
+//
+// Each side sends its keypad mask for every frame and runs ahead using a
+// prediction of the remote input (the last confirmed one). When a remote
+// input arrives that differs from the prediction, the session restores the
+// snapshot taken at the start of that frame and silently re-simulates up to
+// the present. Both sides OR their masks together, so each player simply
+// uses their own keys.
+
+#define NETPLAY_MAX_ROLLBACK 8
+#define NETPLAY_RING 32
+#define NETPLAY_HELLO_INTERVAL_MS 100
+
+typedef struct {
+    NetSocket* sock;
+    int player;
+    bool connected;
+    uint32_t seed;
+    uint32_t last_hello;
+
+    // Next frame to simulate, and the count of leading remote frames known
+    uint32_t frame;
+    uint32_t remote_confirmed;
+    uint32_t peer_ack;
+
+    // Ring buffers indexed by frame % NETPLAY_RING, tagged with their frame
+    uint16_t local_input[NETPLAY_RING];
+    uint16_t remote_input[NETPLAY_RING];
+    uint32_t remote_frame[NETPLAY_RING];
+    bool remote_known[NETPLAY_RING];
+    Chip8 snapshots[NETPLAY_RING];
+
+    // Statistics
+    uint32_t rollbacks;
+    uint32_t resimulated_frames;
+    double max_rollback_ms;
+} NetplaySession;
+
+NetplaySession* netplay_create(int player, uint16_t local_port, const char* host, uint16_t port);
+void netplay_destroy(NetplaySession* session);
+
+// Exchanges hello packets; returns true once both sides share the RNG seed,
+// which is then applied to `cpu`. Call once per frame until it succeeds.
+bool netplay_connect(NetplaySession* session, Chip8* cpu);
+
+// Runs one frame with the local player's keypad mask. Returns false if the
+// session is stalled waiting for the peer and no frame was run.
+bool netplay_advance(NetplaySession* session, Chip8* cpu, uint16_t local_mask);
+
+#endif
@@ -3,6 +3,29 @@
 
 #include "chip8_cpu.h"
 
+typedef enum {
+    QUIRKS_CHIP8,
+    QUIRKS_SCHIP,
+    QUIRKS_XOCHIP,
+    QUIRK_PROFILE_COUNT
+} QuirkProfileId;
+
+// Guest memory an opcode reads or writes, excluding the instruction fetch
+typedef struct {
+    uint16_t read_addr;
+    uint8_t read_len;
+    uint16_t write_addr;
+    uint8_t write_len;
+} Chip8MemAccess;
+
+extern const QuirkProfile quirk_profiles[QUIRK_PROFILE_COUNT];
+
+// Executes one opcode with the default CHIP-8 quirks
 void execute_opcode(Chip8* cpu, uint16_t opcode);
 
+const QuirkProfile* chip8_find_profile(const char* name);
+const QuirkProfile* chip8_profile_for_rom(const char* filename);
+
+void chip8_decode_mem_access(const Chip8* cpu, uint16_t opcode, Chip8MemAccess* access);
+
 #endif
@@ -0,0 +1,371 @@
+// Interpreter template. Included once per quirk profile by
+// chip8_opcodes_profiles.h.
+//
+// Before including, define:
+//   PROFILE_NAME                  suffix for the generated functions
+//   QUIRK_SHIFT_USES_VY           8xy6/8xyE shift Vy into Vx (otherwise Vx in place)
+//   QUIRK_LOGIC_RESETS_VF         8xy1/8xy2/8xy3 clear VF
+//   QUIRK_LOADSTORE_INCREMENTS_I  Fx55/Fx65 leave I pointing past the last register
+//   QUIRK_JUMP_USES_VX            Bxnn jumps to xnn + Vx (otherwise nnn + V0)
+//   QUIRK_SPRITES_CLIP            Dxyn clips at the screen edge (otherwise wraps)
+//
+// Guest addresses wrap at 4 KB and the stack pointer wraps at 16 entries, so
+// no ROM can index outside the Chip8 arrays.
+//
+// Every quirk is resolved by the preprocessor, so the generated code never
+// tests a quirk flag while running.
+//
+// execute returns true when the guest is idling: a jump to itself, or Fx0A
+// with no key down. Nothing changes until the next scheduler event, so the run
+// loop stops early and the scheduler skips the remaining cycles.
+//
+// Tools build instrumented copies of run (chip8_opcodes_profiles.h) by
+// also defining
+//   PROFILE_EXECUTE(execute, cpu, i, pc, opcode)
+// which replaces each execute(cpu, opcode) call in the loop. `i` is the
+// instruction's index in the batch and `pc` its address. The wrapper runs
+// execute once and returns its result, and is inlined along with it, so
+// the instrumentation costs no call per instruction. Instrumented copies
+// have no step.
+
+#define PROFILE_CONCAT_(a, b) a##_##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_FN(name) PROFILE_CONCAT(name, PROFILE_NAME)
+
+#ifndef PROFILE_EXECUTE
+#define PROFILE_EXECUTE(execute, cpu, i, pc, opcode) execute(cpu, opcode)
+#define PROFILE_PLAIN
+#endif
+
+static inline bool PROFILE_FN(execute)(Chip8* cpu, uint16_t opcode) {
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t n = opcode & 0x000F;
+    uint8_t nn = opcode & 0x00FF;
+    uint16_t nnn = opcode & 0x0FFF;
+
+    switch (opcode & 0xF000) {
+        case 0x0000:
+            switch (opcode) {
+                case 0x00E0:
+                    for (int i = 0; i < SCREEN_WIDTH; i++) {
+                        for (int j = 0; j < SCREEN_HEIGHT; j++) {
+                            cpu->screen[i][j] = 0;
+                        }
+                    }
+                    cpu->draw_flag = true;
+                    break;
+
+                case 0x00EE:
+                    cpu->sp--;
+                    cpu->pc = cpu->stack[cpu->sp & STACK_MASK];
+                    break;
+
+                default:
+                    CHIP8_UNKNOWN_OPCODE(cpu, opcode);
+                    break;
+            }
+            break;
+
+        case 0x1000:
+            if (nnn == cpu->pc - 2) {
+                cpu->pc = nnn;
+                return true;
+            }
+            cpu->pc = nnn;
+            break;
+
+        case 0x2000:
+            cpu->stack[cpu->sp & STACK_MASK] = cpu->pc;
+            cpu->sp++;
+            cpu->pc = nnn;
+            break;
+
+        case 0x3000:
+            if (cpu->V[x] == nn) {
+                cpu->pc += 2;
+            }
+            break;
+
+        case 0x4000:
+            if (cpu->V[x] != nn) {
+                cpu->pc += 2;
+            }
+            break;
+
+        case 0x5000:
+            if (cpu->V[x] == cpu->V[y]) {
+                cpu->pc += 2;
+            }
+            break;
+
+        case 0x6000:
+            cpu->V[x] = nn;
+            break;
+
+        case 0x7000:
+            cpu->V[x] += nn;
+            break;
+
+        case 0x8000:
+            switch (n) {
+                case 0x0:
+                    cpu->V[x] = cpu->V[y];
+                    break;
+
+                case 0x1:
+                    cpu->V[x] |= cpu->V[y];
+#if QUIRK_LOGIC_RESETS_VF
+                    cpu->V[0xF] = 0;
+#endif
+                    break;
+
+                case 0x2:
+                    cpu->V[x] &= cpu->V[y];
+#if QUIRK_LOGIC_RESETS_VF
+                    cpu->V[0xF] = 0;
+#endif
+                    break;
+
+                case 0x3:
+                    cpu->V[x] ^= cpu->V[y];
+#if QUIRK_LOGIC_RESETS_VF
+                    cpu->V[0xF] = 0;
+#endif
+                    break;
+
+                case 0x4: {
+                    uint16_t sum = cpu->V[x] + cpu->V[y];
+                    cpu->V[x] = sum & 0xFF;
+                    cpu->V[0xF] = (sum > 255) ? 1 : 0;
+                    break;
+                }
+
+                case 0x5:
+                    cpu->V[0xF] = (cpu->V[x] > cpu->V[y]) ? 1 : 0;
+                    cpu->V[x] -= cpu->V[y];
+                    break;
+
+                case 0x6: {
+#if QUIRK_SHIFT_USES_VY
+                    uint8_t src = cpu->V[y];
+#else
+                    uint8_t src = cpu->V[x];
+#endif
+                    cpu->V[0xF] = src & 0x1;
+                    cpu->V[x] = src >> 1;
+                    break;
+                }
+
+                case 0x7:
+                    cpu->V[0xF] = (cpu->V[y] > cpu->V[x]) ? 1 : 0;
+                    cpu->V[x] = cpu->V[y] - cpu->V[x];
+                    break;
+
+                case 0xE: {
+#if QUIRK_SHIFT_USES_VY
+                    uint8_t src = cpu->V[y];
+#else
+                    uint8_t src = cpu->V[x];
+#endif
+                    cpu->V[0xF] = (src & 0x80) >> 7;
+                    cpu->V[x] = src << 1;
+                    break;
+                }
+
+                default:
+                    CHIP8_UNKNOWN_OPCODE(cpu, opcode);
+                    break;
+            }
+            break;
+
+        case 0x9000:
+            if (cpu->V[x] != cpu->V[y]) {
+                cpu->pc += 2;
+            }
+            break;
+
+        case 0xA000:
+            cpu->I = nnn;
+            break;
+
+        case 0xB000:
+#if QUIRK_JUMP_USES_VX
+            cpu->pc = nnn + cpu->V[x];
+#else
+            cpu->pc = nnn + cpu->V[0];
+#endif
+            break;
+
+        case 0xC000: {
+            uint8_t random = chip8_random(cpu);
+            cpu->V[x] = random & nn;
+            break;
+        }
+
+        case 0xD000: {
+            uint8_t xPos = cpu->V[x] % SCREEN_WIDTH;
+            uint8_t yPos = cpu->V[y] % SCREEN_HEIGHT;
+            cpu->V[0xF] = 0;
+
+            for (int row = 0; row < n; row++) {
+#if QUIRK_SPRITES_CLIP
+                if (yPos + row >= SCREEN_HEIGHT) {
+                    break;
+                }
+#endif
+                uint8_t sprite = cpu->memory[(cpu->I + row) & ADDR_MASK];
+                for (int col = 0; col < 8; col++) {
+                    if ((sprite & (0x80 >> col)) != 0) {
+#if QUIRK_SPRITES_CLIP
+                        int xPixel = xPos + col;
+                        int yPixel = yPos + row;
+                        if (xPixel >= SCREEN_WIDTH) {
+                            break;
+                        }
+#else
+                        int xPixel = (xPos + col) % SCREEN_WIDTH;
+                        int yPixel = (yPos + row) % SCREEN_HEIGHT;
+#endif
+
+                        if (cpu->screen[xPixel][yPixel] == 1) {
+                            cpu->V[0xF] = 1;
+                        }
+
+                        cpu->screen[xPixel][yPixel] ^= 1;
+                    }
+                }
+            }
+            cpu->draw_flag = true;
+            break;
+        }
+
+        case 0xE000:
+            switch (nn) {
+                case 0x9E:
+                    if (cpu->keypad & (1 << (cpu->V[x] & KEY_MASK))) {
+                        cpu->pc += 2;
+                    }
+                    break;
+
+                case 0xA1:
+                    if (!(cpu->keypad & (1 << (cpu->V[x] & KEY_MASK)))) {
+                        cpu->pc += 2;
+                    }
+                    break;
+
+                default:
+                    CHIP8_UNKNOWN_OPCODE(cpu, opcode);
+                    break;
+            }
+            break;
+
+        case 0xF000:
+            switch (nn) {
+                case 0x07:
+                    cpu->V[x] = cpu->delay_timer;
+                    break;
+
+                case 0x0A: {
+                    bool key_down = false;
+                    for (int i = 0; i < KEY_COUNT; i++) {
+                        if (cpu->keypad & (1 << i)) {
+                            cpu->V[x] = i;
+                            key_down = true;
+                            break;
+                        }
+                    }
+                    cpu->pc -= 2;
+                    if (!key_down) {
+                        return true;
+                    }
+                    break;
+                }
+
+                case 0x15:
+                    cpu->delay_timer = cpu->V[x];
+                    break;
+
+                case 0x18:
+                    cpu->sound_timer = cpu->V[x];
+                    break;
+
+                case 0x1E:
+                    cpu->I += cpu->V[x];
+                    break;
+
+                case 0x29:
+                    cpu->I = cpu->V[x] * 5;
+                    break;
+
+                case 0x33:
+                    cpu->memory[cpu->I & ADDR_MASK] = cpu->V[x] / 100;
+                    cpu->memory[(cpu->I + 1) & ADDR_MASK] = (cpu->V[x] / 10) % 10;
+                    cpu->memory[(cpu->I + 2) & ADDR_MASK] = cpu->V[x] % 10;
+                    break;
+
+                case 0x55:
+                    for (int i = 0; i <= x; i++) {
+                        cpu->memory[(cpu->I + i) & ADDR_MASK] = cpu->V[i];
+                    }
+#if QUIRK_LOADSTORE_INCREMENTS_I
+                    cpu->I += x + 1;
+#endif
+                    break;
+
+                case 0x65:
+                    for (int i = 0; i <= x; i++) {
+                        cpu->V[i] = cpu->memory[(cpu->I + i) & ADDR_MASK];
+                    }
+#if QUIRK_LOADSTORE_INCREMENTS_I
+                    cpu->I += x + 1;
+#endif
+                    break;
+
+                default:
+                    CHIP8_UNKNOWN_OPCODE(cpu, opcode);
+                    break;
+            }
+            break;
+
+        default:
+            CHIP8_UNKNOWN_OPCODE(cpu, opcode);
+            break;
+    }
+    return false;
+}
+
+// Fetch/execute loop for this profile with the interpreter inlined. Returns
+// the number of instructions executed, which is less than `cycles` if the
+// guest went idle.
+static int PROFILE_FN(run)(Chip8* cpu, int cycles) {
+    for (int i = 0; i < cycles; i++) {
+        uint16_t pc = cpu->pc;
+        uint16_t opcode = cpu->memory[pc & ADDR_MASK] << 8 | cpu->memory[(pc + 1) & ADDR_MASK];
+        cpu->pc = pc + 2;
+
+        if (PROFILE_EXECUTE(PROFILE_FN(execute), cpu, i, pc, opcode)) {
+            return i + 1;
+        }
+    }
+    return cycles;
+}
+
+#ifdef PROFILE_PLAIN
+static void PROFILE_FN(step)(Chip8* cpu, uint16_t opcode) {
+    PROFILE_FN(execute)(cpu, opcode);
+}
+
+#undef PROFILE_EXECUTE
+#undef PROFILE_PLAIN
+#endif
+
+#undef PROFILE_FN
+#undef PROFILE_CONCAT
+#undef PROFILE_CONCAT_
+#undef PROFILE_NAME
+#undef QUIRK_SHIFT_USES_VY
+#undef QUIRK_LOGIC_RESETS_VF
+#undef QUIRK_LOADSTORE_INCREMENTS_I
+#undef QUIRK_JUMP_USES_VX
+#undef QUIRK_SPRITES_CLIP
@@ -0,0 +1,67 @@
+// The quirk profiles, one interpreter each from chip8_opcodes_impl.h.
+// Included once by chip8_opcodes.c for the plain interpreters, and once by
+// each tool that wants its own instrumented copy of all of them.
+//
+// Before including, optionally define:
+//   PROFILE_VARIANT   suffix for the generated names (run_chip8_traced)
+//   PROFILE_EXECUTE   instrumentation around each instruction, see
+//                     chip8_opcodes_impl.h
+
+#include "chip8_cpu.h"
+#include "chip8_log.h"
+
+#ifdef PROFILE_VARIANT
+#define PROFILE_VARIANT_CONCAT_(a, b) a##_##b
+#define PROFILE_VARIANT_CONCAT(a, b) PROFILE_VARIANT_CONCAT_(a, b)
+#define PROFILE_VARIANT_NAME(name) PROFILE_VARIANT_CONCAT(name, PROFILE_VARIANT)
+#else
+#define PROFILE_VARIANT_NAME(name) name
+#endif
+
+// A bad ROM can hit these every cycle; the logger folds the repeats and
+// never blocks. Fuzzing builds define CHIP8_NO_LOG, which compiles it out.
+#define CHIP8_UNKNOWN_OPCODE(cpu, opcode) \
+    log_printf(LOG_WARN, (cpu)->log_stream, "Unknown opcode 0x%04X at PC 0x%03X", (opcode), (cpu)->pc - 2)
+
+// Per-instance xorshift32 so that Cxnn is reproducible from the seed
+static inline uint8_t chip8_random(Chip8* cpu) {
+    uint32_t state = cpu->rng_state;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    cpu->rng_state = state;
+    return state >> 24;
+}
+
+// Original COSMAC VIP behaviour (the emulator's historical default)
+#define PROFILE_NAME PROFILE_VARIANT_NAME(chip8)
+#define QUIRK_SHIFT_USES_VY 1
+#define QUIRK_LOGIC_RESETS_VF 1
+#define QUIRK_LOADSTORE_INCREMENTS_I 1
+#define QUIRK_JUMP_USES_VX 0
+#define QUIRK_SPRITES_CLIP 0
+#include "chip8_opcodes_impl.h"
+
+// SUPER-CHIP 1.1 on the HP48
+#define PROFILE_NAME PROFILE_VARIANT_NAME(schip)
+#define QUIRK_SHIFT_USES_VY 0
+#define QUIRK_LOGIC_RESETS_VF 0
+#define QUIRK_LOADSTORE_INCREMENTS_I 0
+#define QUIRK_JUMP_USES_VX 1
+#define QUIRK_SPRITES_CLIP 1
+#include "chip8_opcodes_impl.h"
+
+// XO-CHIP as implemented by Octo
+#define PROFILE_NAME PROFILE_VARIANT_NAME(xochip)
+#define QUIRK_SHIFT_USES_VY 1
+#define QUIRK_LOGIC_RESETS_VF 0
+#define QUIRK_LOADSTORE_INCREMENTS_I 1
+#define QUIRK_JUMP_USES_VX 0
+#define QUIRK_SPRITES_CLIP 0
+#include "chip8_opcodes_impl.h"
+
+#undef PROFILE_VARIANT_NAME
+#ifdef PROFILE_VARIANT
+#undef PROFILE_VARIANT_CONCAT
+#undef PROFILE_VARIANT_CONCAT_
+#endif
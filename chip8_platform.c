@@ -1,4 +1,9 @@
 #include "chip8_platform.h"
+#include "chip8_hud.h"
+#include "chip8_log.h"
+#include "chip8_filter.h"
+#include "chip8_pool.h"
+#include "chip8_spans.h"
 #include <SDL2/SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,6 +15,51 @@ static SDL_Renderer* renderer = NULL;
 static SDL_Texture* texture = NULL;
 static int quit_flag = 0;
 
+// CPU upscaling (F4 scaler, F5 scanlines/CRT) into an output-sized texture,
+// created on the first filtered draw
+static FilterPipeline* filter = NULL;
+static SDL_Texture* filter_texture = NULL;
+static int filter_width = 0;
+static int filter_height = 0;
+static FilterScaler filter_scaler_mode = SCALER_NONE;
+static FilterPost filter_post_mode = POST_NONE;
+
+// Wall mode atlas texture and layout, created on the first wall draw
+static SDL_Texture* wall_texture = NULL;
+static int wall_cols = 0;
+static int wall_rows = 0;
+static int focus_request = FOCUS_NONE;
+
+// Set by F3, consumed by the main loop to start or stop video capture
+static int record_request = 0;
+
+// Set by F6, consumed by the main loop to start or stop span tracing
+static int trace_request = 0;
+
+// Set by F7, consumed by the main loop to start or stop an input movie
+static int movie_request = 0;
+
+// Set by F9, consumed by the main loop to switch to the next ROM slot
+static int slot_request = 0;
+
+// Paths of ROMs dropped on the window, oldest first, until the main loop
+// takes them
+#define MAX_DROPPED_ROMS 8
+static char* dropped_roms[MAX_DROPPED_ROMS];
+static int dropped_count = 0;
+
+// Set by F8; emulation also stops while the window is hidden or unfocused
+static bool user_paused = false;
+static bool window_hidden = false;
+static bool window_unfocused = false;
+
+// Set when the window must be drawn without a new frame: the config UI
+// changed, a filter was picked or the window contents were lost
+static int redraw_request = 0;
+
+// CHIP-8 keys currently held on the host keyboard
+static uint16_t held_keys = 0;
+
 static const int SCREEN_SCALE = 10;
 static const int WINDOW_WIDTH = SCREEN_WIDTH * SCREEN_SCALE;
 static const int WINDOW_HEIGHT = SCREEN_HEIGHT * SCREEN_SCALE;
@@ -33,10 +83,6 @@ static const char* chip8_key_labels[KEY_COUNT] = {
 // Game speed control
 int game_speed_percent = DEFAULT_SPEED_PERCENT;
 
-// Function declarations for speed display
-static void draw_digit(int x, int y, int digit, int size, SDL_Color color);
-static void draw_speed_display(void);
-
 // Key mapping initialization
 KeyMapping keymap[KEY_COUNT] = {
     {0x1, SDLK_1, "1"},
@@ -69,7 +115,7 @@ ConfigState config_state = {
 
 void platform_init(void) {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
-        printf("SDL initialization failed: %s\n", SDL_GetError());
+        log_printf(LOG_ERROR, 0, "SDL initialization failed: %s", SDL_GetError());
         exit(1);
     }
     
@@ -86,14 +132,14 @@ void platform_init(void) {
     SDL_EventState(SDL_DROPFILE, SDL_ENABLE);
     
     if (!window) {
-        printf("Window creation failed: %s\n", SDL_GetError());
+        log_printf(LOG_ERROR, 0, "Window creation failed: %s", SDL_GetError());
         SDL_Quit();
         exit(1);
     }
     
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     if (!renderer) {
-        printf("Renderer creation failed: %s\n", SDL_GetError());
+        log_printf(LOG_ERROR, 0, "Renderer creation failed: %s", SDL_GetError());
         SDL_DestroyWindow(window);
         SDL_Quit();
         exit(1);
@@ -108,13 +154,16 @@ void platform_init(void) {
     );
     
     if (!texture) {
-        printf("Texture creation failed: %s\n", SDL_GetError());
+        log_printf(LOG_ERROR, 0, "Texture creation failed: %s", SDL_GetError());
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         SDL_Quit();
         exit(1);
     }
 
+    hud_init(renderer);
+    hud_set_speed(game_speed_percent);
+
     // Try to load custom key mappings from file
     platform_load_key_mappings("keymap.cfg");
     
@@ -160,6 +209,14 @@ void platform_init(void) {
 }
 
 void platform_cleanup(void) {
+    hud_cleanup();
+    filter_destroy(filter);
+    if (filter_texture) {
+        SDL_DestroyTexture(filter_texture);
+    }
+    if (wall_texture) {
+        SDL_DestroyTexture(wall_texture);
+    }
     if (texture) {
         SDL_DestroyTexture(texture);
     }
@@ -172,6 +229,64 @@ void platform_cleanup(void) {
     SDL_Quit();
 }
 
+static void platform_cycle_filter(bool post) {
+    if (post) {
+        filter_post_mode = (filter_post_mode + 1) % POST_COUNT;
+    } else {
+        filter_scaler_mode = (filter_scaler_mode + 1) % SCALER_COUNT;
+    }
+    log_printf(LOG_INFO, 0, "Filter: %s, %s", filter_scaler_name(filter_scaler_mode), filter_post_name(filter_post_mode));
+}
+
+// Runs the CPU filter into a streaming texture the size of the output.
+// Returns false to fall back to the GPU stretch.
+static bool platform_draw_filtered(const Chip8* cpu) {
+    int width, height;
+    if (SDL_GetRendererOutputSize(renderer, &width, &height) != 0) {
+        return false;
+    }
+    
+    if (!filter) {
+        filter = filter_create(pool_default_threads());
+        if (!filter) {
+            return false;
+        }
+    }
+    if (!filter_texture || width != filter_width || height != filter_height) {
+        if (filter_texture) {
+            SDL_DestroyTexture(filter_texture);
+        }
+        filter_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                           SDL_TEXTUREACCESS_STREAMING, width, height);
+        if (!filter_texture) {
+            log_printf(LOG_ERROR, 0, "Filter texture creation failed: %s", SDL_GetError());
+            filter_scaler_mode = SCALER_NONE;
+            filter_post_mode = POST_NONE;
+            return false;
+        }
+        filter_width = width;
+        filter_height = height;
+    }
+    
+    // The filter writes straight into the locked texture, so conversion and
+    // upload are one span
+    Uint64 span = spans_begin();
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(filter_texture, NULL, &pixels, &pitch) != 0) {
+        return false;
+    }
+    filter_set_mode(filter, filter_scaler_mode, filter_post_mode);
+    bool ok = filter_render(filter, cpu, pixels, pitch, width, height);
+    SDL_UnlockTexture(filter_texture);
+    spans_end(span, "convert_upload", -1);
+    
+    if (ok) {
+        SDL_RenderCopy(renderer, filter_texture, NULL, NULL);
+    }
+    return ok;
+}
+
 void platform_draw(const Chip8* cpu) {
     // Clear screen
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
@@ -179,16 +294,26 @@ void platform_draw(const Chip8* cpu) {
     
     // Draw CHIP-8 screen if not in configuration mode
     if (!config_state.is_configuring && cpu != NULL) {
-        uint32_t pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+        bool filtered = (filter_scaler_mode != SCALER_NONE || filter_post_mode != POST_NONE) &&
+                        platform_draw_filtered(cpu);
         
-        for (int y = 0; y < SCREEN_HEIGHT; y++) {
-            for (int x = 0; x < SCREEN_WIDTH; x++) {
-                pixels[y * SCREEN_WIDTH + x] = cpu->screen[x][y] ? 0xFFFFFFFF : 0xFF000000;
+        // Otherwise upload 64x32 and let the GPU stretch it
+        if (!filtered) {
+            uint32_t pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+            
+            Uint64 span = spans_begin();
+            for (int y = 0; y < SCREEN_HEIGHT; y++) {
+                for (int x = 0; x < SCREEN_WIDTH; x++) {
+                    pixels[y * SCREEN_WIDTH + x] = cpu->screen[x][y] ? 0xFFFFFFFF : 0xFF000000;
+                }
             }
+            spans_end(span, "convert", -1);
+            
+            span = spans_begin();
+            SDL_UpdateTexture(texture, NULL, pixels, SCREEN_WIDTH * sizeof(uint32_t));
+            spans_end(span, "upload", -1);
+            SDL_RenderCopy(renderer, texture, NULL, NULL);
         }
-        
-        SDL_UpdateTexture(texture, NULL, pixels, SCREEN_WIDTH * sizeof(uint32_t));
-        SDL_RenderCopy(renderer, texture, NULL, NULL);
     }
     
     // Draw configuration interface if needed
@@ -196,15 +321,196 @@ void platform_draw(const Chip8* cpu) {
         platform_draw_virtual_keyboard();
     }
     
-    // Draw speed display in top-right corner
-    draw_speed_display();
+    // Speed display and performance overlay
+    hud_draw(renderer, WINDOW_WIDTH);
+    
+    Uint64 span = spans_begin();
+    Uint64 present_start = SDL_GetPerformanceCounter();
+    SDL_RenderPresent(renderer);
+    Uint64 present_end = SDL_GetPerformanceCounter();
+    spans_end(span, "present", -1);
+    hud_record_present((double)(present_end - present_start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+// Letterboxed area the wall atlas is drawn into
+static SDL_Rect wall_viewport(int cols, int rows) {
+    int atlas_w = cols * SCREEN_WIDTH;
+    int atlas_h = rows * SCREEN_HEIGHT;
+    double scale_x = (double)WINDOW_WIDTH / atlas_w;
+    double scale_y = (double)WINDOW_HEIGHT / atlas_h;
+    double scale = scale_x < scale_y ? scale_x : scale_y;
+    
+    SDL_Rect rect;
+    rect.w = (int)(atlas_w * scale);
+    rect.h = (int)(atlas_h * scale);
+    rect.x = (WINDOW_WIDTH - rect.w) / 2;
+    rect.y = (WINDOW_HEIGHT - rect.h) / 2;
+    return rect;
+}
+
+// Draws every wall tile with one texture upload, one copy and one present
+void platform_draw_wall(const uint32_t* atlas, int cols, int rows, int focus) {
+    if (!wall_texture || cols != wall_cols || rows != wall_rows) {
+        if (wall_texture) {
+            SDL_DestroyTexture(wall_texture);
+        }
+        wall_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                         SDL_TEXTUREACCESS_STREAMING,
+                                         cols * SCREEN_WIDTH, rows * SCREEN_HEIGHT);
+        if (!wall_texture) {
+            log_printf(LOG_ERROR, 0, "Wall texture creation failed: %s", SDL_GetError());
+            return;
+        }
+        wall_cols = cols;
+        wall_rows = rows;
+    }
+    
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    
+    Uint64 upload = spans_begin();
+    SDL_UpdateTexture(wall_texture, NULL, atlas, cols * SCREEN_WIDTH * sizeof(uint32_t));
+    spans_end(upload, "upload", -1);
+    SDL_Rect viewport = wall_viewport(cols, rows);
+    SDL_RenderCopy(renderer, wall_texture, NULL, &viewport);
+    
+    // Outline the tile that receives keyboard input
+    SDL_Rect outline = {
+        viewport.x + (focus % cols) * viewport.w / cols,
+        viewport.y + (focus / cols) * viewport.h / rows,
+        viewport.w / cols,
+        viewport.h / rows
+    };
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+    SDL_RenderDrawRect(renderer, &outline);
+    
+    hud_draw(renderer, WINDOW_WIDTH);
     
+    Uint64 span = spans_begin();
+    Uint64 present_start = SDL_GetPerformanceCounter();
     SDL_RenderPresent(renderer);
+    Uint64 present_end = SDL_GetPerformanceCounter();
+    spans_end(span, "present", -1);
+    hud_record_present((double)(present_end - present_start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+// CHIP-8 keys held on the keyboard as a bitmask, for callers that apply
+// input themselves instead of through platform_handle_input's CPU
+uint16_t platform_get_held_keys(void) {
+    return held_keys;
+}
+
+// Returns the tile picked with Tab or a mouse click since the last call
+int platform_take_focus_request(void) {
+    int request = focus_request;
+    focus_request = FOCUS_NONE;
+    return request;
+}
+
+// Returns whether F3 was pressed since the last call
+int platform_take_record_request(void) {
+    int request = record_request;
+    record_request = 0;
+    return request;
+}
+
+// Returns whether F6 was pressed since the last call
+int platform_take_trace_request(void) {
+    int request = trace_request;
+    trace_request = 0;
+    return request;
+}
+
+// Returns whether F7 was pressed since the last call
+int platform_take_movie_request(void) {
+    int request = movie_request;
+    movie_request = 0;
+    return request;
+}
+
+// Returns whether F9 was pressed since the last call
+int platform_take_slot_request(void) {
+    int request = slot_request;
+    slot_request = 0;
+    return request;
+}
+
+// Returns the oldest dropped ROM path not yet taken, or NULL. The caller
+// frees it with SDL_free.
+char* platform_take_dropped_rom(void) {
+    if (dropped_count == 0) {
+        return NULL;
+    }
+    char* path = dropped_roms[0];
+    dropped_count--;
+    memmove(dropped_roms, dropped_roms + 1, dropped_count * sizeof(char*));
+    return path;
+}
+
+// Returns whether the window needs drawing although no frame was emulated
+int platform_take_redraw_request(void) {
+    int request = redraw_request;
+    redraw_request = 0;
+    return request;
+}
+
+// Paused with F8
+bool platform_is_paused(void) {
+    return user_paused;
+}
+
+// Minimized, hidden or without keyboard focus
+bool platform_is_backgrounded(void) {
+    return window_hidden || window_unfocused;
+}
+
+// Tracks whether the window can be seen and has focus, and asks for a
+// redraw when its contents were lost
+static void handle_window_event(const SDL_WindowEvent* window) {
+    switch (window->event) {
+        case SDL_WINDOWEVENT_HIDDEN:
+        case SDL_WINDOWEVENT_MINIMIZED:
+            window_hidden = true;
+            break;
+        case SDL_WINDOWEVENT_SHOWN:
+        case SDL_WINDOWEVENT_RESTORED:
+        case SDL_WINDOWEVENT_MAXIMIZED:
+            window_hidden = false;
+            redraw_request = 1;
+            break;
+        case SDL_WINDOWEVENT_EXPOSED:
+        case SDL_WINDOWEVENT_SIZE_CHANGED:
+            redraw_request = 1;
+            break;
+        case SDL_WINDOWEVENT_FOCUS_LOST:
+            window_unfocused = true;
+            break;
+        case SDL_WINDOWEVENT_FOCUS_GAINED:
+            window_unfocused = false;
+            break;
+    }
+}
+
+// Sleeps until an event arrives or `timeout_ms` passes (forever if it is
+// negative), then handles every queued event, so an idle window costs no
+// CPU between events
+int platform_wait_input(Chip8* cpu, int timeout_ms) {
+    if (timeout_ms != 0) {
+        Uint64 span = spans_begin();
+        if (timeout_ms < 0) {
+            SDL_WaitEvent(NULL);
+        } else {
+            SDL_WaitEventTimeout(NULL, timeout_ms);
+        }
+        spans_end(span, "wait", -1);
+    }
+    return platform_handle_input(cpu);
 }
 
 int platform_handle_input(Chip8* cpu) {
     SDL_Event event;
     int rom_dropped = 0;
+    Uint64 span = spans_begin();
     
     while (SDL_PollEvent(&event)) {
         if (event.type == SDL_QUIT) {
@@ -214,22 +520,84 @@ int platform_handle_input(Chip8* cpu) {
         // Toggle configuration mode with F1 key
         if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F1) {
             platform_toggle_config_mode();
+            redraw_request = 1;
+        }
+        
+        // Toggle performance overlay with F2 key
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F2) {
+            hud_toggle();
+        }
+        
+        // Start or stop video capture with F3 key
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3 && !event.key.repeat) {
+            record_request = 1;
+        }
+        
+        // Cycle the upscaler with F4 and the scanline/CRT pass with F5
+        if (event.type == SDL_KEYDOWN && (event.key.keysym.sym == SDLK_F4 || event.key.keysym.sym == SDLK_F5)) {
+            platform_cycle_filter(event.key.keysym.sym == SDLK_F5);
+            redraw_request = 1;
+        }
+        
+        // Start span tracing, or stop it and write the trace, with F6 key
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F6 && !event.key.repeat) {
+            trace_request = 1;
+        }
+        
+        // Start or stop recording an input movie with F7 key
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F7 && !event.key.repeat) {
+            movie_request = 1;
+        }
+        
+        // Pause or resume emulation with F8 key
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F8 && !event.key.repeat) {
+            user_paused = !user_paused;
+            log_printf(LOG_INFO, 0, "%s", user_paused ? "Paused, press F8 to resume" : "Resumed");
+        }
+        
+        // Switch to the next loaded ROM with F9 key
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9 && !event.key.repeat) {
+            slot_request = 1;
+        }
+        
+        if (event.type == SDL_WINDOWEVENT) {
+            handle_window_event(&event.window);
         }
         
         // Handle configuration mode input
         if (config_state.is_configuring) {
+            redraw_request = 1;
             if (platform_handle_config_input(&event)) {
                 continue; // Skip regular input if handled by config
             }
         }
         
+        // Wall mode focus: Tab cycles, clicking picks a tile
+        if (wall_cols > 0) {
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_TAB) {
+                focus_request = FOCUS_NEXT;
+            }
+            if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
+                SDL_Rect viewport = wall_viewport(wall_cols, wall_rows);
+                int col = (event.button.x - viewport.x) * wall_cols / viewport.w;
+                int row = (event.button.y - viewport.y) * wall_rows / viewport.h;
+                if (event.button.x >= viewport.x && event.button.y >= viewport.y &&
+                    col < wall_cols && row < wall_rows) {
+                    focus_request = row * wall_cols + col;
+                }
+            }
+        }
+        
         if (event.type == SDL_KEYDOWN) {
             for (int i = 0; i < KEY_COUNT; i++) {
                 if (event.key.keysym.sym == keymap[i].sdl_key) {
                     // Find the chip8 key index
                     int chip8_key = keymap[i].chip8_key;
                     if (chip8_key < KEY_COUNT) {
-                        cpu->keypad[chip8_key] = 1;
+                        held_keys |= 1 << chip8_key;
+                        if (cpu) {
+                            chip8_queue_key(cpu, chip8_key, true);
+                        }
                     }
                 }
             }
@@ -251,7 +619,10 @@ int platform_handle_input(Chip8* cpu) {
                     // Find the chip8 key index
                     int chip8_key = keymap[i].chip8_key;
                     if (chip8_key < KEY_COUNT) {
-                        cpu->keypad[chip8_key] = 0;
+                        held_keys &= ~(1 << chip8_key);
+                        if (cpu) {
+                            chip8_queue_key(cpu, chip8_key, false);
+                        }
                     }
                 }
             }
@@ -259,18 +630,21 @@ int platform_handle_input(Chip8* cpu) {
         
         if (event.type == SDL_DROPFILE) {
             char* file_path = event.drop.file;
-            printf("Loading ROM: %s\n", file_path);
-            
-            // Load the ROM into the CPU
-            chip8_load_rom(cpu, file_path);
             
-            // Free the file path allocated by SDL
-            SDL_free(file_path);
-            
-            rom_dropped = 1;
+            // Without a CPU (netplay) the ROM cannot change mid-session.
+            // Otherwise the main loop decides where the ROM goes.
+            if (cpu && dropped_count < MAX_DROPPED_ROMS) {
+                log_printf(LOG_INFO, 0, "Loading ROM: %s", file_path);
+                dropped_roms[dropped_count++] = file_path;
+                rom_dropped = 1;
+            } else {
+                // Free the file path allocated by SDL
+                SDL_free(file_path);
+            }
         }
     }
     
+    spans_end(span, "input", -1);
     return rom_dropped;
 }
 
@@ -278,95 +652,6 @@ void platform_beep(void) {
     Beep(440, 100);
 }
 
-// Simple 7-segment display for digits
-static void draw_digit(int x, int y, int digit, int size, SDL_Color color) {
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    
-    // Define 7-segment display segments (0-6)
-    bool segments[10][7] = {
-        {1, 1, 1, 1, 1, 1, 0}, // 0
-        {0, 1, 1, 0, 0, 0, 0}, // 1
-        {1, 1, 0, 1, 1, 0, 1}, // 2
-        {1, 1, 1, 1, 0, 0, 1}, // 3
-        {0, 1, 1, 0, 0, 1, 1}, // 4
-        {1, 0, 1, 1, 0, 1, 1}, // 5
-        {1, 0, 1, 1, 1, 1, 1}, // 6
-        {1, 1, 1, 0, 0, 0, 0}, // 7
-        {1, 1, 1, 1, 1, 1, 1}, // 8
-        {1, 1, 1, 1, 0, 1, 1}  // 9
-    };
-    
-    // Segment positions
-    int w = size;
-    int h = size;
-    int t = size / 4; // Thickness
-    
-    // Horizontal segments
-    if (segments[digit][0]) { // Top segment
-        SDL_Rect seg = {x + t, y, w - 2*t, t};
-        SDL_RenderFillRect(renderer, &seg);
-    }
-    if (segments[digit][3]) { // Middle segment
-        SDL_Rect seg = {x + t, y + h/2 - t/2, w - 2*t, t};
-        SDL_RenderFillRect(renderer, &seg);
-    }
-    if (segments[digit][6]) { // Bottom segment
-        SDL_Rect seg = {x + t, y + h - t, w - 2*t, t};
-        SDL_RenderFillRect(renderer, &seg);
-    }
-    
-    // Vertical segments
-    if (segments[digit][1]) { // Top-right
-        SDL_Rect seg = {x + w - t, y + t, t, h/2 - t};
-        SDL_RenderFillRect(renderer, &seg);
-    }
-    if (segments[digit][2]) { // Bottom-right
-        SDL_Rect seg = {x + w - t, y + h/2, t, h/2 - t};
-        SDL_RenderFillRect(renderer, &seg);
-    }
-    if (segments[digit][4]) { // Top-left
-        SDL_Rect seg = {x, y + t, t, h/2 - t};
-        SDL_RenderFillRect(renderer, &seg);
-    }
-    if (segments[digit][5]) { // Bottom-left
-        SDL_Rect seg = {x, y + h/2, t, h/2 - t};
-        SDL_RenderFillRect(renderer, &seg);
-    }
-}
-
-// Draw speed percentage in top-right corner
-static void draw_speed_display(void) {
-    int speed = game_speed_percent;
-    SDL_Color color = {255, 255, 255, 255};
-    
-    int x = WINDOW_WIDTH - 120;
-    int y = 20;
-    int size = 20;
-    int spacing = 5;
-    
-    // Draw digits
-    int hundreds = speed / 100;
-    int tens = (speed / 10) % 10;
-    int units = speed % 10;
-    
-    if (hundreds > 0) {
-        draw_digit(x, y, hundreds, size, color);
-        x += size + spacing;
-    }
-    
-    draw_digit(x, y, tens, size, color);
-    x += size + spacing;
-    
-    draw_digit(x, y, units, size, color);
-    x += size + spacing;
-    
-    // Draw percentage sign
-    int percent_size = size / 2;
-    SDL_Rect percent_rect = {x, y + size - percent_size, percent_size, percent_size};
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    SDL_RenderFillRect(renderer, &percent_rect);
-}
-
 int platform_should_quit(void) {
     return quit_flag;
 }
@@ -378,7 +663,7 @@ void platform_set_key_mapping(int chip8_key, SDL_Keycode sdl_key) {
             keymap[i].sdl_key = sdl_key;
             // Update label to show current mapping
             keymap[i].label = platform_get_key_name(sdl_key);
-            printf("Mapped CHIP-8 key %X to SDL key %s\n", chip8_key, platform_get_key_name(sdl_key));
+            log_printf(LOG_INFO, 0, "Mapped CHIP-8 key %X to SDL key %s", chip8_key, platform_get_key_name(sdl_key));
             break;
         }
     }
@@ -388,7 +673,7 @@ void platform_set_key_mapping(int chip8_key, SDL_Keycode sdl_key) {
 void platform_load_key_mappings(const char* filename) {
     FILE* file = fopen(filename, "r");
     if (!file) {
-        printf("Could not open key mappings file: %s\n", filename);
+        log_printf(LOG_WARN, 0, "Could not open key mappings file: %s", filename);
         return;
     }
 
@@ -402,14 +687,14 @@ void platform_load_key_mappings(const char* filename) {
     }
 
     fclose(file);
-    printf("Loaded %d key mappings from %s\n", loaded, filename);
+    log_printf(LOG_INFO, 0, "Loaded %d key mappings from %s", loaded, filename);
 }
 
 // Save current key mappings to a configuration file
 void platform_save_key_mappings(const char* filename) {
     FILE* file = fopen(filename, "w");
     if (!file) {
-        printf("Could not create key mappings file: %s\n", filename);
+        log_printf(LOG_WARN, 0, "Could not create key mappings file: %s", filename);
         return;
     }
 
@@ -418,7 +703,7 @@ void platform_save_key_mappings(const char* filename) {
     }
 
     fclose(file);
-    printf("Saved key mappings to %s\n", filename);
+    log_printf(LOG_INFO, 0, "Saved key mappings to %s", filename);
 }
 
 // Reset key mappings to default values
@@ -444,7 +729,7 @@ void platform_reset_key_mappings(void) {
     };
 
     memcpy(keymap, default_keymap, sizeof(default_keymap));
-    printf("Key mappings reset to default\n");
+    log_printf(LOG_INFO, 0, "Key mappings reset to default");
 }
 
 // Toggle configuration mode
@@ -454,13 +739,13 @@ void platform_toggle_config_mode(void) {
     config_state.is_learning = false;
     
     if (config_state.is_configuring) {
-        printf("Entered key mapping configuration mode\n");
-        printf("- Click on a virtual key to select it\n");
-        printf("- Press any key to map it\n");
-        printf("- Press R to reset to default mappings\n");
-        printf("- Press F1 to exit configuration mode\n");
+        log_printf(LOG_INFO, 0, "Entered key mapping configuration mode");
+        log_printf(LOG_INFO, 0, "- Click on a virtual key to select it");
+        log_printf(LOG_INFO, 0, "- Press any key to map it");
+        log_printf(LOG_INFO, 0, "- Press R to reset to default mappings");
+        log_printf(LOG_INFO, 0, "- Press F1 to exit configuration mode");
     } else {
-        printf("Exited configuration mode\n");
+        log_printf(LOG_INFO, 0, "Exited configuration mode");
         // Save mappings when exiting configuration mode
         platform_save_key_mappings("keymap.cfg");
     }
@@ -574,7 +859,7 @@ int platform_handle_config_input(const SDL_Event* event) {
                 
                 config_state.selected_key = vkey->chip8_key;
                 config_state.is_learning = true;
-                printf("Select CHIP-8 key %X. Press any key to map it...\n", vkey->chip8_key);
+                log_printf(LOG_INFO, 0, "Select CHIP-8 key %X. Press any key to map it...", vkey->chip8_key);
                 return 1;
             }
         }
@@ -640,7 +925,8 @@ double platform_get_speed_factor(void) {
 void platform_increase_speed(void) {
     if (game_speed_percent < MAX_SPEED_PERCENT) {
         game_speed_percent += 10;
-        printf("Game speed increased to %d%%\n", game_speed_percent);
+        hud_set_speed(game_speed_percent);
+        log_printf(LOG_INFO, 0, "Game speed increased to %d%%", game_speed_percent);
     }
 }
 
@@ -648,6 +934,7 @@ void platform_increase_speed(void) {
 void platform_decrease_speed(void) {
     if (game_speed_percent > MIN_SPEED_PERCENT) {
         game_speed_percent -= 10;
-        printf("Game speed decreased to %d%%\n", game_speed_percent);
+        hud_set_speed(game_speed_percent);
+        log_printf(LOG_INFO, 0, "Game speed decreased to %d%%", game_speed_percent);
     }
 }
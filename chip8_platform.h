@@ -34,9 +34,14 @@ extern ConfigState config_state;
 void platform_init(void);
 void platform_cleanup(void);
 void platform_draw(const Chip8* cpu);
+// Returns whether a ROM was dropped on the window (only when `cpu` is
+// given); take it with platform_take_dropped_rom
 int platform_handle_input(Chip8* cpu);
+int platform_wait_input(Chip8* cpu, int timeout_ms);
+int platform_take_redraw_request(void);
 void platform_beep(void);
 int platform_should_quit(void);
+uint16_t platform_get_held_keys(void);
 
 // Key mapping functions
 void platform_set_key_mapping(int chip8_key, SDL_Keycode sdl_key);
@@ -44,6 +49,30 @@ void platform_load_key_mappings(const char* filename);
 void platform_save_key_mappings(const char* filename);
 void platform_reset_key_mappings(void);
 
+// Wall mode
+#define FOCUS_NONE -1
+#define FOCUS_NEXT -2
+
+void platform_draw_wall(const uint32_t* atlas, int cols, int rows, int focus);
+int platform_take_focus_request(void);
+
+// Video capture toggle (F3)
+int platform_take_record_request(void);
+
+// Span tracing toggle (F6)
+int platform_take_trace_request(void);
+
+// Input movie toggle (F7)
+int platform_take_movie_request(void);
+
+// Dropped ROM files, and the ROM slot switch (F9)
+char* platform_take_dropped_rom(void);
+int platform_take_slot_request(void);
+
+// Pause (F8), and whether the window is minimized or unfocused
+bool platform_is_paused(void);
+bool platform_is_backgrounded(void);
+
 // Speed control
 #define MIN_SPEED_PERCENT 50
 #define MAX_SPEED_PERCENT 200
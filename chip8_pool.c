@@ -0,0 +1,160 @@
+#include "chip8_pool.h"
+#include "chip8_spans.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    WorkerPool* pool;
+    SDL_Thread* thread;
+    SDL_sem* start;
+    int index;
+} PoolWorker;
+
+struct WorkerPool {
+    int thread_count;
+    PoolWorker* workers;
+    SDL_sem* done;
+    SDL_atomic_t next_index;
+    int quit;
+
+    // Current job, written before the workers' `start` is posted
+    PoolTask task;
+    void* context;
+    int task_count;
+    int per_thread;
+};
+
+static void run_tasks(WorkerPool* pool) {
+    for (;;) {
+        int index = SDL_AtomicAdd(&pool->next_index, 1);
+        if (index >= pool->task_count) {
+            break;
+        }
+        pool->task(pool->context, index);
+    }
+}
+
+static int worker_main(void* data) {
+    PoolWorker* worker = data;
+    WorkerPool* pool = worker->pool;
+    spans_name_thread("chip8_worker");
+
+    for (;;) {
+        SDL_SemWait(worker->start);
+        if (pool->quit) {
+            break;
+        }
+        if (pool->per_thread) {
+            pool->task(pool->context, worker->index);
+        } else {
+            run_tasks(pool);
+        }
+        SDL_SemPost(pool->done);
+    }
+    return 0;
+}
+
+WorkerPool* pool_create(int threads) {
+    WorkerPool* pool = calloc(1, sizeof(WorkerPool));
+    if (!pool) {
+        return NULL;
+    }
+
+    pool->done = SDL_CreateSemaphore(0);
+    pool->workers = calloc(threads > 0 ? threads : 1, sizeof(PoolWorker));
+    if (!pool->done || !pool->workers) {
+        pool_destroy(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        PoolWorker* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i + 1;
+        worker->start = SDL_CreateSemaphore(0);
+        if (!worker->start) {
+            // Without it the worker could never be woken or stopped
+            printf("Worker semaphore creation failed: %s\n", SDL_GetError());
+            pool_destroy(pool);
+            return NULL;
+        }
+        worker->thread = SDL_CreateThread(worker_main, "chip8_worker", worker);
+        if (!worker->thread) {
+            printf("Worker thread creation failed: %s\n", SDL_GetError());
+            SDL_DestroySemaphore(worker->start);
+            break;
+        }
+        pool->thread_count++;
+    }
+    return pool;
+}
+
+void pool_destroy(WorkerPool* pool) {
+    if (!pool) {
+        return;
+    }
+
+    pool->quit = 1;
+    for (int i = 0; i < pool->thread_count; i++) {
+        SDL_SemPost(pool->workers[i].start);
+    }
+    for (int i = 0; i < pool->thread_count; i++) {
+        SDL_WaitThread(pool->workers[i].thread, NULL);
+        SDL_DestroySemaphore(pool->workers[i].start);
+    }
+
+    if (pool->done) {
+        SDL_DestroySemaphore(pool->done);
+    }
+    free(pool->workers);
+    free(pool);
+}
+
+void pool_run(WorkerPool* pool, int task_count, PoolTask task, void* context) {
+    pool->task = task;
+    pool->context = context;
+    pool->task_count = task_count;
+    SDL_AtomicSet(&pool->next_index, 0);
+
+    // Only wake as many workers as there is work for
+    int helpers = task_count - 1;
+    if (helpers > pool->thread_count) {
+        helpers = pool->thread_count;
+    }
+    for (int i = 0; i < helpers; i++) {
+        SDL_SemPost(pool->workers[i].start);
+    }
+
+    run_tasks(pool);
+
+    for (int i = 0; i < helpers; i++) {
+        SDL_SemWait(pool->done);
+    }
+}
+
+void pool_run_threads(WorkerPool* pool, PoolTask task, void* context) {
+    pool->task = task;
+    pool->context = context;
+    pool->per_thread = 1;
+    for (int i = 0; i < pool->thread_count; i++) {
+        SDL_SemPost(pool->workers[i].start);
+    }
+
+    task(context, 0);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        SDL_SemWait(pool->done);
+    }
+    pool->per_thread = 0;
+}
+
+int pool_size(const WorkerPool* pool) {
+    return pool->thread_count + 1;
+}
+
+// One worker per logical CPU, counting the caller
+int pool_default_threads(void) {
+    int cpus = SDL_GetCPUCount();
+    return cpus > 1 ? cpus - 1 : 0;
+}
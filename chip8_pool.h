@@ -0,0 +1,24 @@
+#ifndef CHIP8_POOL_H
+#define CHIP8_POOL_H
+
+// Fixed-size worker pool for data-parallel jobs. pool_run hands out task
+// indices from a shared counter, runs tasks on the calling thread too, and
+// returns once every task has finished. pool_run_threads instead runs one
+// task per thread with a fixed index, for work that must stay on the thread
+// that owns its memory.
+
+typedef struct WorkerPool WorkerPool;
+typedef void (*PoolTask)(void* context, int index);
+
+// `threads` is the number of extra threads; 0 runs everything on the caller
+WorkerPool* pool_create(int threads);
+void pool_destroy(WorkerPool* pool);
+void pool_run(WorkerPool* pool, int task_count, PoolTask task, void* context);
+// Runs `task` once on every thread: index 0 on the caller, 1..n on the
+// workers, always the same worker for the same index
+void pool_run_threads(WorkerPool* pool, PoolTask task, void* context);
+// Threads that run tasks, counting the caller
+int pool_size(const WorkerPool* pool);
+int pool_default_threads(void);
+
+#endif
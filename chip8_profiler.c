@@ -0,0 +1,301 @@
+#include "chip8_profiler.h"
+#include "chip8_opcodes.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROOT_NODE 0
+#define NO_NODE -1
+#define HEATMAP_COLUMNS 64
+
+// One node per distinct call path. Children are created after their parent,
+// so a node's index is always greater than its parent's.
+typedef struct {
+    uint16_t addr;
+    int32_t parent;
+    int32_t first_child;
+    int32_t next_sibling;
+    uint64_t calls;
+    uint64_t self_cycles;
+} ProfileNode;
+
+struct Chip8Profiler {
+    Chip8* cpu;
+
+    ProfileNode nodes[PROFILER_MAX_NODES];
+    int node_count;
+    int current;
+    int depth;
+    // Calls that could not be recorded (too deep or out of nodes), so their
+    // returns can be matched without unwinding a recorded frame
+    int lost_depth;
+
+    uint32_t reads[MEMORY_SIZE];
+    uint32_t writes[MEMORY_SIZE];
+    uint64_t total_cycles;
+};
+
+typedef struct {
+    uint16_t addr;
+    uint64_t calls;
+    uint64_t self_cycles;
+    uint64_t total_cycles;
+} RoutineStats;
+
+static void enter_subroutine(Chip8Profiler* profiler, uint16_t addr) {
+    if (profiler->lost_depth || profiler->depth >= PROFILER_MAX_DEPTH) {
+        profiler->lost_depth++;
+        return;
+    }
+
+    ProfileNode* parent = &profiler->nodes[profiler->current];
+    int child = parent->first_child;
+    while (child != NO_NODE && profiler->nodes[child].addr != addr) {
+        child = profiler->nodes[child].next_sibling;
+    }
+
+    if (child == NO_NODE) {
+        if (profiler->node_count == PROFILER_MAX_NODES) {
+            profiler->lost_depth++;
+            return;
+        }
+        child = profiler->node_count++;
+        ProfileNode* node = &profiler->nodes[child];
+        node->addr = addr;
+        node->parent = profiler->current;
+        node->first_child = NO_NODE;
+        node->next_sibling = parent->first_child;
+        parent->first_child = child;
+    }
+
+    profiler->nodes[child].calls++;
+    profiler->current = child;
+    profiler->depth++;
+}
+
+static void leave_subroutine(Chip8Profiler* profiler) {
+    if (profiler->lost_depth) {
+        profiler->lost_depth--;
+    } else if (profiler->current != ROOT_NODE) {
+        profiler->current = profiler->nodes[profiler->current].parent;
+        profiler->depth--;
+    }
+}
+
+static void count_access(uint32_t* counts, uint16_t addr, int len) {
+    for (int i = 0; i < len; i++) {
+        counts[(addr + i) & ADDR_MASK]++;
+    }
+}
+
+// Profiled replacement for profile->run. A call is charged to the caller and
+// a return to the callee.
+static int profiler_run(Chip8* cpu, int cycles) {
+    Chip8Profiler* profiler = cpu->hook_data;
+
+    for (int i = 0; i < cycles; i++) {
+        uint16_t pc = cpu->pc & ADDR_MASK;
+        uint16_t opcode = cpu->memory[pc] << 8 | cpu->memory[(pc + 1) & ADDR_MASK];
+
+        profiler->nodes[profiler->current].self_cycles++;
+
+        switch (opcode & 0xF000) {
+            case 0x0000:
+                if (opcode == 0x00EE) {
+                    leave_subroutine(profiler);
+                }
+                break;
+            case 0x2000:
+                enter_subroutine(profiler, opcode & 0x0FFF);
+                break;
+            case 0xD000:
+            case 0xF000: {
+                Chip8MemAccess access;
+                chip8_decode_mem_access(cpu, opcode, &access);
+                count_access(profiler->reads, access.read_addr, access.read_len);
+                count_access(profiler->writes, access.write_addr, access.write_len);
+                break;
+            }
+        }
+
+        cpu->pc += 2;
+        cpu->profile->step(cpu, opcode);
+    }
+
+    profiler->total_cycles += cycles;
+    return cycles;
+}
+
+Chip8Profiler* chip8_profiler_start(Chip8* cpu) {
+    if (cpu->run_hook) {
+        printf("Error: another tool is already attached to this instance\n");
+        return NULL;
+    }
+
+    Chip8Profiler* profiler = calloc(1, sizeof(Chip8Profiler));
+    if (!profiler) {
+        return NULL;
+    }
+
+    profiler->cpu = cpu;
+    profiler->node_count = 1;
+    profiler->current = ROOT_NODE;
+    profiler->nodes[ROOT_NODE].addr = cpu->pc & ADDR_MASK;
+    profiler->nodes[ROOT_NODE].parent = NO_NODE;
+    profiler->nodes[ROOT_NODE].first_child = NO_NODE;
+    profiler->nodes[ROOT_NODE].next_sibling = NO_NODE;
+
+    cpu->hook_data = profiler;
+    cpu->run_hook = profiler_run;
+    return profiler;
+}
+
+void chip8_profiler_stop(Chip8Profiler* profiler) {
+    if (!profiler) {
+        return;
+    }
+
+    profiler->cpu->run_hook = NULL;
+    profiler->cpu->hook_data = NULL;
+    free(profiler);
+}
+
+static void write_frame_name(FILE* file, const ProfileNode* node, bool root) {
+    if (root) {
+        fprintf(file, "rom");
+    } else {
+        fprintf(file, "sub_%03X", node->addr);
+    }
+}
+
+int chip8_profiler_write_folded(const Chip8Profiler* profiler, const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        printf("Error: Could not create profile file: %s\n", filename);
+        return 0;
+    }
+
+    int path[PROFILER_MAX_DEPTH + 1];
+    for (int n = 0; n < profiler->node_count; n++) {
+        const ProfileNode* node = &profiler->nodes[n];
+        if (!node->self_cycles) {
+            continue;
+        }
+
+        int depth = 0;
+        for (int p = n; p != NO_NODE; p = profiler->nodes[p].parent) {
+            path[depth++] = p;
+        }
+        for (int d = depth - 1; d >= 0; d--) {
+            write_frame_name(file, &profiler->nodes[path[d]], path[d] == ROOT_NODE);
+            fputc(d ? ';' : ' ', file);
+        }
+        fprintf(file, "%llu\n", (unsigned long long)node->self_cycles);
+    }
+
+    fclose(file);
+    return 1;
+}
+
+int chip8_profiler_write_heatmap(const Chip8Profiler* profiler, const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        printf("Error: Could not create heat map file: %s\n", filename);
+        return 0;
+    }
+
+    uint32_t hottest = 0;
+    fprintf(file, "# addr reads writes\n");
+    for (int addr = 0; addr < MEMORY_SIZE; addr++) {
+        uint32_t reads = profiler->reads[addr];
+        uint32_t writes = profiler->writes[addr];
+        if (reads || writes) {
+            fprintf(file, "%03X %u %u\n", addr, reads, writes);
+        }
+        if (reads + writes > hottest) {
+            hottest = reads + writes;
+        }
+    }
+
+    // Log-scaled overview, one row per 64 bytes
+    static const char ramp[] = " .:-=+*#%@";
+    int top = (int)sizeof(ramp) - 2;
+    double scale = hottest > 1 ? (top - 1) / log((double)hottest) : 0;
+
+    fprintf(file, "#\n# overview (reads + writes, log scale)\n");
+    for (int row = 0; row < MEMORY_SIZE; row += HEATMAP_COLUMNS) {
+        fprintf(file, "# %03X |", row);
+        for (int col = 0; col < HEATMAP_COLUMNS; col++) {
+            uint32_t count = profiler->reads[row + col] + profiler->writes[row + col];
+            int level = count ? 1 + (int)(log((double)count) * scale) : 0;
+            fputc(ramp[level > top ? top : level], file);
+        }
+        fprintf(file, "|\n");
+    }
+
+    fclose(file);
+    return 1;
+}
+
+static int compare_routines(const void* a, const void* b) {
+    const RoutineStats* ra = a;
+    const RoutineStats* rb = b;
+    return (ra->total_cycles < rb->total_cycles) - (ra->total_cycles > rb->total_cycles);
+}
+
+void chip8_profiler_print_summary(const Chip8Profiler* profiler, int count) {
+    int node_count = profiler->node_count;
+    uint64_t* inclusive = malloc(node_count * sizeof(uint64_t));
+    RoutineStats* routines = calloc(MEMORY_SIZE, sizeof(RoutineStats));
+    if (!inclusive || !routines) {
+        free(inclusive);
+        free(routines);
+        return;
+    }
+
+    // Children always follow their parent, so one backwards pass sums subtrees
+    for (int n = 0; n < node_count; n++) {
+        inclusive[n] = profiler->nodes[n].self_cycles;
+    }
+    for (int n = node_count - 1; n > ROOT_NODE; n--) {
+        inclusive[profiler->nodes[n].parent] += inclusive[n];
+    }
+
+    for (int n = ROOT_NODE + 1; n < node_count; n++) {
+        const ProfileNode* node = &profiler->nodes[n];
+        RoutineStats* routine = &routines[node->addr];
+        routine->addr = node->addr;
+        routine->calls += node->calls;
+        routine->self_cycles += node->self_cycles;
+
+        // Recursive paths are already counted by the outermost frame
+        bool recursive = false;
+        for (int p = node->parent; p > ROOT_NODE; p = profiler->nodes[p].parent) {
+            if (profiler->nodes[p].addr == node->addr) {
+                recursive = true;
+                break;
+            }
+        }
+        if (!recursive) {
+            routine->total_cycles += inclusive[n];
+        }
+    }
+
+    qsort(routines, MEMORY_SIZE, sizeof(RoutineStats), compare_routines);
+
+    uint64_t total = profiler->total_cycles ? profiler->total_cycles : 1;
+    printf("Profiled %llu cycles, %d call paths\n", (unsigned long long)profiler->total_cycles,
+           node_count);
+    printf("  %-8s %10s %14s %7s %14s %7s\n", "routine", "calls", "total", "%", "self", "%");
+    for (int i = 0; i < count && i < MEMORY_SIZE && routines[i].total_cycles; i++) {
+        const RoutineStats* routine = &routines[i];
+        printf("  sub_%03X  %10llu %14llu %6.1f%% %14llu %6.1f%%\n", routine->addr,
+               (unsigned long long)routine->calls, (unsigned long long)routine->total_cycles,
+               100.0 * routine->total_cycles / total, (unsigned long long)routine->self_cycles,
+               100.0 * routine->self_cycles / total);
+    }
+
+    free(inclusive);
+    free(routines);
+}
@@ -0,0 +1,31 @@
+#ifndef CHIP8_PROFILER_H
+#define CHIP8_PROFILER_H
+
+#include "chip8_cpu.h"
+
+// Guest-level profiler
+//
+// Follows 2nnn/00EE to keep a shadow call stack and charges every executed
+// instruction to the current call path, so time is attributed to guest
+// subroutines rather than to the host interpreter. Reads and writes made by
+// Dxyn, Fx33, Fx55 and Fx65 are counted per address.
+
+#define PROFILER_MAX_NODES 4096
+#define PROFILER_MAX_DEPTH 64
+
+typedef struct Chip8Profiler Chip8Profiler;
+
+// Starts profiling `cpu`. Fails if another tool is already attached.
+Chip8Profiler* chip8_profiler_start(Chip8* cpu);
+void chip8_profiler_stop(Chip8Profiler* profiler);
+
+// Collapsed stacks ("rom;sub_2A4;sub_31C 1234" per line) for flamegraph.pl,
+// speedscope and similar tools
+int chip8_profiler_write_folded(const Chip8Profiler* profiler, const char* filename);
+// One "addr reads writes" line per touched address, followed by an overview
+// map of the whole address space
+int chip8_profiler_write_heatmap(const Chip8Profiler* profiler, const char* filename);
+// Prints the `count` routines with the most inclusive cycles
+void chip8_profiler_print_summary(const Chip8Profiler* profiler, int count);
+
+#endif
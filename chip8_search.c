@@ -0,0 +1,277 @@
+#include "chip8_search.h"
+#include "chip8_hash.h"
+#include "chip8_pool.h"
+#include <SDL2/SDL.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NOT_FOUND -1
+#define EMPTY_SLOT 0
+// Left by visited_remove so probe chains through the slot stay intact;
+// visited_insert reuses it
+#define REMOVED_SLOT UINT64_MAX
+
+// How each frontier state was reached: its parent in the previous level and
+// the input that was held
+typedef struct {
+    int32_t parent;
+    uint16_t input;
+} SearchLink;
+
+typedef struct {
+    const SearchConfig* config;
+
+    Chip8* frontier;
+    int frontier_count;
+    Chip8* next;
+    atomic_int next_count;
+    SearchLink* links;
+
+    // Lock-free visited set: open addressing with linear probing, slots
+    // claimed by compare-and-swap. SDL only has 32-bit CAS, hence C11 atomics.
+    _Atomic uint64_t* visited;
+    uint64_t visited_mask;
+
+    atomic_int found;
+    _Atomic uint64_t duplicates;
+    _Atomic uint64_t dropped;
+} SearchContext;
+
+typedef enum {
+    INSERT_NEW,
+    INSERT_SEEN,
+    INSERT_FULL
+} InsertResult;
+
+// Hashes that collide with the marker values are nudged off them
+static uint64_t visited_key(uint64_t hash) {
+    if (hash == EMPTY_SLOT) {
+        return 1;
+    }
+    return hash == REMOVED_SLOT ? REMOVED_SLOT - 1 : hash;
+}
+
+static InsertResult visited_insert(SearchContext* context, uint64_t hash) {
+    hash = visited_key(hash);
+    // Starts over only when another worker takes the tombstone first
+    for (;;) {
+        _Atomic uint64_t* removed = NULL;
+        uint64_t index = (hash >> 17) & context->visited_mask;
+        for (uint64_t probe = 0; probe <= context->visited_mask; probe++) {
+            _Atomic uint64_t* slot = &context->visited[index];
+            uint64_t current = atomic_load_explicit(slot, memory_order_relaxed);
+            if (current == EMPTY_SLOT) {
+                if (removed) {
+                    break;
+                }
+                uint64_t expected = EMPTY_SLOT;
+                if (atomic_compare_exchange_strong(slot, &expected, hash)) {
+                    return INSERT_NEW;
+                }
+                current = expected;
+            }
+            if (current == hash) {
+                return INSERT_SEEN;
+            }
+            if (current == REMOVED_SLOT && !removed) {
+                removed = slot;
+            }
+            index = (index + 1) & context->visited_mask;
+        }
+        if (!removed) {
+            return INSERT_FULL;
+        }
+
+        // The key is not on its chain, so it takes the first tombstone. A
+        // remove racing with two inserts of one key can let it in twice,
+        // which only costs a repeated expansion.
+        uint64_t expected = REMOVED_SLOT;
+        if (atomic_compare_exchange_strong(removed, &expected, hash)) {
+            return INSERT_NEW;
+        }
+        if (expected == hash) {
+            return INSERT_SEEN;
+        }
+    }
+}
+
+// Forgets a state that was inserted but could not be kept, so another path
+// can still reach it
+static void visited_remove(SearchContext* context, uint64_t hash) {
+    hash = visited_key(hash);
+    uint64_t index = (hash >> 17) & context->visited_mask;
+    for (uint64_t probe = 0; probe <= context->visited_mask; probe++) {
+        _Atomic uint64_t* slot = &context->visited[index];
+        uint64_t current = atomic_load_explicit(slot, memory_order_relaxed);
+        if (current == EMPTY_SLOT) {
+            return;
+        }
+        if (current == hash) {
+            atomic_store(slot, REMOVED_SLOT);
+            return;
+        }
+        index = (index + 1) & context->visited_mask;
+    }
+}
+
+static void expand_task(void* data, int index) {
+    SearchContext* context = data;
+    const SearchConfig* config = context->config;
+    if (atomic_load_explicit(&context->found, memory_order_relaxed) != NOT_FOUND) {
+        return;
+    }
+
+    int parent = index / config->input_count;
+    uint16_t input = config->inputs[index % config->input_count];
+
+    // A full next level keeps nothing, so do not mark what it drops as seen
+    if (atomic_load_explicit(&context->next_count, memory_order_relaxed) >= config->max_frontier) {
+        atomic_fetch_add(&context->dropped, 1);
+        return;
+    }
+
+    Chip8 cpu = context->frontier[parent];
+    chip8_set_keypad_mask(&cpu, input);
+    for (int f = 0; f < config->frames_per_step; f++) {
+        chip8_run_frame(&cpu);
+    }
+
+    uint64_t hash = config->full_hash ? chip8_hash_full(&cpu) : chip8_hash(&cpu);
+    InsertResult inserted = visited_insert(context, hash);
+    if (inserted != INSERT_NEW) {
+        atomic_fetch_add(inserted == INSERT_SEEN ? &context->duplicates : &context->dropped, 1);
+        return;
+    }
+
+    int slot = atomic_fetch_add(&context->next_count, 1);
+    if (slot >= config->max_frontier) {
+        // Filled up by other workers since the check above
+        visited_remove(context, hash);
+        atomic_fetch_add(&context->dropped, 1);
+        return;
+    }
+    context->next[slot] = cpu;
+    context->links[slot].parent = parent;
+    context->links[slot].input = input;
+
+    if (config->goal && config->goal(&cpu, config->goal_context)) {
+        int expected = NOT_FOUND;
+        atomic_compare_exchange_strong(&context->found, &expected, slot);
+    }
+}
+
+void chip8_search_default_config(SearchConfig* config) {
+    static const uint16_t single_keys[KEY_COUNT + 1] = {
+        0x0000, 0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+        0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, 0x8000
+    };
+
+    memset(config, 0, sizeof(SearchConfig));
+    config->threads = pool_default_threads();
+    config->max_depth = 32;
+    config->frames_per_step = 4;
+    config->inputs = single_keys;
+    config->input_count = KEY_COUNT + 1;
+    config->max_frontier = 8192;
+    config->visited_bits = 22;
+}
+
+bool chip8_search_run(const Chip8* start, const SearchConfig* config, SearchResult* result) {
+    memset(result, 0, sizeof(SearchResult));
+    if (config->max_depth < 1 || config->max_depth > SEARCH_MAX_DEPTH || config->input_count < 1 ||
+        config->max_frontier < 1 || config->visited_bits < 8 || config->visited_bits > 32) {
+        printf("Error: invalid search configuration\n");
+        return false;
+    }
+
+    SearchContext context;
+    memset(&context, 0, sizeof(context));
+    context.config = config;
+    context.visited_mask = (1ull << config->visited_bits) - 1;
+    context.visited = calloc(context.visited_mask + 1, sizeof(uint64_t));
+    context.frontier = chip8_alloc(config->max_frontier * sizeof(Chip8));
+    context.next = chip8_alloc(config->max_frontier * sizeof(Chip8));
+    SearchLink* levels = malloc((size_t)config->max_depth * config->max_frontier * sizeof(SearchLink));
+    WorkerPool* pool = pool_create(config->threads);
+
+    bool ok = context.visited && context.frontier && context.next && levels && pool;
+    if (ok) {
+        context.frontier[0] = *start;
+        if (config->full_hash) {
+            chip8_hash_detach(&context.frontier[0]);
+            ok = !context.frontier[0].run_hook;
+        } else {
+            ok = chip8_hash_attach(&context.frontier[0]);
+        }
+        if (!ok) {
+            printf("Error: another tool is already attached to this instance\n");
+        }
+    }
+    if (!ok) {
+        free(context.visited);
+        chip8_free(context.frontier);
+        chip8_free(context.next);
+        free(levels);
+        pool_destroy(pool);
+        return false;
+    }
+
+    Uint64 begin = SDL_GetPerformanceCounter();
+    visited_insert(&context, chip8_hash(&context.frontier[0]));
+    context.frontier_count = 1;
+    result->unique = 1;
+    atomic_init(&context.found, NOT_FOUND);
+
+    if (config->goal && config->goal(start, config->goal_context)) {
+        result->found = true;
+    }
+
+    int depth = 0;
+    while (!result->found && depth < config->max_depth && context.frontier_count > 0) {
+        context.links = levels + (size_t)depth * config->max_frontier;
+        atomic_store(&context.next_count, 0);
+
+        int tasks = context.frontier_count * config->input_count;
+        pool_run(pool, tasks, expand_task, &context);
+        result->expanded += tasks;
+
+        int count = atomic_load(&context.next_count);
+        if (count > config->max_frontier) {
+            count = config->max_frontier;
+        }
+        Chip8* swap = context.frontier;
+        context.frontier = context.next;
+        context.next = swap;
+        context.frontier_count = count;
+        result->unique += count;
+        depth++;
+
+        int found = atomic_load(&context.found);
+        if (found != NOT_FOUND) {
+            // Walk the links back to the start to recover the inputs
+            result->found = true;
+            result->depth = depth;
+            for (int d = depth - 1; d >= 0; d--) {
+                const SearchLink* link = &levels[(size_t)d * config->max_frontier + found];
+                result->path[d] = link->input;
+                found = link->parent;
+            }
+        }
+    }
+    if (!result->found) {
+        result->depth = depth;
+    }
+
+    result->duplicates = atomic_load(&context.duplicates);
+    result->dropped = atomic_load(&context.dropped);
+    result->seconds = (double)(SDL_GetPerformanceCounter() - begin) / SDL_GetPerformanceFrequency();
+
+    free(context.visited);
+    chip8_free(context.frontier);
+    chip8_free(context.next);
+    free(levels);
+    pool_destroy(pool);
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef CHIP8_SEARCH_H
+#define CHIP8_SEARCH_H
+
+#include "chip8_cpu.h"
+
+// Breadth-first search over keypad input sequences
+//
+// Each level expands every frontier state with every candidate keypad mask,
+// holding it for a fixed number of frames. Expansion runs on a worker pool;
+// states are deduplicated by their incremental hash in a lock-free open
+// addressing set, so only states never seen before join the next frontier.
+
+#define SEARCH_MAX_DEPTH 256
+
+// Returns true when `cpu` is a state the search is looking for
+typedef bool (*SearchGoal)(const Chip8* cpu, void* context);
+
+typedef struct {
+    int threads;              // extra worker threads
+    int max_depth;            // input steps, at most SEARCH_MAX_DEPTH
+    int frames_per_step;      // frames each input mask is held
+    const uint16_t* inputs;   // keypad masks to try at every step
+    int input_count;
+    int max_frontier;         // states kept per level; extra new states are dropped
+    int visited_bits;         // visited set holds 2^visited_bits hashes
+    SearchGoal goal;          // NULL to explore until the depth or frontier runs out
+    void* goal_context;
+    bool full_hash;           // rehash every state from scratch (for comparison)
+} SearchConfig;
+
+typedef struct {
+    bool found;
+    int depth;
+    uint16_t path[SEARCH_MAX_DEPTH];
+    uint64_t expanded;
+    uint64_t unique;
+    uint64_t duplicates;
+    uint64_t dropped;
+    double seconds;
+} SearchResult;
+
+void chip8_search_default_config(SearchConfig* config);
+// Searches from `start`. Returns false if the search could not be set up.
+bool chip8_search_run(const Chip8* start, const SearchConfig* config, SearchResult* result);
+
+#endif
@@ -0,0 +1,206 @@
+#include "chip8_shm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct Chip8Shm {
+    Chip8SharedState* state;
+    bool owner;
+    char name[SHM_NAME_SIZE];
+    // Last key mask seen from other processes
+    uint16_t keys;
+    Uint64 next_publish;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+};
+
+// "pong" becomes Local\chip8_pong on Windows and /chip8_pong elsewhere
+static void segment_name(char* out, const char* name) {
+#ifdef _WIN32
+    snprintf(out, SHM_NAME_SIZE, "Local\\chip8_%s", name);
+#else
+    snprintf(out, SHM_NAME_SIZE, "/chip8_%s", name);
+#endif
+}
+
+static Chip8Shm* map_segment(const char* name, bool create) {
+    Chip8Shm* shm = calloc(1, sizeof(Chip8Shm));
+    if (!shm) {
+        return NULL;
+    }
+    segment_name(shm->name, name);
+    shm->owner = create;
+    size_t size = sizeof(Chip8SharedState);
+    bool in_use = false;
+
+#ifdef _WIN32
+    if (create) {
+        shm->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, shm->name);
+        // Hands back another publisher's live mapping instead of failing
+        if (shm->mapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+            CloseHandle(shm->mapping);
+            shm->mapping = NULL;
+            in_use = true;
+        }
+    } else {
+        shm->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, shm->name);
+    }
+    if (shm->mapping) {
+        shm->state = MapViewOfFile(shm->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (!shm->state) {
+            CloseHandle(shm->mapping);
+        }
+    }
+#else
+    // Exclusive, so a second publisher cannot attach to and wipe a live segment
+    int fd = shm_open(shm->name, create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR, 0600);
+    in_use = create && fd < 0 && errno == EEXIST;
+    struct stat info;
+    if (fd >= 0 && (create ? ftruncate(fd, size) == 0 : fstat(fd, &info) == 0 && (size_t)info.st_size >= size)) {
+        void* view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        shm->state = (view == MAP_FAILED) ? NULL : view;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!shm->state && create && fd >= 0) {
+        shm_unlink(shm->name);
+    }
+#endif
+
+    if (in_use) {
+        printf("Error: Shared memory %s is already in use; another emulator may be publishing under that name\n", shm->name);
+        free(shm);
+        return NULL;
+    }
+    if (!shm->state) {
+        printf("Error: Could not %s shared memory %s\n", create ? "create" : "open", shm->name);
+        free(shm);
+        return NULL;
+    }
+    return shm;
+}
+
+Chip8Shm* chip8_shm_create(const char* name) {
+    Chip8Shm* shm = map_segment(name, true);
+    if (!shm) {
+        return NULL;
+    }
+
+    Chip8SharedState* state = shm->state;
+    memset(state, 0, sizeof(Chip8SharedState));
+    state->magic = SHM_MAGIC;
+    state->version = SHM_VERSION;
+    state->size = sizeof(Chip8SharedState);
+    printf("Publishing state to shared memory %s\n", shm->name);
+    return shm;
+}
+
+void chip8_shm_apply_input(Chip8Shm* shm, Chip8* cpu) {
+    uint16_t keys = (uint16_t)SDL_AtomicGet(&shm->state->keys);
+    uint16_t changed = keys ^ shm->keys;
+    for (int key = 0; changed; key++, changed >>= 1) {
+        if (changed & 1) {
+            chip8_queue_key(cpu, (uint8_t)key, (keys >> key) & 1);
+        }
+    }
+    shm->keys = keys;
+}
+
+void chip8_shm_publish(Chip8Shm* shm, const Chip8* cpu, bool force) {
+    Chip8SharedState* state = shm->state;
+    Chip8SharedFrame* frame = &state->state;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (!force && now < shm->next_publish) {
+        return;
+    }
+    shm->next_publish = now + SDL_GetPerformanceFrequency() * SHM_MIN_PERIOD_US / 1000000;
+
+    // Only this thread writes the sequence, so a plain read is current
+    int sequence = SDL_AtomicGet(&state->sequence);
+    SDL_AtomicSet(&state->sequence, sequence + 1);
+
+    frame->frame = cpu->sched.frame_count;
+    frame->cycles = cpu->cycles;
+    frame->pc = cpu->pc;
+    frame->I = cpu->I;
+    memcpy(frame->stack, cpu->stack, sizeof(frame->stack));
+    frame->keypad = chip8_keypad_mask(cpu);
+    memcpy(frame->V, cpu->V, sizeof(frame->V));
+    frame->delay_timer = cpu->delay_timer;
+    frame->sound_timer = cpu->sound_timer;
+    frame->sp = cpu->sp;
+    memcpy(frame->screen, cpu->screen, sizeof(frame->screen));
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&state->sequence, sequence + 2);
+}
+
+Chip8Shm* chip8_shm_open(const char* name) {
+    Chip8Shm* shm = map_segment(name, false);
+    if (!shm) {
+        return NULL;
+    }
+
+    if (shm->state->magic != SHM_MAGIC || shm->state->version != SHM_VERSION ||
+        shm->state->size != sizeof(Chip8SharedState)) {
+        printf("Error: %s is not a compatible CHIP-8 segment\n", shm->name);
+        chip8_shm_close(shm);
+        return NULL;
+    }
+    return shm;
+}
+
+const Chip8SharedState* chip8_shm_view(const Chip8Shm* shm) {
+    return shm->state;
+}
+
+bool chip8_shm_read(const Chip8Shm* shm, Chip8SharedFrame* frame) {
+    Chip8SharedState* state = shm->state;
+
+    for (int attempt = 0; attempt < SHM_READ_ATTEMPTS; attempt++) {
+        int before = SDL_AtomicGet(&state->sequence);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(frame, &state->state, sizeof(Chip8SharedFrame));
+        SDL_MemoryBarrierAcquire();
+        if (SDL_AtomicGet(&state->sequence) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void chip8_shm_set_keys(Chip8Shm* shm, uint16_t mask) {
+    SDL_AtomicSet(&shm->state->keys, mask);
+}
+
+void chip8_shm_close(Chip8Shm* shm) {
+    if (!shm) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(shm->state);
+    CloseHandle(shm->mapping);
+#else
+    munmap(shm->state, sizeof(Chip8SharedState));
+    if (shm->owner) {
+        shm_unlink(shm->name);
+    }
+#endif
+    free(shm);
+}
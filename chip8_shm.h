@@ -0,0 +1,79 @@
+#ifndef CHIP8_SHM_H
+#define CHIP8_SHM_H
+
+#include "chip8_cpu.h"
+#include <SDL2/SDL.h>
+
+// Live machine state published to other processes through shared memory
+//
+// The emulator owns a named segment (a file mapping on Windows, shm_open
+// elsewhere) and copies the framebuffer and registers into it at the end of
+// each frame under a seqlock: `sequence` is odd while an update is in progress
+// and advances by two per frame. Readers map the same segment, copy the
+// frame block and retry if the sequence was odd or moved, so the emulator
+// never waits on them and a reader never waits on the emulator longer
+// than SHM_READ_ATTEMPTS copies.
+//
+// `keys` goes the other way: any process may set or clear bits (bit n =
+// CHIP-8 key n) and the emulator queues a key event for each bit that
+// changed since the last frame, so keyboard input keeps working alongside.
+//
+// Every field has a fixed size and offset so non-C readers can map it.
+
+#define SHM_MAGIC 0x4D533843 // "C8SM"
+#define SHM_VERSION 1
+#define SHM_NAME_SIZE 64
+#define SHM_READ_ATTEMPTS 4
+// Faster-than-real-time runs publish at most this often, or a reader's copy
+// would keep being overwritten
+#define SHM_MIN_PERIOD_US 250
+
+typedef struct {
+    uint64_t frame;
+    uint64_t cycles;
+    uint16_t pc;
+    uint16_t I;
+    uint16_t stack[STACK_SIZE];
+    uint16_t keypad;
+    uint8_t V[REGISTER_COUNT];
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t sp;
+    uint8_t reserved;
+    uint8_t screen[SCREEN_WIDTH][SCREEN_HEIGHT];
+} Chip8SharedFrame;
+
+typedef struct {
+    // Written once when the segment is created
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t reserved;
+
+    SDL_atomic_t sequence;
+    SDL_atomic_t keys;
+
+    Chip8SharedFrame state;
+} Chip8SharedState;
+
+typedef struct Chip8Shm Chip8Shm;
+
+// Emulator side
+Chip8Shm* chip8_shm_create(const char* name);
+// Queues key changes written by other processes; call before running a frame
+void chip8_shm_apply_input(Chip8Shm* shm, Chip8* cpu);
+// Publishes the state at the end of a frame, rate limited unless `force`
+void chip8_shm_publish(Chip8Shm* shm, const Chip8* cpu, bool force);
+
+// Reader side
+Chip8Shm* chip8_shm_open(const char* name);
+// Zero-copy view of the segment
+const Chip8SharedState* chip8_shm_view(const Chip8Shm* shm);
+// Copies a consistent frame; false if the emulator kept it busy
+bool chip8_shm_read(const Chip8Shm* shm, Chip8SharedFrame* frame);
+void chip8_shm_set_keys(Chip8Shm* shm, uint16_t mask);
+
+// Unmaps; the creator also removes the segment
+void chip8_shm_close(Chip8Shm* shm);
+
+#endif
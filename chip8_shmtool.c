@@ -0,0 +1,122 @@
+#define SDL_MAIN_HANDLED
+#include "chip8_shm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_INTERVAL_MS 1000
+
+// Only for linking the core; this tool never runs it
+void platform_beep(void) {
+}
+
+static bool read_frame(const Chip8Shm* shm, Chip8SharedFrame* frame) {
+    // A busy emulator only ever holds the seqlock for one copy, so a few
+    // short backoffs are enough
+    for (int i = 0; i < SHM_READ_ATTEMPTS; i++) {
+        if (chip8_shm_read(shm, frame)) {
+            return true;
+        }
+        SDL_Delay(1);
+    }
+    printf("Error: no consistent frame could be read\n");
+    return false;
+}
+
+static void print_registers(const Chip8SharedFrame* frame) {
+    printf("Frame %llu, cycle %llu\n", (unsigned long long)frame->frame,
+           (unsigned long long)frame->cycles);
+    printf("PC=%03X I=%03X SP=%X DT=%02X ST=%02X keys=%04X\n", frame->pc, frame->I, frame->sp,
+           frame->delay_timer, frame->sound_timer, frame->keypad);
+    for (int i = 0; i < REGISTER_COUNT; i++) {
+        printf("V%X=%02X%c", i, frame->V[i], (i % 8 == 7) ? '\n' : ' ');
+    }
+}
+
+static int cmd_status(const char* name) {
+    Chip8Shm* shm = chip8_shm_open(name);
+    if (!shm) {
+        return 1;
+    }
+
+    Chip8SharedFrame frame;
+    bool ok = read_frame(shm, &frame);
+    if (ok) {
+        print_registers(&frame);
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            for (int x = 0; x < SCREEN_WIDTH; x++) {
+                putchar(frame.screen[x][y] ? '#' : '.');
+            }
+            putchar('\n');
+        }
+    }
+    chip8_shm_close(shm);
+    return ok ? 0 : 1;
+}
+
+// One line per interval until the segment stops advancing
+static int cmd_watch(const char* name, int interval_ms) {
+    Chip8Shm* shm = chip8_shm_open(name);
+    if (!shm) {
+        return 1;
+    }
+
+    Chip8SharedFrame frame;
+    uint64_t last_frame = 0;
+    bool first = true;
+    while (read_frame(shm, &frame)) {
+        if (!first && frame.frame == last_frame) {
+            printf("Instance stopped at frame %llu\n", (unsigned long long)frame.frame);
+            break;
+        }
+        printf("frame %8llu  %5.1f fps  PC=%03X I=%03X DT=%02X ST=%02X keys=%04X\n",
+               (unsigned long long)frame.frame,
+               first ? 0.0 : (double)(frame.frame - last_frame) * 1000.0 / interval_ms, frame.pc,
+               frame.I, frame.delay_timer, frame.sound_timer, frame.keypad);
+        fflush(stdout);
+        last_frame = frame.frame;
+        first = false;
+        SDL_Delay(interval_ms);
+    }
+    chip8_shm_close(shm);
+    return 0;
+}
+
+static int cmd_keys(const char* name, uint16_t mask) {
+    Chip8Shm* shm = chip8_shm_open(name);
+    if (!shm) {
+        return 1;
+    }
+    chip8_shm_set_keys(shm, mask);
+    chip8_shm_close(shm);
+    return 0;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage:\n");
+    printf("  %s status <name>             registers and screen\n", program);
+    printf("  %s watch <name> [ms]         one line per interval\n", program);
+    printf("  %s keys <name> <hex mask>    hold keys (0 releases all)\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char* command = argv[1];
+    if (strcmp(command, "status") == 0) {
+        return cmd_status(argv[2]);
+    }
+    if (strcmp(command, "watch") == 0) {
+        int interval = (argc >= 4) ? atoi(argv[3]) : DEFAULT_INTERVAL_MS;
+        return cmd_watch(argv[2], interval > 0 ? interval : DEFAULT_INTERVAL_MS);
+    }
+    if (strcmp(command, "keys") == 0 && argc >= 4) {
+        return cmd_keys(argv[2], (uint16_t)strtol(argv[3], NULL, 16));
+    }
+
+    print_usage(argv[0]);
+    return 1;
+}
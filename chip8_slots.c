@@ -0,0 +1,250 @@
+#include "chip8_slots.h"
+#include "chip8_log.h"
+#include "chip8_opcodes.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char* filename;
+    // Freshly initialised machine with the ROM in it, NULL if loading failed
+    Chip8* cpu;
+} SlotLoad;
+
+struct Chip8Slots {
+    Chip8* live;
+    int active;
+    // Suspended state of each occupied slot; stale for the active one,
+    // whose state is in `live`
+    Chip8* saved[SLOT_COUNT];
+    char names[SLOT_COUNT][SLOT_NAME_SIZE];
+    uint64_t last_used[SLOT_COUNT];
+    uint64_t use_clock;
+
+    // Requests and results, guarded by `lock`. `queued` counts every ROM
+    // from slots_load until slots_poll installs it.
+    SDL_Thread* loader;
+    SDL_mutex* lock;
+    SDL_cond* work;
+    bool quit;
+    char* requests[SLOT_QUEUE];
+    int request_count;
+    SlotLoad results[SLOT_QUEUE];
+    int result_count;
+    int queued;
+    Uint32 wake_event;
+};
+
+// Reads a ROM into a fresh machine, NULL if it cannot be loaded
+static Chip8* load_rom(const char* filename) {
+    Chip8* cpu = chip8_alloc(sizeof(Chip8));
+    if (!cpu) {
+        return NULL;
+    }
+    chip8_init(cpu);
+    if (!chip8_load_rom(cpu, filename)) {
+        chip8_free(cpu);
+        return NULL;
+    }
+    return cpu;
+}
+
+static int loader_main(void* context) {
+    Chip8Slots* slots = context;
+
+    SDL_LockMutex(slots->lock);
+    for (;;) {
+        while (!slots->quit && slots->request_count == 0) {
+            SDL_CondWait(slots->work, slots->lock);
+        }
+        if (slots->quit) {
+            break;
+        }
+
+        char* filename = slots->requests[0];
+        slots->request_count--;
+        memmove(slots->requests, slots->requests + 1, slots->request_count * sizeof(char*));
+        SDL_UnlockMutex(slots->lock);
+
+        Chip8* cpu = load_rom(filename);
+
+        SDL_LockMutex(slots->lock);
+        slots->results[slots->result_count].filename = filename;
+        slots->results[slots->result_count].cpu = cpu;
+        slots->result_count++;
+
+        SDL_Event event;
+        memset(&event, 0, sizeof(event));
+        event.type = slots->wake_event;
+        SDL_PushEvent(&event);
+    }
+    SDL_UnlockMutex(slots->lock);
+    return 0;
+}
+
+Chip8Slots* slots_create(Chip8* live) {
+    Chip8Slots* slots = calloc(1, sizeof(Chip8Slots));
+    if (!slots) {
+        return NULL;
+    }
+
+    slots->live = live;
+    slots->active = -1;
+    slots->wake_event = SDL_RegisterEvents(1);
+    slots->lock = SDL_CreateMutex();
+    slots->work = SDL_CreateCond();
+    if (slots->lock && slots->work) {
+        slots->loader = SDL_CreateThread(loader_main, "chip8_loader", slots);
+    }
+    if (!slots->loader) {
+        log_printf(LOG_ERROR, 0, "Could not start the ROM loader: %s", SDL_GetError());
+        slots_destroy(slots);
+        return NULL;
+    }
+    return slots;
+}
+
+void slots_destroy(Chip8Slots* slots) {
+    if (!slots) {
+        return;
+    }
+
+    if (slots->loader) {
+        SDL_LockMutex(slots->lock);
+        slots->quit = true;
+        SDL_CondSignal(slots->work);
+        SDL_UnlockMutex(slots->lock);
+        SDL_WaitThread(slots->loader, NULL);
+    }
+    for (int i = 0; i < slots->request_count; i++) {
+        free(slots->requests[i]);
+    }
+    for (int i = 0; i < slots->result_count; i++) {
+        free(slots->results[i].filename);
+        chip8_free(slots->results[i].cpu);
+    }
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        chip8_free(slots->saved[i]);
+    }
+    if (slots->work) {
+        SDL_DestroyCond(slots->work);
+    }
+    if (slots->lock) {
+        SDL_DestroyMutex(slots->lock);
+    }
+    free(slots);
+}
+
+static void set_name(Chip8Slots* slots, int index, const char* filename) {
+    const char* name = filename;
+    for (const char* c = filename; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
+        }
+    }
+    snprintf(slots->names[index], SLOT_NAME_SIZE, "%s", name);
+}
+
+void slots_adopt(Chip8Slots* slots, const char* filename) {
+    Chip8* saved = chip8_alloc(sizeof(Chip8));
+    if (!saved) {
+        return;
+    }
+    slots->saved[0] = saved;
+    slots->active = 0;
+    slots->last_used[0] = ++slots->use_clock;
+    set_name(slots, 0, filename);
+}
+
+bool slots_load(Chip8Slots* slots, const char* filename) {
+    char* copy = malloc(strlen(filename) + 1);
+    if (!copy) {
+        return false;
+    }
+    strcpy(copy, filename);
+
+    SDL_LockMutex(slots->lock);
+    bool queued = slots->queued < SLOT_QUEUE;
+    if (queued) {
+        slots->requests[slots->request_count++] = copy;
+        slots->queued++;
+        SDL_CondSignal(slots->work);
+    }
+    SDL_UnlockMutex(slots->lock);
+
+    if (!queued) {
+        log_printf(LOG_WARN, 0, "Too many ROMs loading, dropped %s", filename);
+        free(copy);
+    }
+    return queued;
+}
+
+// Empty slot, or else the least recently used one that is not active
+static int pick_slot(const Chip8Slots* slots) {
+    int oldest = -1;
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        if (!slots->saved[i]) {
+            return i;
+        }
+        if (i != slots->active && (oldest < 0 || slots->last_used[i] < slots->last_used[oldest])) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+bool slots_poll(Chip8Slots* slots) {
+    SlotLoad results[SLOT_QUEUE];
+
+    SDL_LockMutex(slots->lock);
+    int count = slots->result_count;
+    memcpy(results, slots->results, count * sizeof(SlotLoad));
+    slots->result_count = 0;
+    slots->queued -= count;
+    SDL_UnlockMutex(slots->lock);
+
+    int installed = -1;
+    for (int i = 0; i < count; i++) {
+        if (results[i].cpu) {
+            int slot = pick_slot(slots);
+            chip8_free(slots->saved[slot]);
+            slots->saved[slot] = results[i].cpu;
+            slots->last_used[slot] = ++slots->use_clock;
+            set_name(slots, slot, results[i].filename);
+            installed = slot;
+        }
+        free(results[i].filename);
+    }
+    return installed >= 0 && slots_switch(slots, installed);
+}
+
+bool slots_switch(Chip8Slots* slots, int index) {
+    if (index < 0 || index >= SLOT_COUNT || !slots->saved[index] || index == slots->active) {
+        return false;
+    }
+
+    // The live machine keeps its tool hooks and log stream across the swap
+    if (slots->active >= 0) {
+        chip8_save_state(slots->live, slots->saved[slots->active]);
+    }
+    chip8_load_state(slots->live, slots->saved[index]);
+    slots->active = index;
+    slots->last_used[index] = ++slots->use_clock;
+    log_printf(LOG_INFO, 0, "Slot %d: %s", index + 1, slots->names[index]);
+    return true;
+}
+
+int slots_next(const Chip8Slots* slots) {
+    for (int step = 1; step <= SLOT_COUNT; step++) {
+        int index = (slots->active + step) % SLOT_COUNT;
+        if (slots->saved[index] && index != slots->active) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int slots_active(const Chip8Slots* slots) {
+    return slots->active;
+}
@@ -0,0 +1,49 @@
+#ifndef CHIP8_SLOTS_H
+#define CHIP8_SLOTS_H
+
+#include "chip8_cpu.h"
+#include <stdbool.h>
+
+// Loaded ROM sessions for the single-ROM window
+//
+// Keeps up to SLOT_COUNT sessions. The active one runs in the caller's live
+// Chip8, so whatever is attached to it (debugger, shared memory, movie
+// recording) follows the active session; the others are whole-machine
+// snapshots that take no emulation time until they are switched to.
+// Switching saves the live machine into its slot and restores another,
+// two copies of a few kilobytes.
+//
+// ROMs load on a background thread into a freshly initialised machine, so
+// a new session starts from reset instead of inheriting the registers and
+// screen of the one that was running, and a slow disk never holds up a
+// frame. A finished load becomes active at the next slots_poll; the loader
+// also pushes an SDL event so a loop blocked in SDL_WaitEvent wakes for it.
+
+#define SLOT_COUNT 8
+#define SLOT_QUEUE 8
+#define SLOT_NAME_SIZE 64
+
+typedef struct Chip8Slots Chip8Slots;
+
+// `live` is the machine the active session runs in
+Chip8Slots* slots_create(Chip8* live);
+void slots_destroy(Chip8Slots* slots);
+
+// Makes the ROM already loaded into the live machine the first session
+void slots_adopt(Chip8Slots* slots, const char* filename);
+// Queues a ROM for the loader thread. Returns false if too many are queued.
+bool slots_load(Chip8Slots* slots, const char* filename);
+// Installs finished loads, each in a free slot or else the least recently
+// used inactive one, and activates the last. Returns whether the live
+// machine now holds a different session.
+bool slots_poll(Chip8Slots* slots);
+
+// Suspends the active session and resumes slot `index`. Returns false if
+// the slot is empty or already active.
+bool slots_switch(Chip8Slots* slots, int index);
+// Next occupied slot after the active one, wrapping; -1 if there is none
+int slots_next(const Chip8Slots* slots);
+// Active slot, -1 before the first ROM
+int slots_active(const Chip8Slots* slots);
+
+#endif
@@ -0,0 +1,182 @@
+#include "chip8_spans.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    Uint64 start;
+    Uint64 end;
+    const char* name;
+    int index;
+} Span;
+
+// Written only by its thread; `head` counts every span ever recorded
+typedef struct {
+    SDL_atomic_t head;
+    SDL_threadID thread;
+    const char* name;
+    Span spans[SPANS_PER_THREAD];
+} SpanRing;
+
+static SDL_atomic_t enabled;
+// Counter value when tracing was last enabled; older spans are not written
+static Uint64 epoch;
+
+static void* rings[SPANS_MAX_THREADS];
+static SDL_atomic_t ring_count;
+
+static _Thread_local SpanRing* thread_ring;
+static _Thread_local const char* thread_name;
+// Set once the ring table is full so the thread stops trying
+static _Thread_local bool thread_untraced;
+
+void spans_enable(bool on) {
+    if (on) {
+        epoch = SDL_GetPerformanceCounter();
+    }
+    SDL_AtomicSet(&enabled, on);
+}
+
+bool spans_enabled(void) {
+    return SDL_AtomicGet(&enabled) != 0;
+}
+
+void spans_name_thread(const char* name) {
+    thread_name = name;
+    if (thread_ring) {
+        thread_ring->name = name;
+    }
+}
+
+static SpanRing* register_thread(void) {
+    if (thread_untraced) {
+        return NULL;
+    }
+
+    int slot = SDL_AtomicAdd(&ring_count, 1);
+    SpanRing* ring = slot < SPANS_MAX_THREADS ? calloc(1, sizeof(SpanRing)) : NULL;
+    if (!ring) {
+        thread_untraced = true;
+        return NULL;
+    }
+    ring->thread = SDL_ThreadID();
+    ring->name = thread_name;
+    SDL_AtomicSetPtr(&rings[slot], ring);
+    thread_ring = ring;
+    return ring;
+}
+
+Uint64 spans_begin(void) {
+    if (!SDL_AtomicGet(&enabled)) {
+        return 0;
+    }
+    return SDL_GetPerformanceCounter();
+}
+
+void spans_end(Uint64 start, const char* name, int index) {
+    if (!start) {
+        return;
+    }
+    SpanRing* ring = thread_ring ? thread_ring : register_thread();
+    if (!ring) {
+        return;
+    }
+
+    int head = SDL_AtomicGet(&ring->head);
+    Span* span = &ring->spans[(unsigned)head % SPANS_PER_THREAD];
+    span->start = start;
+    span->end = SDL_GetPerformanceCounter();
+    span->name = name;
+    span->index = index;
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring->head, head + 1);
+}
+
+// Copies the spans still in `ring` into `out`; returns how many. Spans the
+// owner overwrote while they were being copied are dropped.
+static int snapshot_ring(SpanRing* ring, Span* out) {
+    unsigned head = (unsigned)SDL_AtomicGet(&ring->head);
+    SDL_MemoryBarrierAcquire();
+    unsigned first = head > SPANS_PER_THREAD ? head - SPANS_PER_THREAD : 0;
+    for (unsigned i = first; i < head; i++) {
+        out[i - first] = ring->spans[i % SPANS_PER_THREAD];
+    }
+
+    SDL_MemoryBarrierAcquire();
+    unsigned now = (unsigned)SDL_AtomicGet(&ring->head);
+    unsigned valid = now > SPANS_PER_THREAD ? now - SPANS_PER_THREAD : 0;
+    if (valid <= first) {
+        return (int)(head - first);
+    }
+    if (valid >= head) {
+        return 0;
+    }
+    memmove(out, out + (valid - first), (head - valid) * sizeof(Span));
+    return (int)(head - valid);
+}
+
+int spans_write(const char* filename) {
+    FILE* file = fopen(filename, "w");
+    Span* spans = malloc(SPANS_PER_THREAD * sizeof(Span));
+    if (!file || !spans) {
+        printf("Error: Could not write trace %s\n", filename);
+        if (file) {
+            fclose(file);
+        }
+        free(spans);
+        return 0;
+    }
+
+    // Chrome wants microseconds; fractions keep sub-microsecond stages apart
+    double us_per_tick = 1e6 / (double)SDL_GetPerformanceFrequency();
+    int count = SDL_AtomicGet(&ring_count);
+    if (count > SPANS_MAX_THREADS) {
+        count = SPANS_MAX_THREADS;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"chip8_emulator\"}}");
+    int written = 0;
+    for (int slot = 0; slot < count; slot++) {
+        SpanRing* ring = SDL_AtomicGetPtr(&rings[slot]);
+        if (!ring) {
+            continue;
+        }
+
+        int tid = slot + 1;
+        if (ring->name) {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    tid, ring->name);
+        } else {
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %lu\"}}",
+                    tid, (unsigned long)ring->thread);
+        }
+
+        int n = snapshot_ring(ring, spans);
+        for (int i = 0; i < n; i++) {
+            const Span* span = &spans[i];
+            if (span->start < epoch) {
+                continue;
+            }
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    span->name, tid, (double)(span->start - epoch) * us_per_tick,
+                    (double)(span->end - span->start) * us_per_tick);
+            if (span->index >= 0) {
+                fprintf(file, ",\"args\":{\"index\":%d}", span->index);
+            }
+            fputc('}', file);
+            written++;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    free(spans);
+    int ok = !ferror(file);
+    if (fclose(file) != 0 || !ok) {
+        printf("Error: Could not write trace %s\n", filename);
+        return 0;
+    }
+    printf("Wrote %d spans to %s\n", written, filename);
+    return 1;
+}
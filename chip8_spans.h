@@ -0,0 +1,44 @@
+#ifndef CHIP8_SPANS_H
+#define CHIP8_SPANS_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+
+// Host pipeline trace spans
+//
+// Times the stages of the host loop (emulation, input, pixel conversion,
+// texture upload, present, sleep) and the per-instance work done on worker
+// threads, to find where a dropped frame's time went. Each thread appends to
+// its own ring of the most recent SPANS_PER_THREAD spans and publishes its
+// head with a release store, so recording never takes a lock and never
+// waits on the exporter. spans_write saves every ring as Chrome trace-event
+// JSON, which chrome://tracing and ui.perfetto.dev open directly.
+//
+// While tracing is off spans_begin is a flag test and spans_end returns
+// immediately; rings are only allocated once a thread records a span.
+//
+//   Uint64 span = spans_begin();
+//   ...
+//   spans_end(span, "present", -1);
+
+#define SPANS_PER_THREAD 32768
+#define SPANS_MAX_THREADS 64
+
+void spans_enable(bool enabled);
+bool spans_enabled(void);
+
+// Name shown for the calling thread's track, e.g. "main" or "chip8_worker"
+void spans_name_thread(const char* name);
+
+// Start timestamp for a span, 0 while tracing is off
+Uint64 spans_begin(void);
+// Records a span from `start` to now on the calling thread. `name` must stay
+// valid until the trace is written (a string literal); `index` is shown as
+// the span's argument, e.g. the instance it ran, or -1 for none.
+void spans_end(Uint64 start, const char* name, int index);
+
+// Writes the spans recorded since tracing was last enabled. Returns 0 on
+// failure.
+int spans_write(const char* filename);
+
+#endif
@@ -0,0 +1,552 @@
+#include "chip8_trace.h"
+#include "chip8_opcodes.h"
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Worst case record: flags + opcode, pc and cycle varints, 20 registers, 16 memory bytes
+#define TRACE_MAX_RECORD 64
+#define TRACE_CHUNK_HEADER 8
+
+struct Chip8Trace {
+    Chip8* cpu;
+    FILE* file;
+    SDL_Thread* writer;
+
+    // Chunk pool shared with the writer thread. The emulation thread fills
+    // chunks in order and the writer drains them in the same order.
+    uint8_t* chunks[TRACE_CHUNK_COUNT];
+    uint32_t sizes[TRACE_CHUNK_COUNT];
+    SDL_sem* filled;
+    SDL_sem* free_slots;
+    uint32_t write_index;
+
+    // Chunk being encoded, NULL between chunks
+    uint8_t* buf;
+    uint32_t pos;
+    uint32_t records;
+    uint16_t prev_pc;
+    uint64_t prev_cycle;
+};
+
+static void put_u16(uint8_t* buf, uint32_t* pos, uint16_t value) {
+    buf[(*pos)++] = value & 0xFF;
+    buf[(*pos)++] = value >> 8;
+}
+
+static void put_u32(uint8_t* buf, uint32_t pos, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        buf[pos + i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+static void put_varint(uint8_t* buf, uint32_t* pos, uint64_t value) {
+    while (value >= 0x80) {
+        buf[(*pos)++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[(*pos)++] = (uint8_t)value;
+}
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int writer_thread(void* data) {
+    Chip8Trace* trace = data;
+    uint32_t read_index = 0;
+
+    for (;;) {
+        SDL_SemWait(trace->filled);
+        uint32_t slot = read_index % TRACE_CHUNK_COUNT;
+        uint32_t size = trace->sizes[slot];
+
+        // A zero-sized chunk is the stop request
+        if (size == 0) {
+            break;
+        }
+
+        fwrite(trace->chunks[slot], 1, size, trace->file);
+        read_index++;
+        SDL_SemPost(trace->free_slots);
+    }
+
+    return 0;
+}
+
+// Starts a chunk whose sync block describes the machine as it is just before
+// the record at `cycle`, `pc`
+static void begin_chunk(Chip8Trace* trace, uint64_t cycle, uint16_t pc) {
+    const Chip8* cpu = trace->cpu;
+
+    // Blocks only if the writer has fallen a whole pool behind
+    SDL_SemWait(trace->free_slots);
+    trace->buf = trace->chunks[trace->write_index % TRACE_CHUNK_COUNT];
+    trace->pos = TRACE_CHUNK_HEADER;
+    trace->records = 0;
+
+    uint8_t* buf = trace->buf;
+    for (int i = 0; i < 8; i++) {
+        buf[trace->pos++] = (cycle >> (8 * i)) & 0xFF;
+    }
+    put_u16(buf, &trace->pos, pc);
+    put_u16(buf, &trace->pos, cpu->I);
+    buf[trace->pos++] = cpu->sp;
+    buf[trace->pos++] = cpu->delay_timer;
+    buf[trace->pos++] = cpu->sound_timer;
+    memcpy(buf + trace->pos, cpu->V, REGISTER_COUNT);
+    trace->pos += REGISTER_COUNT;
+    put_u16(buf, &trace->pos, cpu->keypad);
+
+    trace->prev_pc = pc - 2;
+    trace->prev_cycle = cycle - 1;
+}
+
+static void submit_chunk(Chip8Trace* trace) {
+    uint32_t slot = trace->write_index % TRACE_CHUNK_COUNT;
+
+    put_u32(trace->buf, 0, trace->pos - TRACE_CHUNK_HEADER);
+    put_u32(trace->buf, 4, trace->records);
+    trace->sizes[slot] = trace->pos;
+    trace->write_index++;
+    trace->buf = NULL;
+    SDL_SemPost(trace->filled);
+}
+
+// Records one instruction around the profile's inlined interpreter.
+// Registers are diffed around it; memory writes come from decoding the
+// opcode up front.
+static inline __attribute__((always_inline)) bool trace_execute(
+    bool (*execute)(Chip8*, uint16_t), Chip8* cpu, int i, uint16_t pc, uint16_t opcode) {
+    Chip8Trace* trace = cpu->hook_data;
+    uint64_t cycle = cpu->cycles + i;
+
+    if (!trace->buf) {
+        begin_chunk(trace, cycle, pc);
+    }
+
+    uint8_t V[REGISTER_COUNT];
+    memcpy(V, cpu->V, REGISTER_COUNT);
+    uint16_t I = cpu->I;
+    uint8_t sp = cpu->sp;
+    uint8_t delay_timer = cpu->delay_timer;
+    uint8_t sound_timer = cpu->sound_timer;
+
+    // Only the Fxxx group writes memory
+    Chip8MemAccess access = {0};
+    if ((opcode & 0xF000) == 0xF000) {
+        chip8_decode_mem_access(cpu, opcode, &access);
+    }
+
+    bool idle = execute(cpu, opcode);
+
+    // Compare V eight registers at a time and visit only the bytes that
+    // differ; most opcodes change at most two (Vx and VF)
+    uint32_t reg_mask = 0;
+    uint8_t after_V[REGISTER_COUNT];
+    uint64_t before[2], after[2];
+    memcpy(after_V, cpu->V, REGISTER_COUNT);
+    memcpy(before, V, REGISTER_COUNT);
+    memcpy(after, after_V, REGISTER_COUNT);
+    for (int w = 0; w < 2; w++) {
+        for (uint64_t diff = before[w] ^ after[w]; diff; ) {
+            int byte = __builtin_ctzll(diff) / 8;
+            reg_mask |= 1u << (w * 8 + byte);
+            diff &= ~(0xFFull << (byte * 8));
+        }
+    }
+    uint16_t after_I = cpu->I;
+    if (after_I != I) reg_mask |= TRACE_REG_I;
+    if (cpu->sp != sp) reg_mask |= TRACE_REG_SP;
+    if (cpu->delay_timer != delay_timer) reg_mask |= TRACE_REG_DT;
+    if (cpu->sound_timer != sound_timer) reg_mask |= TRACE_REG_ST;
+
+    // Encode through a local cursor; byte stores through trace->buf would
+    // otherwise alias every field the compiler has cached
+    uint8_t* buf = trace->buf;
+    uint32_t pos = trace->pos;
+    uint32_t flags_pos = pos;
+    uint8_t flags = 0;
+    pos++;
+    buf[pos++] = opcode >> 8;
+    buf[pos++] = opcode & 0xFF;
+
+    uint16_t expected_pc = trace->prev_pc + 2;
+    if (pc != expected_pc) {
+        flags |= TRACE_PC_JUMP;
+        put_varint(buf, &pos, zigzag((int64_t)pc - expected_pc));
+    }
+    uint64_t expected_cycle = trace->prev_cycle + 1;
+    if (cycle != expected_cycle) {
+        flags |= TRACE_CYCLE_GAP;
+        put_varint(buf, &pos, cycle - expected_cycle);
+    }
+    if (reg_mask) {
+        flags |= TRACE_REGS;
+        put_varint(buf, &pos, reg_mask);
+        for (uint32_t bits = reg_mask & 0xFFFF; bits; bits &= bits - 1) {
+            buf[pos++] = after_V[__builtin_ctz(bits)];
+        }
+        if (reg_mask & TRACE_REG_I) put_varint(buf, &pos, after_I);
+        if (reg_mask & TRACE_REG_SP) buf[pos++] = cpu->sp;
+        if (reg_mask & TRACE_REG_DT) buf[pos++] = cpu->delay_timer;
+        if (reg_mask & TRACE_REG_ST) buf[pos++] = cpu->sound_timer;
+    }
+    if (access.write_len) {
+        flags |= TRACE_MEM;
+        put_varint(buf, &pos, access.write_addr);
+        buf[pos++] = access.write_len;
+        for (int m = 0; m < access.write_len; m++) {
+            buf[pos++] = cpu->memory[(access.write_addr + m) & ADDR_MASK];
+        }
+    }
+    buf[flags_pos] = flags;
+
+    trace->pos = pos;
+    trace->prev_pc = pc;
+    trace->prev_cycle = cycle;
+    trace->records++;
+
+    if (trace->pos > TRACE_CHUNK_SIZE - TRACE_MAX_RECORD) {
+        submit_chunk(trace);
+    }
+    return idle;
+}
+
+// Traced copy of every quirk profile's run loop
+#define PROFILE_VARIANT traced
+#define PROFILE_EXECUTE(execute, cpu, i, pc, opcode) trace_execute(execute, cpu, i, pc, opcode)
+#include "chip8_opcodes_profiles.h"
+
+static int (*const traced_run[QUIRK_PROFILE_COUNT])(Chip8* cpu, int cycles) = {
+    [QUIRKS_CHIP8]  = run_chip8_traced,
+    [QUIRKS_SCHIP]  = run_schip_traced,
+    [QUIRKS_XOCHIP] = run_xochip_traced,
+};
+
+// Replaces profile->run. Idle cycles are skipped as on the normal path, so
+// the trace shows them as a cycle gap.
+static int trace_run(Chip8* cpu, int cycles) {
+    int ran = traced_run[cpu->profile - quirk_profiles](cpu, cycles);
+    cpu->idle_cycles += cycles - ran;
+    return cycles;
+}
+
+// Records a timer tick or key change. It lands between the last instruction
+// and the one at the current cycle.
+static void trace_event(Chip8* cpu, Chip8InputType type, uint8_t key) {
+    Chip8Trace* trace = cpu->hook_data;
+    uint64_t cycle = cpu->cycles;
+
+    if (!trace->buf) {
+        begin_chunk(trace, cycle, cpu->pc);
+    }
+
+    uint8_t* buf = trace->buf;
+    uint32_t pos = trace->pos;
+    uint32_t flags_pos = pos;
+    uint8_t flags = TRACE_EVENT;
+    pos++;
+    if (type == CHIP8_EVENT_TIMER_TICK) {
+        buf[pos++] = TRACE_EVENT_TIMER;
+        buf[pos++] = 0;
+    } else {
+        buf[pos++] = type == CHIP8_EVENT_KEY_DOWN ? TRACE_EVENT_KEY_DOWN : TRACE_EVENT_KEY_UP;
+        buf[pos++] = key;
+    }
+
+    uint64_t expected_cycle = trace->prev_cycle + 1;
+    if (cycle != expected_cycle) {
+        flags |= TRACE_CYCLE_GAP;
+        put_varint(buf, &pos, cycle - expected_cycle);
+    }
+    if (type == CHIP8_EVENT_TIMER_TICK) {
+        flags |= TRACE_REGS;
+        put_varint(buf, &pos, TRACE_REG_DT | TRACE_REG_ST);
+        buf[pos++] = cpu->delay_timer;
+        buf[pos++] = cpu->sound_timer;
+    }
+    buf[flags_pos] = flags;
+
+    // Takes no cycle, so the next instruction is still expected at `cycle`
+    trace->pos = pos;
+    trace->prev_cycle = cycle - 1;
+    trace->records++;
+
+    if (trace->pos > TRACE_CHUNK_SIZE - TRACE_MAX_RECORD) {
+        submit_chunk(trace);
+    }
+}
+
+// Releases everything chip8_trace_start created; the writer must not be running
+static void free_trace(Chip8Trace* trace) {
+    fclose(trace->file);
+    for (int i = 0; i < TRACE_CHUNK_COUNT; i++) {
+        free(trace->chunks[i]);
+    }
+    if (trace->filled) {
+        SDL_DestroySemaphore(trace->filled);
+    }
+    if (trace->free_slots) {
+        SDL_DestroySemaphore(trace->free_slots);
+    }
+    free(trace);
+}
+
+Chip8Trace* chip8_trace_start(Chip8* cpu, const char* filename) {
+    if (cpu->run_hook || cpu->event_hook) {
+        printf("Error: another tool is already attached to this instance\n");
+        return NULL;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        printf("Error: Could not create trace file: %s\n", filename);
+        return NULL;
+    }
+
+    Chip8Trace* trace = calloc(1, sizeof(Chip8Trace));
+    if (!trace) {
+        fclose(file);
+        return NULL;
+    }
+
+    trace->cpu = cpu;
+    trace->file = file;
+    bool ok = true;
+    for (int i = 0; i < TRACE_CHUNK_COUNT; i++) {
+        trace->chunks[i] = malloc(TRACE_CHUNK_SIZE);
+        ok = ok && trace->chunks[i];
+    }
+    trace->filled = SDL_CreateSemaphore(0);
+    trace->free_slots = SDL_CreateSemaphore(TRACE_CHUNK_COUNT);
+    if (!ok || !trace->filled || !trace->free_slots) {
+        printf("Error: Could not allocate trace buffers\n");
+        free_trace(trace);
+        return NULL;
+    }
+
+    fwrite(TRACE_MAGIC, 1, 4, file);
+    fputc(TRACE_VERSION, file);
+
+    trace->writer = SDL_CreateThread(writer_thread, "chip8_trace", trace);
+    if (!trace->writer) {
+        printf("Error: Could not start trace writer: %s\n", SDL_GetError());
+        free_trace(trace);
+        return NULL;
+    }
+
+    cpu->hook_data = trace;
+    cpu->run_hook = trace_run;
+    cpu->event_hook = trace_event;
+
+    printf("Tracing to %s\n", filename);
+    return trace;
+}
+
+void chip8_trace_stop(Chip8Trace* trace) {
+    if (!trace) {
+        return;
+    }
+
+    trace->cpu->run_hook = NULL;
+    trace->cpu->event_hook = NULL;
+    trace->cpu->hook_data = NULL;
+
+    if (trace->buf) {
+        submit_chunk(trace);
+    }
+
+    // Queue the stop request behind the remaining chunks
+    SDL_SemWait(trace->free_slots);
+    trace->sizes[trace->write_index % TRACE_CHUNK_COUNT] = 0;
+    SDL_SemPost(trace->filled);
+    SDL_WaitThread(trace->writer, NULL);
+
+    free_trace(trace);
+}
+
+// Reader
+
+static int get_varint(TraceReader* reader, uint64_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (reader->pos >= reader->chunk_size) {
+            return 0;
+        }
+        uint8_t byte = reader->chunk[reader->pos++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int get_byte(TraceReader* reader, uint8_t* value) {
+    if (reader->pos >= reader->chunk_size) {
+        return 0;
+    }
+    *value = reader->chunk[reader->pos++];
+    return 1;
+}
+
+static uint32_t read_u32(const uint8_t* buf) {
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static int load_chunk(TraceReader* reader) {
+    uint8_t header[TRACE_CHUNK_HEADER];
+    size_t got = fread(header, 1, sizeof(header), reader->file);
+    if (got == 0) {
+        return 0;
+    }
+    if (got != sizeof(header)) {
+        return -1;
+    }
+
+    uint32_t size = read_u32(header);
+    if (size < TRACE_SYNC_SIZE || size > TRACE_CHUNK_SIZE) {
+        return -1;
+    }
+    if (fread(reader->chunk, 1, size, reader->file) != size) {
+        return -1;
+    }
+    reader->chunk_size = size;
+    reader->remaining = read_u32(header + 4);
+
+    const uint8_t* sync = reader->chunk;
+    TraceRecord* state = &reader->state;
+    state->cycle = 0;
+    for (int i = 0; i < 8; i++) {
+        state->cycle |= (uint64_t)sync[i] << (8 * i);
+    }
+    state->pc = sync[8] | sync[9] << 8;
+    state->I = sync[10] | sync[11] << 8;
+    state->sp = sync[12];
+    state->delay_timer = sync[13];
+    state->sound_timer = sync[14];
+    memcpy(state->V, sync + 15, REGISTER_COUNT);
+    state->keypad = sync[31] | sync[32] << 8;
+
+    // Seed the deltas so the first record decodes against the sync block
+    state->pc -= 2;
+    state->cycle -= 1;
+    reader->pos = TRACE_SYNC_SIZE;
+    return 1;
+}
+
+int trace_reader_open(TraceReader* reader, const char* filename) {
+    memset(reader, 0, sizeof(*reader));
+    reader->file = fopen(filename, "rb");
+    if (!reader->file) {
+        printf("Error: Could not open trace file: %s\n", filename);
+        return 0;
+    }
+
+    char magic[5];
+    if (fread(magic, 1, 5, reader->file) != 5 || memcmp(magic, TRACE_MAGIC, 4) != 0 ||
+        magic[4] != TRACE_VERSION) {
+        printf("Error: %s is not a CHIP-8 trace\n", filename);
+        fclose(reader->file);
+        return 0;
+    }
+
+    reader->chunk = malloc(TRACE_CHUNK_SIZE);
+    if (!reader->chunk) {
+        fclose(reader->file);
+        return 0;
+    }
+    return 1;
+}
+
+int trace_reader_next(TraceReader* reader, TraceRecord* record) {
+    while (reader->remaining == 0) {
+        int loaded = load_chunk(reader);
+        if (loaded <= 0) {
+            return loaded;
+        }
+    }
+
+    TraceRecord* state = &reader->state;
+    uint8_t flags, hi, lo;
+    if (!get_byte(reader, &flags) || !get_byte(reader, &hi) || !get_byte(reader, &lo)) {
+        return -1;
+    }
+
+    uint64_t value;
+    uint16_t pc = state->pc + 2;
+    uint64_t cycle = state->cycle + 1;
+    if (flags & TRACE_PC_JUMP) {
+        if (flags & TRACE_EVENT) return -1;
+        if (!get_varint(reader, &value)) return -1;
+        int64_t delta = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+        pc = (uint16_t)(pc + delta);
+    }
+    if (flags & TRACE_CYCLE_GAP) {
+        if (!get_varint(reader, &value)) return -1;
+        cycle += value;
+    }
+
+    if (flags & TRACE_EVENT) {
+        if (hi < TRACE_EVENT_TIMER || hi > TRACE_EVENT_KEY_UP || lo >= KEY_COUNT) {
+            return -1;
+        }
+        state->event = hi;
+        state->key = lo;
+        if (hi == TRACE_EVENT_KEY_DOWN) {
+            state->keypad |= 1 << lo;
+        } else if (hi == TRACE_EVENT_KEY_UP) {
+            state->keypad &= ~(1 << lo);
+        }
+    } else {
+        state->event = TRACE_EVENT_NONE;
+        state->key = 0;
+        state->pc = pc;
+        state->opcode = hi << 8 | lo;
+    }
+    state->cycle = cycle;
+    state->reg_mask = 0;
+    state->mem_len = 0;
+
+    if (flags & TRACE_REGS) {
+        if (!get_varint(reader, &value)) return -1;
+        state->reg_mask = (uint32_t)value;
+        for (int r = 0; r < REGISTER_COUNT; r++) {
+            if ((state->reg_mask & (1u << r)) && !get_byte(reader, &state->V[r])) return -1;
+        }
+        if (state->reg_mask & TRACE_REG_I) {
+            if (!get_varint(reader, &value)) return -1;
+            state->I = (uint16_t)value;
+        }
+        if ((state->reg_mask & TRACE_REG_SP) && !get_byte(reader, &state->sp)) return -1;
+        if ((state->reg_mask & TRACE_REG_DT) && !get_byte(reader, &state->delay_timer)) return -1;
+        if ((state->reg_mask & TRACE_REG_ST) && !get_byte(reader, &state->sound_timer)) return -1;
+    }
+    if (flags & TRACE_MEM) {
+        if (!get_varint(reader, &value) || !get_byte(reader, &state->mem_len)) return -1;
+        state->mem_addr = (uint16_t)value;
+        if (state->mem_len > sizeof(state->mem)) return -1;
+        for (int m = 0; m < state->mem_len; m++) {
+            if (!get_byte(reader, &state->mem[m])) return -1;
+        }
+    }
+
+    reader->remaining--;
+    *record = *state;
+
+    // An event takes no cycle; the next record is expected at the same one
+    if (flags & TRACE_EVENT) {
+        state->cycle = cycle - 1;
+    }
+    return 1;
+}
+
+void trace_reader_close(TraceReader* reader) {
+    if (reader->file) {
+        fclose(reader->file);
+    }
+    free(reader->chunk);
+    memset(reader, 0, sizeof(*reader));
+}
@@ -0,0 +1,95 @@
+#ifndef CHIP8_TRACE_H
+#define CHIP8_TRACE_H
+
+#include "chip8_cpu.h"
+#include <stdio.h>
+
+// Binary execution trace
+//
+// File:   "C8TR" u8 version, then chunks
+// Chunk:  u32 payload size, u32 record count, sync block, records
+// Sync:   u64 cycle, u16 pc, u16 I, u8 sp, u8 delay, u8 sound, u8 V[16],
+//         u16 keypad
+// Record: u8 flags, then u8 opcode hi, u8 opcode lo for an instruction or
+//         u8 event (TRACE_EVENT_*), u8 key for an event, then in flag order
+//           TRACE_PC_JUMP    zigzag varint, pc - (previous pc + 2)
+//           TRACE_CYCLE_GAP  varint, cycle - (previous cycle + 1)
+//           TRACE_REGS       varint mask (TRACE_REG_*), new values in
+//                            bit order; V/sp/timers are bytes, I a varint
+//           TRACE_MEM        varint address, u8 length, bytes written
+//
+// Events are the timer ticks and key changes between instructions. They
+// happen before the instruction of the same cycle and take no cycle of
+// their own; a tick carries the timers it left behind.
+//
+// Multi-byte fixed fields are little-endian. Every chunk starts from its own
+// sync block so a reader can begin decoding at any chunk.
+
+#define TRACE_MAGIC "C8TR"
+#define TRACE_VERSION 2
+
+#define TRACE_PC_JUMP   0x01
+#define TRACE_CYCLE_GAP 0x02
+#define TRACE_REGS      0x04
+#define TRACE_MEM       0x08
+#define TRACE_EVENT     0x10
+
+#define TRACE_REG_I  (1u << 16)
+#define TRACE_REG_SP (1u << 17)
+#define TRACE_REG_DT (1u << 18)
+#define TRACE_REG_ST (1u << 19)
+
+// Record kinds; instructions are TRACE_EVENT_NONE
+#define TRACE_EVENT_NONE     0
+#define TRACE_EVENT_TIMER    1
+#define TRACE_EVENT_KEY_DOWN 2
+#define TRACE_EVENT_KEY_UP   3
+
+#define TRACE_SYNC_SIZE 33
+#define TRACE_CHUNK_SIZE (256 * 1024)
+#define TRACE_CHUNK_COUNT 8
+
+typedef struct Chip8Trace Chip8Trace;
+
+// Starts recording every instruction `cpu` executes, and every timer tick and
+// key change, into `filename`. Encoding happens on the emulation thread, file
+// writes on a background thread.
+Chip8Trace* chip8_trace_start(Chip8* cpu, const char* filename);
+void chip8_trace_stop(Chip8Trace* trace);
+
+// Decoded view of one record, used by the trace tool. For an event, pc and
+// opcode are those of the last instruction.
+typedef struct {
+    uint64_t cycle;
+    uint8_t event;
+    uint8_t key;
+    uint16_t keypad;
+    uint16_t pc;
+    uint16_t opcode;
+    uint32_t reg_mask;
+    uint8_t V[REGISTER_COUNT];
+    uint16_t I;
+    uint8_t sp;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint16_t mem_addr;
+    uint8_t mem_len;
+    uint8_t mem[REGISTER_COUNT];
+} TraceRecord;
+
+typedef struct {
+    FILE* file;
+    uint8_t* chunk;
+    uint32_t chunk_size;
+    uint32_t remaining;
+    uint32_t pos;
+    TraceRecord state;
+} TraceReader;
+
+int trace_reader_open(TraceReader* reader, const char* filename);
+// Returns 1 and fills `record` with the next record, 0 at end of trace,
+// -1 if the file is corrupt
+int trace_reader_next(TraceReader* reader, TraceRecord* record);
+void trace_reader_close(TraceReader* reader);
+
+#endif
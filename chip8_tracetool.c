@@ -0,0 +1,340 @@
+#define SDL_MAIN_HANDLED
+#include "chip8_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OPCODE_CLASS_COUNT 35
+#define DEFAULT_LAST_COUNT 32
+
+static const char* opcode_class_names[OPCODE_CLASS_COUNT] = {
+    "00E0 CLS", "00EE RET", "0nnn SYS", "1nnn JP", "2nnn CALL", "3xnn SE", "4xnn SNE",
+    "5xy0 SE", "6xnn LD", "7xnn ADD", "8xy0 LD", "8xy1 OR", "8xy2 AND", "8xy3 XOR",
+    "8xy4 ADD", "8xy5 SUB", "8xy6 SHR", "8xy7 SUBN", "8xyE SHL", "9xy0 SNE", "Annn LD I",
+    "Bnnn JP V0", "Cxnn RND", "Dxyn DRW", "Ex9E SKP", "ExA1 SKNP", "Fx07 LD DT",
+    "Fx0A LD K", "Fx15 LD DT", "Fx18 LD ST", "Fx1E ADD I", "Fx29 LD F", "Fx33 BCD",
+    "Fx55 STORE", "Fx65 LOAD"
+};
+
+#define CLASS_UNKNOWN -1
+
+static int opcode_class(uint16_t opcode) {
+    uint8_t n = opcode & 0x000F;
+    uint8_t nn = opcode & 0x00FF;
+
+    switch (opcode & 0xF000) {
+        case 0x0000:
+            if (opcode == 0x00E0) return 0;
+            if (opcode == 0x00EE) return 1;
+            return 2;
+        case 0x1000: return 3;
+        case 0x2000: return 4;
+        case 0x3000: return 5;
+        case 0x4000: return 6;
+        case 0x5000: return 7;
+        case 0x6000: return 8;
+        case 0x7000: return 9;
+        case 0x8000:
+            if (n <= 0x7) return 10 + n;
+            if (n == 0xE) return 18;
+            return CLASS_UNKNOWN;
+        case 0x9000: return 19;
+        case 0xA000: return 20;
+        case 0xB000: return 21;
+        case 0xC000: return 22;
+        case 0xD000: return 23;
+        case 0xE000:
+            if (nn == 0x9E) return 24;
+            if (nn == 0xA1) return 25;
+            return CLASS_UNKNOWN;
+        default:
+            switch (nn) {
+                case 0x07: return 26;
+                case 0x0A: return 27;
+                case 0x15: return 28;
+                case 0x18: return 29;
+                case 0x1E: return 30;
+                case 0x29: return 31;
+                case 0x33: return 32;
+                case 0x55: return 33;
+                case 0x65: return 34;
+            }
+            return CLASS_UNKNOWN;
+    }
+}
+
+static void print_record(const TraceRecord* record) {
+    if (record->event == TRACE_EVENT_TIMER) {
+        printf("%10llu  ---  TICK", (unsigned long long)record->cycle);
+    } else if (record->event != TRACE_EVENT_NONE) {
+        printf("%10llu  ---  KEY   %X %s", (unsigned long long)record->cycle, record->key,
+               record->event == TRACE_EVENT_KEY_DOWN ? "down" : "up");
+    } else {
+        printf("%10llu  %03X  %04X", (unsigned long long)record->cycle, record->pc, record->opcode);
+    }
+
+    for (int r = 0; r < REGISTER_COUNT; r++) {
+        if (record->reg_mask & (1u << r)) {
+            printf("  V%X=%02X", r, record->V[r]);
+        }
+    }
+    if (record->reg_mask & TRACE_REG_I) printf("  I=%03X", record->I);
+    if (record->reg_mask & TRACE_REG_SP) printf("  SP=%X", record->sp);
+    if (record->reg_mask & TRACE_REG_DT) printf("  DT=%02X", record->delay_timer);
+    if (record->reg_mask & TRACE_REG_ST) printf("  ST=%02X", record->sound_timer);
+
+    if (record->mem_len) {
+        printf("  [%03X]", record->mem_addr);
+        for (int m = 0; m < record->mem_len; m++) {
+            printf(" %02X", record->mem[m]);
+        }
+    }
+    printf("\n");
+}
+
+static int check_result(int result, const char* filename) {
+    if (result < 0) {
+        printf("Error: %s is truncated or corrupt\n", filename);
+    }
+    return result;
+}
+
+static int cmd_summary(const char* filename) {
+    TraceReader reader;
+    if (!trace_reader_open(&reader, filename)) {
+        return 1;
+    }
+
+    static uint8_t pcs_seen[MEMORY_SIZE];
+    uint64_t counts[OPCODE_CLASS_COUNT] = {0};
+    uint64_t unknown = 0;
+    uint64_t total = 0;
+    uint64_t ticks = 0;
+    uint64_t key_events = 0;
+    uint64_t mem_writes = 0;
+    uint64_t first_cycle = 0;
+    uint64_t last_cycle = 0;
+    int unique_pcs = 0;
+
+    TraceRecord record;
+    int result;
+    while ((result = trace_reader_next(&reader, &record)) > 0) {
+        if (record.event == TRACE_EVENT_TIMER) {
+            ticks++;
+            continue;
+        }
+        if (record.event != TRACE_EVENT_NONE) {
+            key_events++;
+            continue;
+        }
+        if (total == 0) {
+            first_cycle = record.cycle;
+        }
+        last_cycle = record.cycle;
+        total++;
+        mem_writes += record.mem_len;
+
+        int cls = opcode_class(record.opcode);
+        if (cls == CLASS_UNKNOWN) {
+            unknown++;
+        } else {
+            counts[cls]++;
+        }
+
+        uint16_t pc = record.pc & ADDR_MASK;
+        if (!pcs_seen[pc]) {
+            pcs_seen[pc] = 1;
+            unique_pcs++;
+        }
+    }
+    trace_reader_close(&reader);
+    check_result(result, filename);
+
+    printf("Instructions:  %llu\n", (unsigned long long)total);
+    printf("Cycles:        %llu - %llu\n", (unsigned long long)first_cycle,
+           (unsigned long long)last_cycle);
+    printf("Unique PCs:    %d\n", unique_pcs);
+    printf("Bytes written: %llu\n", (unsigned long long)mem_writes);
+    printf("Timer ticks:   %llu\n", (unsigned long long)ticks);
+    printf("Key events:    %llu\n", (unsigned long long)key_events);
+    printf("\nInstruction mix:\n");
+    for (int i = 0; i < OPCODE_CLASS_COUNT; i++) {
+        if (counts[i]) {
+            printf("  %-12s %12llu  %5.1f%%\n", opcode_class_names[i],
+                   (unsigned long long)counts[i], 100.0 * counts[i] / total);
+        }
+    }
+    if (unknown) {
+        printf("  %-12s %12llu  %5.1f%%\n", "unknown", (unsigned long long)unknown,
+               100.0 * unknown / total);
+    }
+    return result < 0;
+}
+
+// Prints records, optionally limited to a cycle window and a single PC
+static int cmd_dump(const char* filename, uint64_t from, uint64_t to, int pc_filter) {
+    TraceReader reader;
+    if (!trace_reader_open(&reader, filename)) {
+        return 1;
+    }
+
+    TraceRecord record;
+    int result;
+    while ((result = trace_reader_next(&reader, &record)) > 0) {
+        if (record.cycle < from) {
+            continue;
+        }
+        if (record.cycle > to) {
+            break;
+        }
+        if (pc_filter >= 0 && (record.event != TRACE_EVENT_NONE || record.pc != pc_filter)) {
+            continue;
+        }
+        print_record(&record);
+    }
+    trace_reader_close(&reader);
+    return check_result(result, filename) < 0;
+}
+
+static int cmd_last(const char* filename, int count) {
+    TraceReader reader;
+    if (!trace_reader_open(&reader, filename)) {
+        return 1;
+    }
+
+    TraceRecord* ring = calloc(count, sizeof(TraceRecord));
+    if (!ring) {
+        printf("Error: Could not allocate %d records of history\n", count);
+        trace_reader_close(&reader);
+        return 1;
+    }
+    uint64_t total = 0;
+    int result;
+    while ((result = trace_reader_next(&reader, &ring[total % count])) > 0) {
+        total++;
+    }
+    trace_reader_close(&reader);
+
+    uint64_t start = (total > (uint64_t)count) ? total - count : 0;
+    for (uint64_t i = start; i < total; i++) {
+        print_record(&ring[i % count]);
+    }
+    free(ring);
+    return check_result(result, filename) < 0;
+}
+
+static int records_match(const TraceRecord* a, const TraceRecord* b) {
+    return a->event == b->event && a->key == b->key && a->pc == b->pc && a->opcode == b->opcode &&
+           a->I == b->I && a->sp == b->sp && a->delay_timer == b->delay_timer &&
+           a->sound_timer == b->sound_timer &&
+           memcmp(a->V, b->V, REGISTER_COUNT) == 0 && a->mem_len == b->mem_len &&
+           memcmp(a->mem, b->mem, a->mem_len) == 0;
+}
+
+// Walks two traces in lock step and shows the history leading to the first
+// record where they disagree
+static int cmd_diff(const char* file_a, const char* file_b, int count) {
+    TraceReader a, b;
+    if (!trace_reader_open(&a, file_a)) {
+        return 1;
+    }
+    if (!trace_reader_open(&b, file_b)) {
+        trace_reader_close(&a);
+        return 1;
+    }
+
+    TraceRecord* ring = calloc(count, sizeof(TraceRecord));
+    if (!ring) {
+        printf("Error: Could not allocate %d records of history\n", count);
+        trace_reader_close(&a);
+        trace_reader_close(&b);
+        return 1;
+    }
+    TraceRecord ra, rb;
+    uint64_t index = 0;
+    int status = 0;
+
+    for (;;) {
+        int got_a = trace_reader_next(&a, &ra);
+        int got_b = trace_reader_next(&b, &rb);
+        if (got_a < 0 || got_b < 0) {
+            printf("Error: trace is truncated or corrupt\n");
+            status = 1;
+            break;
+        }
+        if (!got_a && !got_b) {
+            printf("Traces are identical (%llu records)\n", (unsigned long long)index);
+            break;
+        }
+        if (!got_a || !got_b || !records_match(&ra, &rb)) {
+            printf("Traces diverge at record %llu. Preceding history:\n",
+                   (unsigned long long)index);
+            uint64_t start = (index > (uint64_t)count) ? index - count : 0;
+            for (uint64_t i = start; i < index; i++) {
+                print_record(&ring[i % count]);
+            }
+            printf("--- %s\n", file_a);
+            if (got_a) print_record(&ra); else printf("(end of trace)\n");
+            printf("--- %s\n", file_b);
+            if (got_b) print_record(&rb); else printf("(end of trace)\n");
+            status = 2;
+            break;
+        }
+        ring[index % count] = ra;
+        index++;
+    }
+
+    free(ring);
+    trace_reader_close(&a);
+    trace_reader_close(&b);
+    return status;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage:\n");
+    printf("  %s summary <trace>\n", program);
+    printf("  %s last <trace> [count]\n", program);
+    printf("  %s dump <trace> [--from cycle] [--to cycle] [--pc addr]\n", program);
+    printf("  %s diff <trace-a> <trace-b> [count]\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char* command = argv[1];
+    if (strcmp(command, "summary") == 0) {
+        return cmd_summary(argv[2]);
+    }
+    if (strcmp(command, "last") == 0) {
+        int count = (argc >= 4) ? atoi(argv[3]) : DEFAULT_LAST_COUNT;
+        return cmd_last(argv[2], count > 0 ? count : DEFAULT_LAST_COUNT);
+    }
+    if (strcmp(command, "dump") == 0) {
+        uint64_t from = 0;
+        uint64_t to = UINT64_MAX;
+        int pc = -1;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            if (strcmp(argv[i], "--from") == 0) {
+                from = strtoull(argv[i + 1], NULL, 0);
+            } else if (strcmp(argv[i], "--to") == 0) {
+                to = strtoull(argv[i + 1], NULL, 0);
+            } else if (strcmp(argv[i], "--pc") == 0) {
+                pc = (int)strtol(argv[i + 1], NULL, 16);
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        return cmd_dump(argv[2], from, to, pc);
+    }
+    if (strcmp(command, "diff") == 0 && argc >= 4) {
+        int count = (argc >= 5) ? atoi(argv[4]) : DEFAULT_LAST_COUNT;
+        return cmd_diff(argv[2], argv[3], count > 0 ? count : DEFAULT_LAST_COUNT);
+    }
+
+    print_usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,345 @@
+#define SDL_MAIN_HANDLED
+#include "chip8_capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_SCALE 8
+#define MAX_SCALE 32
+#define GIF_MIN_DELAY_CS 2
+#define LZW_MAX_CODE 4095
+#define Y4M_BLACK 16
+#define Y4M_WHITE 235
+#define Y4M_CHROMA 128
+
+// Converts a capture into scaled frames; `emit` gets every emulated frame
+// in order, with gaps filled by repeating the previous picture
+typedef void (*FrameSink)(void* context, const CaptureFrame* frame);
+
+static int for_each_frame(const char* filename, FrameSink emit, void* context, CaptureReader* info) {
+    CaptureReader reader;
+    if (!capture_reader_open(&reader, filename)) {
+        return 1;
+    }
+
+    CaptureFrame frame, previous;
+    bool have_previous = false;
+    int result;
+    while ((result = capture_reader_next(&reader, &frame)) > 0) {
+        if (have_previous) {
+            for (uint64_t f = previous.frame + 1; f < frame.frame; f++) {
+                previous.frame = f;
+                emit(context, &previous);
+            }
+        }
+        emit(context, &frame);
+        previous = frame;
+        have_previous = true;
+    }
+
+    if (info) {
+        *info = reader;
+    }
+    capture_reader_close(&reader);
+    if (result < 0) {
+        printf("Error: %s is truncated or corrupt\n", filename);
+        return 1;
+    }
+    return 0;
+}
+
+// Summary
+
+typedef struct {
+    uint64_t frames;
+    uint64_t first;
+    uint64_t last;
+    uint64_t sound_frames;
+} CaptureInfo;
+
+static void count_frame(void* context, const CaptureFrame* frame) {
+    CaptureInfo* info = context;
+    if (info->frames == 0) {
+        info->first = frame->frame;
+    }
+    info->last = frame->frame;
+    info->frames++;
+    if (frame->sound_timer) {
+        info->sound_frames++;
+    }
+}
+
+static int cmd_info(const char* filename) {
+    CaptureInfo info = {0};
+    CaptureReader reader;
+    if (for_each_frame(filename, count_frame, &info, &reader)) {
+        return 1;
+    }
+
+    int fps = reader.fps ? reader.fps : CAPTURE_FPS;
+    printf("Frames:     %llu (%llu - %llu)\n", (unsigned long long)info.frames,
+           (unsigned long long)info.first, (unsigned long long)info.last);
+    printf("Duration:   %.2f s at %d fps\n", (double)info.frames / fps, fps);
+    printf("Sound on:   %llu frames\n", (unsigned long long)info.sound_frames);
+    return 0;
+}
+
+// Y4M
+
+typedef struct {
+    FILE* file;
+    int scale;
+    uint8_t* luma;
+    uint8_t* chroma;
+} Y4mWriter;
+
+static void write_y4m_frame(void* context, const CaptureFrame* frame) {
+    Y4mWriter* y4m = context;
+    int width = SCREEN_WIDTH * y4m->scale;
+    int height = SCREEN_HEIGHT * y4m->scale;
+
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = y4m->luma + y * width;
+        for (int x = 0; x < width; x++) {
+            row[x] = capture_pixel(frame->plane, x / y4m->scale, y / y4m->scale) ? Y4M_WHITE : Y4M_BLACK;
+        }
+    }
+
+    fputs("FRAME\n", y4m->file);
+    fwrite(y4m->luma, 1, (size_t)width * height, y4m->file);
+    fwrite(y4m->chroma, 1, (size_t)width * height / 4, y4m->file);
+    fwrite(y4m->chroma, 1, (size_t)width * height / 4, y4m->file);
+}
+
+static int cmd_y4m(const char* input, const char* output, int scale) {
+    Y4mWriter y4m;
+    int width = SCREEN_WIDTH * scale;
+    int height = SCREEN_HEIGHT * scale;
+
+    y4m.file = fopen(output, "wb");
+    if (!y4m.file) {
+        printf("Error: Could not create %s\n", output);
+        return 1;
+    }
+    y4m.scale = scale;
+    y4m.luma = malloc((size_t)width * height);
+    y4m.chroma = malloc((size_t)width * height / 4);
+    memset(y4m.chroma, Y4M_CHROMA, (size_t)width * height / 4);
+
+    fprintf(y4m.file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, CAPTURE_FPS);
+    int status = for_each_frame(input, write_y4m_frame, &y4m, NULL);
+
+    fclose(y4m.file);
+    free(y4m.luma);
+    free(y4m.chroma);
+    return status;
+}
+
+// GIF
+
+typedef struct {
+    FILE* file;
+    uint8_t block[255];
+    int block_length;
+    uint32_t bits;
+    int bit_count;
+} GifBitWriter;
+
+typedef struct {
+    FILE* file;
+    int scale;
+    uint8_t* pixels;
+    uint16_t (*dictionary)[4];
+
+    // Pictures are only written when they change; the pending one is held
+    // until its duration is known
+    bool pending;
+    CaptureFrame pending_frame;
+    uint64_t pending_start;
+    uint64_t frames_written;
+} GifWriter;
+
+static void gif_flush_block(GifBitWriter* writer) {
+    if (writer->block_length) {
+        fputc(writer->block_length, writer->file);
+        fwrite(writer->block, 1, writer->block_length, writer->file);
+        writer->block_length = 0;
+    }
+}
+
+static void gif_put_code(GifBitWriter* writer, int code, int size) {
+    writer->bits |= (uint32_t)code << writer->bit_count;
+    writer->bit_count += size;
+    while (writer->bit_count >= 8) {
+        writer->block[writer->block_length++] = writer->bits & 0xFF;
+        writer->bits >>= 8;
+        writer->bit_count -= 8;
+        if (writer->block_length == 255) {
+            gif_flush_block(writer);
+        }
+    }
+}
+
+// LZW with a 2-bit minimum code size; the dictionary is a trie indexed by
+// prefix code and next pixel
+static void gif_write_pixels(GifWriter* gif, int count) {
+    const int min_code_size = 2;
+    const int clear_code = 1 << min_code_size;
+    GifBitWriter writer = {gif->file, {0}, 0, 0, 0};
+
+    fputc(min_code_size, gif->file);
+    memset(gif->dictionary, 0, (LZW_MAX_CODE + 1) * sizeof(gif->dictionary[0]));
+    int code_size = min_code_size + 1;
+    int max_code = clear_code + 1;
+    gif_put_code(&writer, clear_code, code_size);
+
+    int current = gif->pixels[0];
+    for (int i = 1; i < count; i++) {
+        int next = gif->pixels[i];
+        if (gif->dictionary[current][next]) {
+            current = gif->dictionary[current][next];
+            continue;
+        }
+
+        gif_put_code(&writer, current, code_size);
+        gif->dictionary[current][next] = (uint16_t)++max_code;
+        if (max_code >= (1 << code_size)) {
+            code_size++;
+        }
+        if (max_code == LZW_MAX_CODE) {
+            gif_put_code(&writer, clear_code, code_size);
+            memset(gif->dictionary, 0, (LZW_MAX_CODE + 1) * sizeof(gif->dictionary[0]));
+            code_size = min_code_size + 1;
+            max_code = clear_code + 1;
+        }
+        current = next;
+    }
+
+    gif_put_code(&writer, current, code_size);
+    gif_put_code(&writer, clear_code + 1, code_size);
+    if (writer.bit_count) {
+        gif_put_code(&writer, 0, 8 - writer.bit_count);
+    }
+    gif_flush_block(&writer);
+    fputc(0, gif->file);
+}
+
+static void gif_write_image(GifWriter* gif, const CaptureFrame* frame, int delay_cs) {
+    int width = SCREEN_WIDTH * gif->scale;
+    int height = SCREEN_HEIGHT * gif->scale;
+
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = gif->pixels + y * width;
+        for (int x = 0; x < width; x++) {
+            row[x] = (uint8_t)capture_pixel(frame->plane, x / gif->scale, y / gif->scale);
+        }
+    }
+
+    // Graphic control extension with the frame delay, then the image
+    const uint8_t control[] = {0x21, 0xF9, 4, 0, delay_cs & 0xFF, delay_cs >> 8, 0, 0};
+    fwrite(control, 1, sizeof(control), gif->file);
+    const uint8_t descriptor[] = {0x2C, 0, 0, 0, 0, width & 0xFF, width >> 8, height & 0xFF, height >> 8, 0};
+    fwrite(descriptor, 1, sizeof(descriptor), gif->file);
+    gif_write_pixels(gif, width * height);
+    gif->frames_written++;
+}
+
+static int centiseconds(uint64_t frame) {
+    return (int)(frame * 100 / CAPTURE_FPS);
+}
+
+static void write_gif_frame(void* context, const CaptureFrame* frame) {
+    GifWriter* gif = context;
+
+    if (gif->pending && memcmp(frame->plane, gif->pending_frame.plane, CAPTURE_PLANE_SIZE) == 0) {
+        return;
+    }
+    if (gif->pending) {
+        // Changes closer together than viewers can show are merged
+        int delay = centiseconds(frame->frame) - centiseconds(gif->pending_start);
+        if (delay < GIF_MIN_DELAY_CS) {
+            gif->pending_frame = *frame;
+            return;
+        }
+        gif_write_image(gif, &gif->pending_frame, delay);
+    }
+
+    gif->pending = true;
+    gif->pending_frame = *frame;
+    gif->pending_start = frame->frame;
+}
+
+static int cmd_gif(const char* input, const char* output, int scale) {
+    GifWriter gif;
+    memset(&gif, 0, sizeof(gif));
+    int width = SCREEN_WIDTH * scale;
+    int height = SCREEN_HEIGHT * scale;
+
+    gif.file = fopen(output, "wb");
+    if (!gif.file) {
+        printf("Error: Could not create %s\n", output);
+        return 1;
+    }
+    gif.scale = scale;
+    gif.pixels = malloc((size_t)width * height);
+    gif.dictionary = malloc((LZW_MAX_CODE + 1) * sizeof(gif.dictionary[0]));
+
+    // Header, screen descriptor with a 4-entry global palette, loop forever
+    fwrite("GIF89a", 1, 6, gif.file);
+    const uint8_t screen[] = {width & 0xFF, width >> 8, height & 0xFF, height >> 8, 0x81, 0, 0};
+    fwrite(screen, 1, sizeof(screen), gif.file);
+    const uint8_t palette[12] = {0, 0, 0, 255, 255, 255, 0, 0, 0, 0, 0, 0};
+    fwrite(palette, 1, sizeof(palette), gif.file);
+    const uint8_t loop[] = {0x21, 0xFF, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0};
+    fwrite(loop, 1, sizeof(loop), gif.file);
+
+    int status = for_each_frame(input, write_gif_frame, &gif, NULL);
+    if (gif.pending) {
+        gif_write_image(&gif, &gif.pending_frame, GIF_MIN_DELAY_CS);
+    }
+    fputc(0x3B, gif.file);
+    fclose(gif.file);
+
+    printf("Wrote %llu images to %s\n", (unsigned long long)gif.frames_written, output);
+    free(gif.pixels);
+    free(gif.dictionary);
+    return status;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage:\n");
+    printf("  %s info <capture>\n", program);
+    printf("  %s y4m <capture> <output.y4m> [--scale N]\n", program);
+    printf("  %s gif <capture> <output.gif> [--scale N]\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char* command = argv[1];
+    if (strcmp(command, "info") == 0) {
+        return cmd_info(argv[2]);
+    }
+
+    int scale = DEFAULT_SCALE;
+    if (argc >= 6 && strcmp(argv[4], "--scale") == 0) {
+        scale = atoi(argv[5]);
+    }
+    if (scale < 1 || scale > MAX_SCALE) {
+        printf("Error: scale must be 1-%d\n", MAX_SCALE);
+        return 1;
+    }
+
+    if (strcmp(command, "y4m") == 0 && argc >= 4) {
+        return cmd_y4m(argv[2], argv[3], scale);
+    }
+    if (strcmp(command, "gif") == 0 && argc >= 4) {
+        return cmd_gif(argv[2], argv[3], scale);
+    }
+
+    print_usage(argv[0]);
+    return 1;
+}
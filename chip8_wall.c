@@ -0,0 +1,134 @@
+#include "chip8_wall.h"
+#include "chip8_spans.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Converts an instance's screen into its tile of the atlas
+static void draw_tile(Chip8Wall* wall, int index) {
+    const Chip8* cpu = wall->instances[index];
+    int tile_x = (index % wall->cols) * SCREEN_WIDTH;
+    int tile_y = (index / wall->cols) * SCREEN_HEIGHT;
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        uint32_t* row = wall->atlas + (tile_y + y) * wall->atlas_pitch + tile_x;
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            row[x] = cpu->screen[x][y] ? 0xFFFFFFFF : 0xFF000000;
+        }
+    }
+}
+
+// Instances [first, last) live in arena slab `slab` and run on its thread
+static int slab_first(const Chip8Wall* wall, int slab) {
+    return (int)((int64_t)slab * wall->count / arena_slab_count(wall->arena));
+}
+
+static void run_instance(Chip8Wall* wall, int index) {
+    Chip8* cpu = wall->instances[index];
+    Uint64 span = spans_begin();
+
+    chip8_run_until(cpu, cpu->cycles + wall->frame_cycles);
+    if (cpu->draw_flag) {
+        draw_tile(wall, index);
+        cpu->draw_flag = false;
+    }
+    spans_end(span, "instance", index);
+}
+
+static void run_slab(void* context, int slab) {
+    Chip8Wall* wall = context;
+    int last = slab_first(wall, slab + 1);
+    for (int i = slab_first(wall, slab); i < last; i++) {
+        run_instance(wall, i);
+    }
+}
+
+Chip8Wall* wall_create(int count, char* roms[], int rom_count) {
+    if (count < 1 || count > WALL_MAX_INSTANCES || rom_count < 1) {
+        printf("Error: wall needs 1-%d instances and at least one ROM\n", WALL_MAX_INSTANCES);
+        return NULL;
+    }
+
+    Chip8Wall* wall = calloc(1, sizeof(Chip8Wall));
+    if (!wall) {
+        return NULL;
+    }
+
+    // Near-square grid; tiles are 2:1 like the window
+    wall->count = count;
+    wall->cols = (int)ceil(sqrt((double)count));
+    wall->rows = (count + wall->cols - 1) / wall->cols;
+    wall->atlas_pitch = wall->cols * SCREEN_WIDTH;
+    wall->atlas = calloc((size_t)wall->atlas_pitch * wall->rows * SCREEN_HEIGHT, sizeof(uint32_t));
+    wall->instances = calloc(count, sizeof(Chip8*));
+    wall->pool = pool_create(pool_default_threads());
+    if (!wall->atlas || !wall->instances || !wall->pool) {
+        wall_destroy(wall);
+        return NULL;
+    }
+    int slabs = pool_size(wall->pool);
+    wall->arena = arena_create(wall->pool, (count + slabs - 1) / slabs);
+    if (!wall->arena) {
+        wall_destroy(wall);
+        return NULL;
+    }
+
+    // ROMs are assigned round-robin when there are fewer ROMs than tiles
+    for (int slab = 0; slab < slabs; slab++) {
+        int last = slab_first(wall, slab + 1);
+        for (int i = slab_first(wall, slab); i < last; i++) {
+            Chip8* cpu = arena_alloc(wall->arena, slab);
+            chip8_init(cpu);
+            cpu->log_stream = i + 1;
+            if (!chip8_load_rom(cpu, roms[i % rom_count])) {
+                wall_destroy(wall);
+                return NULL;
+            }
+            cpu->muted = (i != 0);
+            wall->instances[i] = cpu;
+            draw_tile(wall, i);
+        }
+    }
+
+    printf("Wall: %d instances in a %dx%d grid, %s pages\n", count, wall->cols, wall->rows,
+           arena_page_kind(wall->arena));
+    return wall;
+}
+
+void wall_destroy(Chip8Wall* wall) {
+    if (!wall) {
+        return;
+    }
+    arena_destroy(wall->arena);
+    pool_destroy(wall->pool);
+    free(wall->instances);
+    free(wall->atlas);
+    free(wall);
+}
+
+void wall_run_frame(Chip8Wall* wall, double speed_factor) {
+    wall->frame_cycles = (uint64_t)(wall->instances[0]->sched.frame_period * speed_factor);
+    pool_run_threads(wall->pool, run_slab, wall);
+}
+
+// Moves keyboard focus and sound, releasing any keys still held on the old tile
+void wall_set_focus(Chip8Wall* wall, int index) {
+    if (index < 0 || index >= wall->count || index == wall->focus) {
+        return;
+    }
+
+    Chip8* old = wall->instances[wall->focus];
+    for (int key = 0; key < KEY_COUNT; key++) {
+        if (old->keypad & (1 << key)) {
+            chip8_queue_key(old, key, false);
+        }
+    }
+    old->muted = true;
+    wall->focus = index;
+    wall->instances[index]->muted = false;
+}
+
+Chip8* wall_focused(Chip8Wall* wall) {
+    return wall->instances[wall->focus];
+}
@@ -0,0 +1,40 @@
+#ifndef CHIP8_WALL_H
+#define CHIP8_WALL_H
+
+#include "chip8_arena.h"
+#include "chip8_cpu.h"
+#include "chip8_pool.h"
+
+// Wall mode: many ROM instances tiled into one window. Each pool thread
+// emulates a fixed run of instances held in its own arena slab and writes
+// their tiles straight into a shared atlas, which the platform uploads and
+// presents once per refresh.
+
+#define WALL_MAX_INSTANCES 1024
+
+typedef struct {
+    int count;
+    int cols;
+    int rows;
+    int focus;
+    Chip8** instances;
+    WorkerPool* pool;
+    Chip8Arena* arena;
+
+    // cols*SCREEN_WIDTH x rows*SCREEN_HEIGHT ARGB pixels
+    uint32_t* atlas;
+    int atlas_pitch;
+
+    // Per-frame job parameters shared with the workers
+    uint64_t frame_cycles;
+} Chip8Wall;
+
+Chip8Wall* wall_create(int count, char* roms[], int rom_count);
+void wall_destroy(Chip8Wall* wall);
+
+// Runs one frame on every instance and refreshes the changed tiles
+void wall_run_frame(Chip8Wall* wall, double speed_factor);
+void wall_set_focus(Chip8Wall* wall, int index);
+Chip8* wall_focused(Chip8Wall* wall);
+
+#endif
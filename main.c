@@ -1,75 +1,468 @@
 #define SDL_MAIN_HANDLED
+#include "chip8_capture.h"
 #include "chip8_cpu.h"
+#include "chip8_debugger.h"
 #include "chip8_platform.h"
+#include "chip8_hud.h"
+#include "chip8_log.h"
+#include "chip8_movie.h"
+#include "chip8_wall.h"
+#include "chip8_netplay.h"
+#include "chip8_shm.h"
+#include "chip8_slots.h"
+#include "chip8_spans.h"
 #include <SDL2/SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-#define BASE_CYCLES_PER_FRAME 10
 #define FRAME_RATE 60
-#define BASE_FRAME_DELAY (1000 / FRAME_RATE)
+// Idle wake-up interval for the debugger socket, and how many frames late
+// the single-ROM loop may run before it drops them
+#define DEBUGGER_POLL_MS 50
+#define MAX_FRAME_LAG 4
+
+// Starts a capture named after the current time, e.g. chip8_20260119_204512.c8v
+static Chip8Capture* start_recording(void) {
+    char filename[64];
+    time_t now = time(NULL);
+    strftime(filename, sizeof(filename), "chip8_%Y%m%d_%H%M%S.c8v", localtime(&now));
+    return capture_start(filename, true);
+}
+
+// F6 starts tracing host spans; the next F6 writes them to a timestamped
+// Chrome trace, e.g. chip8_20260119_204512.json
+static void toggle_spans(void) {
+    if (!platform_take_trace_request()) {
+        return;
+    }
+    if (!spans_enabled()) {
+        spans_enable(true);
+        printf("Tracing host spans, press F6 again to save\n");
+        return;
+    }
+    
+    spans_enable(false);
+    char filename[64];
+    time_t now = time(NULL);
+    strftime(filename, sizeof(filename), "chip8_%Y%m%d_%H%M%S.json", localtime(&now));
+    spans_write(filename);
+}
+
+// F7 starts recording an input movie named after the current time, e.g.
+// chip8_20260119_204512.c8m; the next F7 finishes it
+static MovieRecorder* toggle_movie(MovieRecorder* movie, const Chip8* cpu) {
+    if (movie) {
+        movie_record_stop(movie, cpu);
+        return NULL;
+    }
+    char filename[64];
+    time_t now = time(NULL);
+    strftime(filename, sizeof(filename), "chip8_%Y%m%d_%H%M%S.c8m", localtime(&now));
+    return movie_record_start(filename, cpu);
+}
+
+// Whether the single-ROM loop should emulate a loaded ROM. Nothing runs
+// while paused, in the key mapping UI, at a breakpoint, or while the window
+// is minimized or unfocused, except that a --shm client may drive the
+// window from the background.
+static bool should_emulate(Chip8Debugger* debugger, bool shm) {
+    if (platform_is_paused() || config_state.is_configuring) {
+        return false;
+    }
+    if (platform_is_backgrounded() && !shm) {
+        return false;
+    }
+    return !(debugger && chip8_debugger_paused(debugger));
+}
+
+// Milliseconds until `deadline` on the performance counter, rounded up so
+// a wait ends at or after it
+static int ms_until(Uint64 deadline) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    return now >= deadline ? 0 : (int)((deadline - now) * 1000 / SDL_GetPerformanceFrequency()) + 1;
+}
+
+// Deadline of the frame after the one due at `due`. Falling more than a few
+// frames behind (a breakpoint, a slow draw) drops the backlog rather than
+// fast-forwarding through it.
+static Uint64 schedule_next_frame(Uint64 due, Uint64 now, Uint64 frame_ticks) {
+    due += frame_ticks;
+    if (now > due + MAX_FRAME_LAG * frame_ticks) {
+        due = now + frame_ticks;
+    }
+    return due;
+}
+
+// Tiled multi-ROM mode: chip8_emulator --wall <count> <rom> [rom...]
+static int run_wall(int count, char* roms[], int rom_count) {
+    Chip8Wall* wall = wall_create(count, roms, rom_count);
+    if (!wall) {
+        return 1;
+    }
+    
+    platform_init();
+    spans_name_thread("main");
+    printf("Press Tab or click a tile to move keyboard focus, F6 to trace, F8 to pause, ESC to quit\n");
+    
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 frame_ticks = frequency / FRAME_RATE;
+    Uint64 next_frame = SDL_GetPerformanceCounter();
+    Uint64 last_frame = next_frame;
+    bool was_running = false;
+    
+    // Paced like the single-ROM loop: it sleeps until the next frame is due,
+    // and while paused, minimized or unfocused until an event arrives, so a
+    // wall left in the background costs no CPU
+    while (!platform_should_quit()) {
+        Uint64 frame_span = spans_begin();
+        
+        // The wall has no key mapping UI, so only pause and the window's
+        // state stop it
+        bool running = !platform_is_paused() && !platform_is_backgrounded();
+        platform_wait_input(wall_focused(wall), running ? ms_until(next_frame) : -1);
+        
+        char* dropped;
+        while ((dropped = platform_take_dropped_rom())) {
+            // A ROM dropped on the wall restarts the focused tile with it;
+            // one that cannot be loaded leaves the tile running
+            static Chip8 fresh;
+            chip8_init(&fresh);
+            fresh.log_stream = wall_focused(wall)->log_stream;
+            if (chip8_load_rom(&fresh, dropped)) {
+                chip8_load_state(wall_focused(wall), &fresh);
+            }
+            SDL_free(dropped);
+        }
+        int focus = wall->focus;
+        int request = platform_take_focus_request();
+        if (request == FOCUS_NEXT) {
+            wall_set_focus(wall, (wall->focus + 1) % wall->count);
+        } else if (request != FOCUS_NONE) {
+            wall_set_focus(wall, request);
+        }
+        toggle_spans();
+        
+        running = !platform_is_paused() && !platform_is_backgrounded();
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (running && !was_running) {
+            next_frame = now;
+            last_frame = now;
+        }
+        was_running = running;
+        
+        bool new_frame = false;
+        if (running && now >= next_frame) {
+            hud_record_frame((double)(now - last_frame) * 1000.0 / frequency, wall_focused(wall)->cycles,
+                             wall_focused(wall)->idle_cycles);
+            last_frame = now;
+            next_frame = schedule_next_frame(next_frame, now, frame_ticks);
+            
+            Uint64 span = spans_begin();
+            wall_run_frame(wall, platform_get_speed_factor());
+            spans_end(span, "emulate", -1);
+            new_frame = true;
+        }
+        
+        bool redraw = platform_take_redraw_request();
+        if (redraw || new_frame || wall->focus != focus || hud_needs_redraw()) {
+            Uint64 span = spans_begin();
+            platform_draw_wall(wall->atlas, wall->cols, wall->rows, wall->focus);
+            spans_end(span, "draw", -1);
+        }
+        spans_end(frame_span, "frame", -1);
+    }
+    
+    platform_cleanup();
+    wall_destroy(wall);
+    printf("Emulation stopped.\n");
+    
+    return 0;
+}
+
+// Two-player rollback netplay:
+// chip8_emulator --netplay <1|2> <local port> <peer host> <peer port> <rom>
+static int run_netplay(int player, int local_port, const char* host, int port, const char* rom) {
+    static Chip8 cpu;
+    chip8_init(&cpu);
+    if (!chip8_load_rom(&cpu, rom)) {
+        return 1;
+    }
+    
+    NetplaySession* session = netplay_create(player, (uint16_t)local_port, host, (uint16_t)port);
+    if (!session) {
+        return 1;
+    }
+    
+    platform_init();
+    spans_name_thread("main");
+    printf("Waiting for player %d...\n", player == 1 ? 2 : 1);
+    
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 frame_ticks = frequency / FRAME_RATE;
+    Uint64 next_frame = SDL_GetPerformanceCounter();
+    Uint64 last_frame = next_frame;
+    
+    // Sleeps in the event wait until the next frame is due. The peer's
+    // frames only advance with ours, so a session keeps running in the
+    // background and never pauses.
+    while (!platform_should_quit()) {
+        Uint64 frame_span = spans_begin();
+        
+        // Keys are sampled as a mask; the session owns the CPU's keypad
+        platform_wait_input(NULL, ms_until(next_frame));
+        toggle_spans();
+        
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (now < next_frame) {
+            spans_end(frame_span, "frame", -1);
+            continue;
+        }
+        hud_record_frame((double)(now - last_frame) * 1000.0 / frequency, cpu.cycles, cpu.idle_cycles);
+        last_frame = now;
+        next_frame = schedule_next_frame(next_frame, now, frame_ticks);
+        
+        // Includes rollback re-simulation
+        Uint64 span = spans_begin();
+        if (netplay_connect(session, &cpu)) {
+            netplay_advance(session, &cpu, platform_get_held_keys());
+        }
+        spans_end(span, "emulate", -1);
+        
+        if (cpu.draw_flag || hud_needs_redraw()) {
+            span = spans_begin();
+            platform_draw(&cpu);
+            spans_end(span, "draw", -1);
+            cpu.draw_flag = false;
+        }
+        spans_end(frame_span, "frame", -1);
+    }
+    
+    platform_cleanup();
+    netplay_destroy(session);
+    printf("Emulation stopped.\n");
+    
+    return 0;
+}
 
 int main(int argc, char* argv[]) {
+    // Messages from the emulation go through a background thread; the exit
+    // handler drains it on every way out of main
+    log_start();
+    atexit(log_stop);
+    
+    if (argc >= 4 && strcmp(argv[1], "--wall") == 0) {
+        return run_wall(atoi(argv[2]), &argv[3], argc - 3);
+    }
+    if (argc == 7 && strcmp(argv[1], "--netplay") == 0) {
+        return run_netplay(atoi(argv[2]), atoi(argv[3]), argv[4], atoi(argv[5]), argv[6]);
+    }
+    
+    // Single ROM: chip8_emulator [--debug <port>] [--shm <name>] [--run-ahead <frames>] [rom]
+    const char* rom = NULL;
+    int debug_port = 0;
+    const char* shm_name = NULL;
+    int run_ahead = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--debug") == 0 && i + 1 < argc) {
+            debug_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            shm_name = argv[++i];
+        } else if (strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc) {
+            run_ahead = atoi(argv[++i]);
+            if (run_ahead < 0 || run_ahead > CHIP8_MAX_RUN_AHEAD) {
+                printf("Error: run-ahead must be 0-%d frames\n", CHIP8_MAX_RUN_AHEAD);
+                return 1;
+            }
+        } else {
+            rom = argv[i];
+        }
+    }
+    
     Chip8 cpu;
     chip8_init(&cpu);
+    // Hidden future state shown in run-ahead mode
+    static Chip8 future;
     int rom_loaded = 0;
+    Chip8Debugger* debugger = NULL;
+    Chip8Capture* capture = NULL;
+    MovieRecorder* movie = NULL;
+    Chip8Shm* shm = shm_name ? chip8_shm_create(shm_name) : NULL;
     
     platform_init();
+    spans_name_thread("main");
+    
+    // Dropped ROMs open in slots of their own; F9 switches between them
+    Chip8Slots* slots = slots_create(&cpu);
+    if (!slots) {
+        platform_cleanup();
+        return 1;
+    }
     
-    if (argc == 2) {
-        chip8_load_rom(&cpu, argv[1]);
+    if (rom) {
+        if (!chip8_load_rom(&cpu, rom)) {
+            slots_destroy(slots);
+            platform_cleanup();
+            return 1;
+        }
+        slots_adopt(slots, rom);
         rom_loaded = 1;
-        printf("Starting CHIP-8 emulation with %s...\n", argv[1]);
+        printf("Starting CHIP-8 emulation with %s...\n", rom);
     } else {
         printf("CHIP-8 Emulator started.\n");
         printf("Drag and drop a ROM file into the window to load.\n");
     }
     
-    printf("Press ESC to quit\n");
+    // Attached to the live machine, which keeps its hooks when a dropped
+    // ROM or F9 swaps another session in, so it follows whatever runs
+    if (debug_port) {
+        debugger = chip8_debugger_create(&cpu, (uint16_t)debug_port);
+    }
+    
+    printf("Press F3 to start or stop recording, F6 to trace, F7 to record input, F8 to pause, F9 to switch ROMs, ESC to quit\n");
     
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 frame_ticks = frequency / FRAME_RATE;
+    Uint64 next_frame = SDL_GetPerformanceCounter();
+    Uint64 last_frame = next_frame;
+    bool was_running = false;
+    // Run-ahead shows the frame the ROM will draw `run_ahead` frames from
+    // now given the keys held now, hiding the ROM's own input lag
+    const Chip8* shown = &cpu;
+    
+    // The loop sleeps in SDL_WaitEventTimeout: until the next frame is due
+    // while emulating, and until an event arrives otherwise. The debugger
+    // socket has no SDL event, so it is polled a few times a second instead.
     while (!platform_should_quit()) {
-        clock_t start_time = clock();
+        Uint64 frame_span = spans_begin();
         
-        if (rom_loaded) {
-            // Calculate dynamic cycles per frame based on speed factor
-            double speed_factor = platform_get_speed_factor();
-            int cycles_per_frame = (int)(BASE_CYCLES_PER_FRAME * speed_factor);
-            
-            for (int i = 0; i < cycles_per_frame; i++) {
-                chip8_cycle(&cpu);
-            }
-            
-            chip8_decrement_timers(&cpu);
+        bool running = rom_loaded && should_emulate(debugger, shm != NULL);
+        int timeout = debugger ? DEBUGGER_POLL_MS : -1;
+        if (running) {
+            timeout = ms_until(next_frame);
         }
         
-        // Handle input and check for dropped files
-        if (platform_handle_input(&cpu)) {
-            // A ROM was dropped and loaded successfully
+        platform_wait_input(&cpu, timeout);
+        
+        char* dropped;
+        while ((dropped = platform_take_dropped_rom())) {
+            slots_load(slots, dropped);
+            SDL_free(dropped);
+        }
+        bool switched = slots_poll(slots);
+        if (platform_take_slot_request()) {
+            switched = slots_switch(slots, slots_next(slots)) || switched;
+        }
+        if (switched) {
+            // Another session is live now. Its program is not input, so a
+            // movie recorded so far ends here.
             rom_loaded = 1;
-            printf("Starting CHIP-8 emulation...\n");
+            movie_record_stop(movie, &cpu);
+            movie = NULL;
+            shown = &cpu;
+            cpu.draw_flag = true;
         }
         
-        // Always draw in configuration mode, otherwise draw only when requested by CPU
-        if (config_state.is_configuring || (rom_loaded && cpu.draw_flag)) {
-            platform_draw(&cpu);
-            if (rom_loaded) {
-                cpu.draw_flag = false;
+        if (platform_take_record_request()) {
+            if (capture) {
+                capture_stop(capture);
+                capture = NULL;
+            } else {
+                capture = start_recording();
             }
         }
+        toggle_spans();
+        if (platform_take_movie_request() && rom_loaded) {
+            movie = toggle_movie(movie, &cpu);
+        }
         
-        clock_t end_time = clock();
-        double elapsed = ((double)(end_time - start_time) / CLOCKS_PER_SEC) * 1000;
+        Uint64 span = spans_begin();
+        if (debugger) {
+            chip8_debugger_poll(debugger);
+        }
+        spans_end(span, "debugger", -1);
+        
+        // Input may have paused or resumed emulation while waiting
+        running = rom_loaded && should_emulate(debugger, shm != NULL);
+        Uint64 now = SDL_GetPerformanceCounter();
+        if (running && !was_running) {
+            // Resume on the beat instead of catching up the pause
+            next_frame = now;
+            last_frame = now;
+        }
+        was_running = running;
+        // The future is only current right after a frame; a debugger step
+        // or a pause must show the real machine
+        if (!running) {
+            shown = &cpu;
+        }
         
-        // Calculate dynamic frame delay based on speed factor
-        double speed_factor = platform_get_speed_factor();
-        int frame_delay = (int)(BASE_FRAME_DELAY / speed_factor);
+        bool new_frame = false;
+        if (running && now >= next_frame) {
+            // Frame-to-frame time for the performance overlay
+            hud_record_frame((double)(now - last_frame) * 1000.0 / frequency, cpu.cycles, cpu.idle_cycles);
+            last_frame = now;
+            
+            next_frame = schedule_next_frame(next_frame, now, frame_ticks);
+            
+            // Advance emulated time by one frame scaled by the speed factor.
+            // Timers tick inside the core on exact cycle boundaries.
+            double speed_factor = platform_get_speed_factor();
+            uint64_t cycles_per_frame = (uint64_t)(cpu.sched.frame_period * speed_factor);
+            
+            if (shm) {
+                chip8_shm_apply_input(shm, &cpu);
+            }
+            if (movie) {
+                movie_record_input(movie, &cpu);
+            }
+            
+            uint64_t frame = cpu.sched.frame_count;
+            span = spans_begin();
+            chip8_run_until(&cpu, cpu.cycles + cycles_per_frame);
+            spans_end(span, "emulate", -1);
+            if (movie) {
+                movie_record_frame(movie, &cpu);
+            }
+            
+            // Frames skipped at high speed show up as gaps in the capture
+            if (cpu.sched.frame_count != frame) {
+                if (capture) {
+                    capture_frame(capture, &cpu);
+                }
+                if (shm) {
+                    chip8_shm_publish(shm, &cpu, false);
+                }
+            }
+            
+            // The future inherits the real draw flag, so it covers both
+            if (run_ahead) {
+                span = spans_begin();
+                chip8_run_ahead(&cpu, &future, run_ahead);
+                spans_end(span, "run_ahead", -1);
+                shown = &future;
+            }
+            new_frame = true;
+        }
         
-        if (elapsed < frame_delay) {
-            SDL_Delay((Uint32)(frame_delay - elapsed));
+        // Draw when the screen (a frame or a debugger step) or the overlay
+        // text changed, or when the window asks for it; never while idle
+        bool redraw = platform_take_redraw_request();
+        if (redraw || cpu.draw_flag || (new_frame && shown->draw_flag) || hud_needs_redraw()) {
+            span = spans_begin();
+            platform_draw(shown);
+            spans_end(span, "draw", -1);
+            cpu.draw_flag = false;
         }
+        spans_end(frame_span, "frame", -1);
     }
     
+    chip8_shm_close(shm);
+    movie_record_stop(movie, &cpu);
+    capture_stop(capture);
+    chip8_debugger_destroy(debugger);
+    slots_destroy(slots);
     platform_cleanup();
     printf("Emulation stopped.\n");
     